@@ -0,0 +1,377 @@
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bitmap.h"
+#include "block_kernel.h"
+#include "stream_encoder.h"
+#include "bin_format.h"
+#include "thread_pool.h"
+#include "work_stealing.h"
+
+// Codec state owned by one worker and reused for every file it encodes
+typedef struct {
+    BlockKernel kernels[2];    // Built once per worker instead of once per file
+    StreamWorkspace workspace; // Chroma spill file and row buffers, reset between files
+    int files;
+    int failures;
+    size_t input_bytes;
+    size_t output_bytes;
+} BatchWorker;
+
+// Everything the encode jobs share, read-only while they run
+typedef struct {
+    char **inputs;
+    char **outputs;                  // Output path of each input, all distinct
+    int input_count;
+    const char *output_dir;          // NULL to write next to each input
+    DCEncoder dc_encoder;
+    ACEncoder ac_encoder;
+    int fixed_point;
+    BinLayout layout;
+    BatchWorker *workers;
+} BatchJob;
+
+/**
+ * @brief Copies a string into a new heap buffer
+ */
+static char *copy_string(const char *text, size_t length) {
+    char *copy = (char *)malloc(length + 1);
+    if (copy == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * @brief Appends a path to a growable list
+ */
+static void add_input(char ***inputs, int *count, int *capacity, const char *path, size_t length) {
+    if (*count == *capacity) {
+        *capacity = *capacity > 0 ? *capacity * 2 : 64;
+        *inputs = (char **)realloc(*inputs, (size_t) *capacity * sizeof(char *));
+        if (*inputs == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    (*inputs)[(*count)++] = copy_string(path, length);
+}
+
+/**
+ * @brief Adds every non-empty line of a list file as an input
+ *
+ * @return 0 on success, -1 if the file cannot be opened
+ */
+static int read_input_list(const char *filename, char ***inputs, int *count, int *capacity) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        if (length > 0) {
+            add_input(inputs, count, capacity, line, length);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Output path of an input: its name with .bmp replaced by .bin, in output_dir if given
+ */
+static char *output_path(const char *input, const char *output_dir) {
+    const char *name = input;
+    if (output_dir != NULL) {
+        const char *slash = strrchr(input, '/');
+        name = slash != NULL ? slash + 1 : input;
+    }
+    size_t name_length = strlen(name);
+    const char *dot = strrchr(name, '.');
+    if (dot != NULL && strchr(dot, '/') == NULL) {
+        name_length = (size_t) (dot - name);
+    }
+
+    size_t dir_length = output_dir != NULL ? strlen(output_dir) : 0;
+    char *path = (char *)malloc(dir_length + 1 + name_length + 5);
+    if (path == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    path[0] = '\0';
+    if (output_dir != NULL) {
+        strcat(path, output_dir);
+        if (dir_length > 0 && output_dir[dir_length - 1] != '/') {
+            strcat(path, "/");
+        }
+    }
+    strncat(path, name, name_length);
+    strcat(path, ".bin");
+    return path;
+}
+
+/**
+ * @brief qsort comparison of two path strings
+ */
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+ * @brief Finds an output path shared by two inputs
+ *
+ * Inputs with the same name in different directories collide under
+ * --output-dir, and the workers would then write the same file at once.
+ *
+ * @return The first duplicated path, or NULL if every path is distinct
+ */
+static const char *find_duplicate_output(char **outputs, int count) {
+    char **sorted = (char **)malloc((size_t) (count > 0 ? count : 1) * sizeof(char *));
+    if (sorted == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(sorted, outputs, (size_t) count * sizeof(char *));
+    qsort(sorted, (size_t) count, sizeof(char *), compare_paths);
+    const char *duplicate = NULL;
+    for (int i = 1; i < count && duplicate == NULL; i++) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            duplicate = sorted[i];
+        }
+    }
+    free(sorted);
+    return duplicate;
+}
+
+/**
+ * @brief Job: encodes one input with the streaming encoder and the worker's kernels
+ */
+static void encode_one_file(void *context, int worker, int job) {
+    BatchJob *batch = (BatchJob *) context;
+    BatchWorker *state = &batch->workers[worker];
+    const char *input = batch->inputs[job];
+    const char *output = batch->outputs[job];
+
+    MappedBitmap bitmap;
+    if (map_bmp_file(input, &bitmap) != 0) {
+        fprintf(stderr, "Error mapping bitmap: %s\n", input);
+        state->failures++;
+        return;
+    }
+    FILE *out = fopen(output, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Error opening file for writing: %s\n", output);
+        state->failures++;
+        unmap_bmp_file(&bitmap);
+        return;
+    }
+
+    StreamEncoder encoder;
+    int written = 0;
+    int encoder_ready = stream_encoder_init_kernels(&encoder, out, &bitmap.file_header, &bitmap.info_header,
+                                                    state->kernels, batch->dc_encoder, batch->ac_encoder,
+                                                    batch->fixed_point, &batch->layout, &state->workspace) == 0;
+    if (!encoder_ready) {
+        fprintf(stderr, "Error creating temporary file for %s\n", input);
+    } else {
+        stream_encoder_write_rows(&encoder, bitmap.pixels, bitmap.row_stride, bitmap.info_header.Height);
+        // The encoder does not check its writes, so a full disk only shows on the stream
+        written = stream_encoder_finish(&encoder) == 0 && fflush(out) == 0 && !ferror(out);
+    }
+
+    if (fclose(out) != 0) {
+        written = 0;
+    }
+    if (written) {
+        state->files++;
+        state->input_bytes += bitmap.file_header.OffBits + (size_t) bitmap.row_stride * bitmap.info_header.Height;
+        state->output_bytes += encoder.compressed_size;
+    } else {
+        if (encoder_ready) {
+            fprintf(stderr, "Error writing file: %s\n", output);
+        }
+        state->failures++;
+        // Leave no truncated .bin behind to be mistaken for a finished one
+        remove(output);
+    }
+    unmap_bmp_file(&bitmap);
+}
+
+/**
+ * @brief Seconds on the monotonic clock
+ */
+static double wall_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    clock_t start, end;
+    double cpu_time_used;
+
+    start = clock();
+    double wall_start = wall_seconds();
+
+    if (argc < 2) {
+        printf("Usage: %s [--list=FILE] [--output-dir=DIR] [--threads=N] [--huffman=table|string] [--dct=matrix|aan|int|simd] [--color=float|fixed] [--order=sequential|interleaved] [--restart=MCUS|row] [--segment-table=on|off] <input.bmp>...\n", argv[0]);
+        return 1;
+    }
+
+    BatchJob batch;
+    batch.inputs = NULL;
+    batch.input_count = 0;
+    batch.output_dir = NULL;
+    batch.dc_encoder = encode_dc_table;
+    batch.ac_encoder = encode_ac_table;
+    batch.fixed_point = 0;
+    batch.layout.interleaved = 0;
+    batch.layout.restart_interval = 0;
+    batch.layout.segment_table = 1;
+    DCTMethod dct_method = DCT_METHOD_MATRIX;
+    int thread_count = 0;
+    int input_capacity = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            add_input(&batch.inputs, &batch.input_count, &input_capacity, argv[i], strlen(argv[i]));
+        } else if (strncmp(argv[i], "--list=", 7) == 0) {
+            if (read_input_list(argv[i] + 7, &batch.inputs, &batch.input_count, &input_capacity) != 0) {
+                printf("Error opening file: %s\n", argv[i] + 7);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--output-dir=", 13) == 0) {
+            batch.output_dir = argv[i] + 13;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            thread_count = atoi(argv[i] + 10);
+        } else if (strcmp(argv[i], "--huffman=table") == 0) {
+            batch.dc_encoder = encode_dc_table;
+            batch.ac_encoder = encode_ac_table;
+        } else if (strcmp(argv[i], "--huffman=string") == 0) {
+            batch.dc_encoder = encode_dc;
+            batch.ac_encoder = encode_ac;
+        } else if (strcmp(argv[i], "--dct=matrix") == 0) {
+            dct_method = DCT_METHOD_MATRIX;
+        } else if (strcmp(argv[i], "--dct=aan") == 0) {
+            dct_method = DCT_METHOD_AAN;
+        } else if (strcmp(argv[i], "--dct=int") == 0) {
+            dct_method = DCT_METHOD_INTEGER;
+        } else if (strcmp(argv[i], "--dct=simd") == 0) {
+            dct_method = DCT_METHOD_SIMD;
+        } else if (strcmp(argv[i], "--color=float") == 0) {
+            batch.fixed_point = 0;
+        } else if (strcmp(argv[i], "--color=fixed") == 0) {
+            batch.fixed_point = 1;
+        } else if (strcmp(argv[i], "--order=sequential") == 0) {
+            batch.layout.interleaved = 0;
+        } else if (strcmp(argv[i], "--order=interleaved") == 0) {
+            batch.layout.interleaved = 1;
+        } else if (strcmp(argv[i], "--restart=row") == 0) {
+            batch.layout.restart_interval = BIN_RESTART_PER_MCU_ROW;
+        } else if (strncmp(argv[i], "--restart=", 10) == 0) {
+            batch.layout.restart_interval = atoi(argv[i] + 10);
+            if (batch.layout.restart_interval < 0 || batch.layout.restart_interval > BIN_MAX_RESTART_INTERVAL) {
+                printf("Restart interval must be between 0 and %d MCUs\n", BIN_MAX_RESTART_INTERVAL);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--segment-table=on") == 0) {
+            batch.layout.segment_table = 1;
+        } else if (strcmp(argv[i], "--segment-table=off") == 0) {
+            batch.layout.segment_table = 0;
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (batch.layout.restart_interval != 0) {
+        // Restart intervals count MCUs, so they need the interleaved order
+        batch.layout.interleaved = 1;
+    }
+
+    batch.outputs = (char **)malloc((size_t) (batch.input_count > 0 ? batch.input_count : 1) * sizeof(char *));
+    if (batch.outputs == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < batch.input_count; i++) {
+        batch.outputs[i] = output_path(batch.inputs[i], batch.output_dir);
+    }
+    const char *duplicate = find_duplicate_output(batch.outputs, batch.input_count);
+    if (duplicate != NULL) {
+        printf("Several inputs would be written to %s\n", duplicate);
+        return 1;
+    }
+
+    if (thread_count < 1) {
+        thread_count = thread_pool_default_threads();
+    }
+    if (thread_count > batch.input_count && batch.input_count > 0) {
+        thread_count = batch.input_count;
+    }
+
+    // Per-worker codec contexts; runtime dispatch is resolved before any worker starts
+    dct_simd_init();
+    color_simd_init();
+    batch.workers = (BatchWorker *)calloc((size_t) thread_count, sizeof(BatchWorker));
+    if (batch.workers == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < thread_count; k++) {
+        init_block_kernel(&batch.workers[k].kernels[LUMINANCE], dct_method, 1.0, LUMINANCE);
+        init_block_kernel(&batch.workers[k].kernels[CHROMINANCE], dct_method, 1.0, CHROMINANCE);
+        stream_workspace_init(&batch.workers[k].workspace);
+    }
+
+    WorkStealingScheduler scheduler;
+    work_stealing_init(&scheduler, thread_count, batch.input_count);
+    int workers_run = work_stealing_run(&scheduler, encode_one_file, &batch);
+
+    int files = 0, failures = 0;
+    size_t input_bytes = 0, output_bytes = 0;
+    printf("Batch information:\n");
+    for (int k = 0; k < thread_count; k++) {
+        BatchWorker *state = &batch.workers[k];
+        printf("Worker %d: %d files, %d steals\n", k, scheduler.ranges[k].jobs_run, scheduler.ranges[k].steals);
+        files += state->files;
+        failures += state->failures;
+        input_bytes += state->input_bytes;
+        output_bytes += state->output_bytes;
+        stream_workspace_destroy(&state->workspace);
+    }
+    work_stealing_destroy(&scheduler);
+
+    double wall_time = wall_seconds() - wall_start;
+    end = clock();
+    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+
+    printf("Threads: %d\n", workers_run);
+    printf("Files encoded: %d\n", files);
+    printf("Files failed: %d\n", failures);
+    printf("Original size: %.0f bytes\n", (double) input_bytes);
+    printf("Compressed size: %.0f bytes\n", (double) output_bytes);
+    if (input_bytes > 0) {
+        printf("Compression ratio: %.2f%%\n", ((double) output_bytes / (double) input_bytes) * 100);
+    }
+    if (wall_time > 0) {
+        printf("Throughput: %.2f MB/s, %.1f files/s\n", (double) input_bytes / wall_time / 1e6,
+               (double) files / wall_time);
+    }
+    printf("Wall time: %f seconds\n", wall_time);
+    printf("Time taken: %f seconds\n", cpu_time_used);
+
+    for (int i = 0; i < batch.input_count; i++) {
+        free(batch.inputs[i]);
+        free(batch.outputs[i]);
+    }
+    free(batch.inputs);
+    free(batch.outputs);
+    free(batch.workers);
+    return failures > 0 ? 1 : 0;
+}
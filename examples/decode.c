@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "quantization.h"
 #include "dct.h"
 #include "heap_manager.h"
@@ -11,282 +12,577 @@
 #include "ac_encode.h"
 #include "dc_encode.h"
 #include "huffman.h"
+#include "coefficients.h"
+#include "block_kernel.h"
+#include "stream_decoder.h"
+#include "bin_format.h"
+#include "parallel_transform.h"
+#include "entropy_segments.h"
+
+// Dequantization tables precomputed for each DCT method, indexed by QuantizationType
+typedef struct {
+    double aan_multipliers[2][DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+    uint16_t int_divisors[2][DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+} DequantizationTables;
+
+/**
+ * @brief Inverse zigzag scan, dequantization, IDCT and level shift of one block
+ *
+ * @param coefficients Input zigzag-ordered quantized coefficients
+ * @param samples Output row-major 8x8 block of pixel values (not clamped)
+ * @param method DCT implementation to use
+ * @param cosine_matrix Precomputed cosine coefficients (DCT_METHOD_MATRIX)
+ * @param tables Dequantization tables for the AAN and integer methods
+ * @param type LUMINANCE or CHROMINANCE
+ * @param arena Scratch memory for the matrix and AAN methods
+ */
+static void inverse_transform_block(const int16_t coefficients[BLOCK_COEFFICIENTS], int16_t samples[BLOCK_COEFFICIENTS],
+                                    DCTMethod method, double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE],
+                                    DequantizationTables *tables, QuantizationType type, Arena *arena) {
+    int16_t quantized[BLOCK_COEFFICIENTS];
+    inverse_zigzag_scan_int16(coefficients, quantized);
+
+    if (method == DCT_METHOD_INTEGER) {
+        // The whole chain runs on int16
+        for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+            samples[k] = quantized[k];
+        }
+        dequantize_block_int(samples, tables->int_divisors[type]);
+        idct_islow(samples);
+        for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+            samples[k] = (int16_t) (samples[k] + 128);
+        }
+        return;
+    }
 
-int main(int argc, char *argv[]) {
-    clock_t start, end;
-    double cpu_time_used;
-
-    start = clock();
-    double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
-    compute_cosine_matrix(cosine_matrix);
+    if (method == DCT_METHOD_SIMD) {
+        // Dequantize straight into the prescaled form expected by the float AAN IDCT
+        float data[BLOCK_COEFFICIENTS];
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                data[i * DCT_BLOCK_SIZE + j] = (float) (quantized[i * DCT_BLOCK_SIZE + j] * tables->aan_multipliers[type][i][j]);
+            }
+        }
+        idct_aan_simd(data);
+        for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+            samples[k] = (int16_t) (round(data[k]) + 128);
+        }
+        return;
+    }
 
-    if (argc != 3) {
-        printf("Usage: %s <input.bin> <output.bmp>\n", argv[0]);
-        return 1;
+    // The double routines take row pointers, so hand them a copy of the block on the stack
+    double rows[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+    double *block[DCT_BLOCK_SIZE];
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        block[i] = rows[i];
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            rows[i][j] = quantized[i * DCT_BLOCK_SIZE + j];
+        }
     }
-    FILE *fp = fopen(argv[1], "rb");
-    if (fp == NULL) {
-        printf("Error opening file: %s\n", argv[1]);
-        return 1;
+
+    // Intermediate matrices come from the job arena and are dropped together
+    ArenaMark mark = arena_mark(arena);
+    double **dequantized_block;
+    double **idct_block;
+
+    if (method == DCT_METHOD_AAN) {
+        dequantized_block = dequantize_block_aan_arena(arena, block, tables->aan_multipliers[type]);
+        idct_block = idct_2d_aan_arena(arena, dequantized_block, 1);
+    } else {
+        dequantized_block = dequantize_block_arena(arena, block, 1.0, type);
+        idct_block = idct_2d_arena(arena, dequantized_block, cosine_matrix);
     }
-    BITMAPFILEHEADER file_header;
-    BITMAPINFOHEADER info_header;
 
-    load_bmp_header(fp, &file_header, &info_header);
+    // Unlevel shift the block
+    double **unshifted_block = unlevel_shift_arena(arena, idct_block);
 
-    // entropy decoding
-    Huffman_node *huffman_tree = create_huffman_tree();
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            samples[i * DCT_BLOCK_SIZE + j] = (int16_t) round(unshifted_block[i][j]);
+        }
+    }
 
-    // // Initialize a bit reader for entropy decoding
-    BitReader bit_reader;
+    arena_release(arena, mark);
+}
+
+/**
+ * @brief Reconstructs every block of a coefficient plane into an image channel
+ *
+ * @param plane Input plane of quantized coefficients
+ * @param image Channel data, at least plane->block_rows * 8 by plane->block_cols * 8
+ * @param method DCT implementation to use
+ * @param cosine_matrix Precomputed cosine coefficients (DCT_METHOD_MATRIX)
+ * @param tables Dequantization tables for the AAN and integer methods
+ * @param type LUMINANCE or CHROMINANCE
+ * @param arena Scratch memory for the matrix and AAN methods
+ */
+static void inverse_transform_plane(const CoefficientPlane *plane, unsigned char **image, DCTMethod method,
+                                    double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE],
+                                    DequantizationTables *tables, QuantizationType type, Arena *arena) {
+    int16_t samples[BLOCK_COEFFICIENTS];
+
+    for (int i = 0; i < plane->block_rows; i++) {
+        for (int j = 0; j < plane->block_cols; j++) {
+            inverse_transform_block(coefficient_block(plane, i, j), samples, method, cosine_matrix, tables, type, arena);
+            store_block_samples(samples, image, i * DCT_BLOCK_SIZE, j * DCT_BLOCK_SIZE);
+        }
+    }
+}
+
+/**
+ * @brief Decodes one block with the legacy Huffman tree walk
+ *
+ * @param huffman_tree AC Huffman tree
+ * @param br Source bit reader
+ * @param previous_dc DC predictor of the component, updated
+ * @param block Output zigzag-ordered coefficients
+ */
+static void decode_block_tree(Huffman_node *huffman_tree, BitReader *br, int *previous_dc,
+                              int16_t block[BLOCK_COEFFICIENTS]) {
+    // Read the DC coefficient
+    int dc_category = read_dc_category(br);
+
+    int mantissa = bitreader_read_bits(br, dc_category);
+
+    int diff_dc = decode_value(mantissa, dc_category);
+
+    int current_dc = *previous_dc + diff_dc; // Differential decoding
+    *previous_dc = current_dc; // Update previous DC value
+
+    for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+        block[k] = 0;
+    }
 
-    bitreader_init(&bit_reader, argv[1]);
+    block[0] = (int16_t) current_dc;
 
-    // After load_bmp_header(fp, &file_header, &info_header);
-    fseek(fp, file_header.OffBits, SEEK_SET);
+    int pos = 1;
 
-    fclose(bit_reader.file); // Close the file to reset the file pointer
+    while (pos < 64) {
+        Huffman_node *node = read_ac_category(huffman_tree, br);
 
+        if (node == NULL) {
+            break; // Error in reading AC category
+        }
+        int run = node->run;
+        int category = node->category;
 
-    //jump the header
+        if (run == 0 && category == 0) {
+            break; // EOB
+        }
 
-    bit_reader.file = fp;
+        int ac_mantissa = bitreader_read_bits(br, category);
+        int ac_value = decode_value(ac_mantissa, category);
 
-    // Decode luminance blocks
+        pos += run;
+        if (pos < 64) block[pos++] = (int16_t) ac_value;
+    }
+}
+
+// Entropy decoder state shared by both block orders
+typedef struct {
+    HuffmanDecoder *decoder; // Lookup-table decoder, NULL to walk huffman_tree instead
+    Huffman_node *huffman_tree;
+    BitReader *reader;
+} BlockSource;
+
+/**
+ * @brief Decodes the next block of the bitstream into zigzag-ordered coefficients
+ *
+ * @param source Entropy decoder and bit reader
+ * @param previous_dc DC predictor of the component, updated
+ * @param coefficients Output block
+ */
+static void read_next_block(BlockSource *source, int *previous_dc, int16_t coefficients[BLOCK_COEFFICIENTS]) {
+    if (source->decoder == NULL) {
+        decode_block_tree(source->huffman_tree, source->reader, previous_dc, coefficients);
+        return;
+    }
+    int block[BLOCK_COEFFICIENTS];
+    decode_block(source->decoder, source->reader, previous_dc, block);
+    for (int k = 0; k < BLOCK_COEFFICIENTS; k++) coefficients[k] = (int16_t) block[k];
+}
+
+/**
+ * @brief Decodes every block of the image, in sequential or MCU order
+ *
+ * Sequential order is all Y blocks, then Cb and Cr alternating; MCU order is
+ * the up to four Y blocks of each 16x16 MCU followed by its Cb and Cr blocks,
+ * optionally split into restart intervals.
+ *
+ * @param source Entropy decoder and bit reader
+ * @param coefficients Destination planes, sized for the order
+ * @param interleaved Whether blocks are stored in MCU order
+ * @param restart_interval MCUs per restart interval, 0 for none
+ * @return 0 on success, -1 if a restart marker is missing
+ */
+static int read_coefficients(BlockSource *source, CoefficientBuffer *coefficients, int interleaved,
+                             int restart_interval) {
     int previous_dc = 0; // Reset previous DC value
+    int previous_dc_cb = 0;
+    int previous_dc_cr = 0;
 
-    int *block;
-
-    int luminance_height = info_header.Height / DCT_BLOCK_SIZE;
-    int luminance_width = info_header.Width / DCT_BLOCK_SIZE;
-
-    int chrominance_height = (luminance_height / 2) + (luminance_height / 2) % 2;
-    int chrominance_width = (luminance_width / 2) + (luminance_width / 2) % 2;
-
-    ZigzagMatrix zigzag_matrix = init_zigzag_matrix(luminance_height, luminance_width, chrominance_height, chrominance_width);
-
-    for (int i = 0; i < luminance_height; i++) {
-        for (int j = 0; j < luminance_width; j++) {
-            // Read the DC coefficient for the luminance block
-            int dc_category = read_dc_category(&bit_reader);
-
-            int mantissa = bitreader_read_bits(&bit_reader, dc_category);
-
-            int diff_dc = decode_value(mantissa, dc_category);
-
-            int current_dc = previous_dc + diff_dc; // Differential decoding
-            previous_dc = current_dc; // Update previous DC value
-
-            block = init_int_array(DCT_BLOCK_SIZE * DCT_BLOCK_SIZE);
+    if (!interleaved) {
+        for (int b = 0; b < coefficient_block_count(&coefficients->y); b++) {
+            read_next_block(source, &previous_dc, coefficient_block_at(&coefficients->y, b));
+        }
+        for (int b = 0; b < coefficient_block_count(&coefficients->cb); b++) {
+            read_next_block(source, &previous_dc_cb, coefficient_block_at(&coefficients->cb, b));
+            read_next_block(source, &previous_dc_cr, coefficient_block_at(&coefficients->cr, b));
+        }
+        return 0;
+    }
 
-            for (int x = 0; x < DCT_BLOCK_SIZE; x++) {
-                for (int y = 0; y < DCT_BLOCK_SIZE; y++) {
-                    block[x * DCT_BLOCK_SIZE + y] = 0;
+    int mcu = 0;
+    for (int r = 0; r < coefficients->cb.block_rows; r++) {
+        for (int c = 0; c < coefficients->cb.block_cols; c++, mcu++) {
+            if (restart_interval > 0 && mcu > 0 && mcu % restart_interval == 0) {
+                if (read_restart_marker(source->reader, mcu / restart_interval) != 0) {
+                    return -1;
                 }
+                previous_dc = 0;
+                previous_dc_cb = 0;
+                previous_dc_cr = 0;
             }
-
-            block[0] = current_dc;
-
-            int pos = 1;
-
-            while (pos < 64) {
-                Huffman_node *node = read_ac_category(huffman_tree, &bit_reader);
-
-                if (node == NULL) {
-                    break; // Error in reading AC category
+            for (int k = 0; k < MCU_LUMA_BLOCKS * MCU_LUMA_BLOCKS; k++) {
+                int row = r * MCU_LUMA_BLOCKS + k / MCU_LUMA_BLOCKS;
+                int col = c * MCU_LUMA_BLOCKS + k % MCU_LUMA_BLOCKS;
+                if (row < coefficients->y.block_rows && col < coefficients->y.block_cols) {
+                    read_next_block(source, &previous_dc, coefficient_block(&coefficients->y, row, col));
                 }
-                int run = node->run;
-                int category = node->category;
-                
-                if (run == 0 && category == 0) {
-                    break; // EOB
-                }
-                
-                int ac_mantissa = bitreader_read_bits(&bit_reader, category);
-                int ac_value = decode_value(ac_mantissa, category);
-
-                for (int z = 0; z < run && pos < 64; z++) block[pos++] = 0;
-                if (pos < 64) block[pos++] = ac_value;
             }
-            zigzag_matrix.y_zigzag[i][j] = block;
+            read_next_block(source, &previous_dc_cb, coefficient_block(&coefficients->cb, r, c));
+            read_next_block(source, &previous_dc_cr, coefficient_block(&coefficients->cr, r, c));
         }
     }
+    return 0;
+}
+
+// Destination of the streaming decoder's scanlines
+typedef struct {
+    FILE *file;
+    int row_stride;
+} ScanlineWriter;
+
+/**
+ * @brief Scanline callback appending padded rows to the output bitmap
+ */
+static void write_scanlines(void *context, unsigned char **rows, int first_row, int count) {
+    ScanlineWriter *writer = (ScanlineWriter *) context;
+    (void) first_row;
+    for (int k = 0; k < count; k++) {
+        fwrite(rows[k], 1, (size_t) writer->row_stride, writer->file);
+    }
+}
+
+/**
+ * @brief Decodes one MCU row at a time, writing scanlines as they are produced
+ *
+ * The compressed file is still loaded whole. Only interleaved files are
+ * decoded in one pass; sequential ones prescan their Y blocks first.
+ *
+ * @return Process exit status
+ */
+static int decode_streaming(const uint8_t *data, size_t size, const char *output, DCTMethod dct_method,
+                            int fancy_upsampling) {
+    StreamDecoder decoder;
+    if (stream_decoder_init(&decoder, data, size, dct_method, fancy_upsampling) != 0) {
+        printf("Invalid compressed file\n");
+        return 1;
+    }
 
-    // Decode chrominance blocks
-    int previous_dc_cb = 0;
-    int previous_dc_cr = 0;
-
-    for (int i = 0; i < chrominance_height; i++) {
-        for (int j = 0; j < chrominance_width; j++) {
-            // Read the DC coefficient for the chrominance blue block
-            int dc_category = read_dc_category(&bit_reader);
-
-            int mantissa = bitreader_read_bits(&bit_reader, dc_category);
+    FILE *fp = fopen(output, "wb");
+    if (fp == NULL) {
+        printf("Error opening file for writing: %s\n", output);
+        stream_decoder_close(&decoder);
+        return 1;
+    }
 
-            int diff_dc = decode_value(mantissa, dc_category);
+    // Both headers, then zeros up to the original pixel offset
+    unsigned char headers[BMP_HEADERS_SIZE];
+    serialize_bmp_headers(headers, &decoder.file_header, &decoder.info_header);
+    fwrite(headers, 1, BMP_HEADERS_SIZE, fp);
+    for (int i = BMP_HEADERS_SIZE; i < (int) decoder.file_header.OffBits; i++) {
+        fputc(0, fp);
+    }
 
-            int current_dc = previous_dc_cb + diff_dc;
+    ScanlineWriter writer;
+    writer.file = fp;
+    writer.row_stride = bmp_row_stride(decoder.width);
+    stream_decoder_run(&decoder, write_scanlines, &writer);
 
-            previous_dc_cb = current_dc; // Update previous DC value
+    fclose(fp);
+    int status = 0;
+    if (decoder.restart_errors > 0) {
+        printf("Missing restart marker (%d)\n", decoder.restart_errors);
+        status = 1;
+    }
+    stream_decoder_close(&decoder);
+    return status;
+}
 
-            block = init_int_array(DCT_BLOCK_SIZE * DCT_BLOCK_SIZE);
+int main(int argc, char *argv[]) {
+    clock_t start, end;
+    double cpu_time_used;
 
-            for (int x = 0; x < DCT_BLOCK_SIZE; x++) {
-                for (int y = 0; y < DCT_BLOCK_SIZE; y++) {
-                    block[x * DCT_BLOCK_SIZE + y] = 0;
-                }
-            }
-            
-            block[0] = current_dc;
-
-            int pos = 1;
-            while (pos < 64) {
-                Huffman_node *node = read_ac_category(huffman_tree, &bit_reader);
-                
-                
-                if (node == NULL) {
-                    break; // Error in reading AC category
-                }
-                int run = node->run;
-                int category = node->category;
-                
-                if (run == 0 && category == 0) {
-                    break; // EOB
-                }
-                
-                int ac_mantissa = bitreader_read_bits(&bit_reader, category);
-                int ac_value = decode_value(ac_mantissa, category);
+    start = clock();
+    double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+    compute_cosine_matrix(cosine_matrix);
 
-                for (int z = 0; z < run && pos < 64; z++) block[pos++] = 0;
-                if (pos < 64) block[pos++] = ac_value;
+    if (argc < 3) {
+        printf("Usage: %s <input.bin> <output.bmp> [--huffman=table|tree] [--dct=matrix|aan|int|simd] [--pipeline=fused|staged] [--upsampling=fused|fancy|staged] [--streaming] [--threads=N]\n", argv[0]);
+        return 1;
+    }
 
-                
+    // Select the entropy decoder (lookup tables by default)
+    int use_lookup_decoder = 1;
+    DCTMethod dct_method = DCT_METHOD_MATRIX;
+    int use_fused_kernel = 1;
+    // 0 = duplicate chroma in a separate pass, 1 = duplicate per row, 2 = triangle filter per row
+    int upsampling_mode = 1;
+    int use_streaming = 0;
+    int thread_count = 1;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--huffman=table") == 0) {
+            use_lookup_decoder = 1;
+        } else if (strcmp(argv[i], "--huffman=tree") == 0) {
+            use_lookup_decoder = 0;
+        } else if (strcmp(argv[i], "--dct=matrix") == 0) {
+            dct_method = DCT_METHOD_MATRIX;
+        } else if (strcmp(argv[i], "--dct=aan") == 0) {
+            dct_method = DCT_METHOD_AAN;
+        } else if (strcmp(argv[i], "--dct=int") == 0) {
+            dct_method = DCT_METHOD_INTEGER;
+        } else if (strcmp(argv[i], "--dct=simd") == 0) {
+            dct_method = DCT_METHOD_SIMD;
+        } else if (strcmp(argv[i], "--pipeline=fused") == 0) {
+            use_fused_kernel = 1;
+        } else if (strcmp(argv[i], "--pipeline=staged") == 0) {
+            use_fused_kernel = 0;
+        } else if (strcmp(argv[i], "--upsampling=staged") == 0) {
+            upsampling_mode = 0;
+        } else if (strcmp(argv[i], "--upsampling=fused") == 0) {
+            upsampling_mode = 1;
+        } else if (strcmp(argv[i], "--upsampling=fancy") == 0) {
+            upsampling_mode = 2;
+        } else if (strcmp(argv[i], "--streaming") == 0) {
+            use_streaming = 1;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            thread_count = atoi(argv[i] + 10);
+            if (thread_count < 1) {
+                thread_count = thread_pool_default_threads();
             }
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    // Load the whole compressed file and decode it from memory
+    FILE *fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        printf("Error opening file: %s\n", argv[1]);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char *data = (unsigned char *)malloc(file_size > 0 ? (size_t) file_size : 1);
+    if (data == NULL || fread(data, 1, (size_t) file_size, fp) != (size_t) file_size) {
+        printf("Error reading file: %s\n", argv[1]);
+        fclose(fp);
+        free(data);
+        return 1;
+    }
+    fclose(fp);
 
-            zigzag_matrix.cb_zigzag[i][j] = block;
-
-            dc_category = read_dc_category(&bit_reader);
-
-            mantissa = bitreader_read_bits(&bit_reader, dc_category);
-
-            diff_dc = decode_value(mantissa, dc_category);
-
-            current_dc = previous_dc_cr + diff_dc;
-
-            previous_dc_cr = current_dc; // Update previous DC value
-
-            block = init_int_array(DCT_BLOCK_SIZE * DCT_BLOCK_SIZE);
-
-            for (int x = 0; x < DCT_BLOCK_SIZE; x++) {
-                for (int y = 0; y < DCT_BLOCK_SIZE; y++) {
-                    block[x * DCT_BLOCK_SIZE + y] = 0;
-                }
-            }
+    BITMAPFILEHEADER file_header;
+    BITMAPINFOHEADER info_header;
 
-            block[0] = current_dc;
+    if (parse_bmp_headers(data, (size_t) file_size, &file_header, &info_header) != 0 ||
+        file_header.OffBits > (unsigned int) file_size) {
+        printf("Invalid compressed file: %s\n", argv[1]);
+        free(data);
+        return 1;
+    }
+    print_bmp_headers(&file_header, &info_header);
+
+    // The layout flags are not part of the decoded bitmap
+    int interleaved = bin_is_interleaved(&file_header);
+    int restart_interval = bin_restart_interval(&file_header);
+    int has_segment_table = bin_has_segment_table(&file_header);
+    file_header.Reserved1 = 0;
+    file_header.Reserved2 = 0;
+
+    if (use_streaming) {
+        // Scanlines go out one MCU row at a time, no full-size planes
+        int status = decode_streaming(data, (size_t) file_size, argv[2], dct_method, upsampling_mode == 2);
+        free(data);
+        end = clock();
+        cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+        printf("Time taken: %f seconds\n", cpu_time_used);
+        return status;
+    }
 
-            pos = 1;
+    // entropy decoding
+    Huffman_node *huffman_tree = create_huffman_tree();
 
-            while (pos < 64) {
-                Huffman_node *node = read_ac_category(huffman_tree, &bit_reader);
+    int luminance_height = info_header.Height / DCT_BLOCK_SIZE;
+    int luminance_width = info_header.Width / DCT_BLOCK_SIZE;
 
-                if (node == NULL) {
-                    break; // Error in reading AC category
-                }
-                int run = node->run;
-                int category = node->category;
+    // One Cb and one Cr block per MCU, partial MCUs included, in either order
+    int chrominance_height = mcu_count(luminance_height);
+    int chrominance_width = mcu_count(luminance_width);
+
+    // One flat allocation of zigzag-ordered blocks per component
+    CoefficientBuffer coefficients = init_coefficient_buffer(luminance_height, luminance_width,
+                                                             chrominance_height, chrominance_width);
+
+    // The bitstream follows the segment table, if there is one
+    size_t bitstream_offset = file_header.OffBits;
+    uint32_t *segment_offsets = NULL;
+    if (has_segment_table) {
+        int segment_count = bin_segment_count(mcu_total(&coefficients), restart_interval);
+        bitstream_offset += bin_segment_table_size(segment_count);
+        segment_offsets = (uint32_t *)malloc((size_t) segment_count * sizeof(uint32_t));
+        if (segment_offsets == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (bitstream_offset > (size_t) file_size ||
+            parse_segment_table(data + file_header.OffBits, (size_t) file_size - file_header.OffBits, segment_count,
+                                (size_t) file_size - bitstream_offset, segment_offsets) != 0) {
+            printf("Invalid segment table in %s\n", argv[1]);
+            free(segment_offsets);
+            free(data);
+            free_huffman_tree(huffman_tree);
+            free_coefficient_buffer(&coefficients);
+            return 1;
+        }
+    }
 
-                if (run == 0 && category == 0) {
-                    break; // EOB
-                }
+    // Initialize a bit reader for entropy decoding, right after the header
+    BitReader bit_reader;
 
-                int ac_mantissa = bitreader_read_bits(&bit_reader, category);
-                int ac_value = decode_value(ac_mantissa, category);
+    bitreader_init_memory(&bit_reader, data + bitstream_offset, (size_t) file_size - bitstream_offset);
 
-                for (int z = 0; z < run && pos < 64; z++) block[pos++] = 0;
-                if (pos < 64) block[pos++] = ac_value;
-            }
-            zigzag_matrix.cr_zigzag[i][j] = block;
-        }
+    // Workers shared by the segments and the inverse transform
+    ThreadPool pool;
+    if (thread_pool_init(&pool, thread_count) != 0) {
+        printf("Error creating worker threads\n");
+        return 1;
     }
 
-    // Convert zigzag arrays back to DCT blocks
-    DCTBlocks quantized_blocks = arrays_to_blocks(zigzag_matrix);
-
-    // Free the zigzag matrix
-    free_zigzag_matrix(&zigzag_matrix);
-
-    DCTBlocks blocks = init_dct_blocks(luminance_height, luminance_width, chrominance_height, chrominance_width);
-
-    // Dequantize quantized_blocks to blocks
-    for (int i = 0; i < quantized_blocks.luminance_height; i++) {
-        for (int j = 0; j < quantized_blocks.luminance_width; j++) {
-            // Dequantize the block
-            double **dequantized_block = dequantize_block(quantized_blocks.y_blocks[i][j], 1.0, LUMINANCE);
-            // Perform IDCT on the dequantized block
-            double **idct_block = idct_2d(dequantized_block, cosine_matrix);
-            // Unlevel shift the block
-            double **unshifted_block = unlevel_shift(idct_block);
-            // Store the unlevel shifted block
-            blocks.y_blocks[i][j] = unshifted_block;
-            // Free the dequantized block
-            free_double_matrix(dequantized_block, DCT_BLOCK_SIZE);
-            // Free the IDCT block
-            free_double_matrix(idct_block, DCT_BLOCK_SIZE);
-        }
+    BlockSource source;
+    source.decoder = use_lookup_decoder ? create_huffman_decoder() : NULL;
+    source.huffman_tree = huffman_tree;
+    source.reader = &bit_reader;
+
+    int status;
+    if (segment_offsets != NULL && source.decoder != NULL) {
+        // Every restart interval from its own offset, in parallel
+        status = decode_restart_segments(&pool, source.decoder, data + bitstream_offset,
+                                         (size_t) file_size - bitstream_offset, segment_offsets,
+                                         &coefficients, restart_interval);
+    } else {
+        status = read_coefficients(&source, &coefficients, interleaved, restart_interval);
     }
+    free(segment_offsets);
 
-    for (int i = 0; i < quantized_blocks.chrominance_height; i++) {
-        for (int j = 0; j < quantized_blocks.chrominance_width; j++) {
-            // Dequantize the block
-            double **dequantized_block_cb = dequantize_block(quantized_blocks.cb_blocks[i][j], 1.0, CHROMINANCE);
-            double **dequantized_block_cr = dequantize_block(quantized_blocks.cr_blocks[i][j], 1.0, CHROMINANCE);
-            // Perform IDCT on the dequantized block
-            double **idct_block_cb = idct_2d(dequantized_block_cb, cosine_matrix);
-            double **idct_block_cr = idct_2d(dequantized_block_cr, cosine_matrix);
-            // Unlevel shift the block
-            double **unshifted_block_cb = unlevel_shift(idct_block_cb);
-            double **unshifted_block_cr = unlevel_shift(idct_block_cr);
-            // Store the IDCT block
-            blocks.cb_blocks[i][j] = unshifted_block_cb;
-            blocks.cr_blocks[i][j] = unshifted_block_cr;
-            // Free the dequantized block
-            free_double_matrix(dequantized_block_cb, DCT_BLOCK_SIZE);
-            free_double_matrix(dequantized_block_cr, DCT_BLOCK_SIZE);
-            // Free the IDCT block
-            free_double_matrix(idct_block_cb, DCT_BLOCK_SIZE);
-            free_double_matrix(idct_block_cr, DCT_BLOCK_SIZE);
-        }
+    if (source.decoder != NULL) {
+        free_huffman_decoder(source.decoder);
+    }
+    if (status != 0) {
+        printf("Missing restart marker in %s\n", argv[1]);
+        bitreader_close(&bit_reader);
+        free(data);
+        free_huffman_tree(huffman_tree);
+        free_coefficient_buffer(&coefficients);
+        thread_pool_destroy(&pool);
+        return 1;
     }
-    // Free the quantized blocks
-    free_dct_blocks(&quantized_blocks);
 
-    // Create YCbCr_420 structure
-    YCbCr_Image_420 subsampled_image = init_ycbcr_image_420();
+    bitreader_close(&bit_reader);
+    free(data);
+    free_huffman_tree(huffman_tree);
 
-    // Merge the blocks back into a YCbCr image
-    subsampled_image = merge_blocks_into_ycbcr_420(blocks);
+    // Dequantization tables for the AAN (prescaling folded in) and integer methods
+    DequantizationTables tables;
+    compute_aan_dequantization_table(tables.aan_multipliers[LUMINANCE], 1.0, LUMINANCE);
+    compute_aan_dequantization_table(tables.aan_multipliers[CHROMINANCE], 1.0, CHROMINANCE);
+    compute_int_quantization_table(tables.int_divisors[LUMINANCE], 1.0, LUMINANCE);
+    compute_int_quantization_table(tables.int_divisors[CHROMINANCE], 1.0, CHROMINANCE);
 
-    // Free the blocks
-    free_dct_blocks(&blocks);
+    // Decoded image: aligned planes from the fused kernels, row matrices from the staged chain
+    PlanarImage planar_image;
+    YCbCr_Image_420 subsampled_image = init_ycbcr_image_420();
 
+    if (use_fused_kernel) {
+        // One pass per block from the coefficient buffer into contiguous planes, MCU rows across threads
+        BlockKernel kernels[2];
+        init_block_kernel(&kernels[LUMINANCE], dct_method, 1.0, LUMINANCE);
+        init_block_kernel(&kernels[CHROMINANCE], dct_method, 1.0, CHROMINANCE);
+
+        planar_image.planes[0] = init_image_plane(luminance_height * DCT_BLOCK_SIZE, luminance_width * DCT_BLOCK_SIZE);
+        planar_image.planes[1] = init_image_plane(chrominance_height * DCT_BLOCK_SIZE, chrominance_width * DCT_BLOCK_SIZE);
+        planar_image.planes[2] = init_image_plane(chrominance_height * DCT_BLOCK_SIZE, chrominance_width * DCT_BLOCK_SIZE);
+
+        parallel_inverse_transform(&pool, &coefficients, &planar_image, kernels);
+    } else {
+        // Reconstruct the blocks straight into a YCbCr_420 image
+        subsampled_image.luminance_height = luminance_height * DCT_BLOCK_SIZE;
+        subsampled_image.luminance_width = luminance_width * DCT_BLOCK_SIZE;
+        subsampled_image.chrominance_height = chrominance_height * DCT_BLOCK_SIZE;
+        subsampled_image.chrominance_width = chrominance_width * DCT_BLOCK_SIZE;
+        subsampled_image.y = init_uchar_matrix(subsampled_image.luminance_height, subsampled_image.luminance_width);
+        subsampled_image.cb = init_uchar_matrix(subsampled_image.chrominance_height, subsampled_image.chrominance_width);
+        subsampled_image.cr = init_uchar_matrix(subsampled_image.chrominance_height, subsampled_image.chrominance_width);
+
+        // Per-block scratch memory for the whole job, released in one shot
+        Arena arena;
+        arena_init(&arena, 0);
+
+        inverse_transform_plane(&coefficients.y, subsampled_image.y, dct_method, cosine_matrix, &tables, LUMINANCE, &arena);
+        inverse_transform_plane(&coefficients.cb, subsampled_image.cb, dct_method, cosine_matrix, &tables, CHROMINANCE, &arena);
+        inverse_transform_plane(&coefficients.cr, subsampled_image.cr, dct_method, cosine_matrix, &tables, CHROMINANCE, &arena);
+
+        arena_destroy(&arena);
+    }
 
-    YCbCr_Image ycbcr_image = init_ycbcr_image();
+    thread_pool_destroy(&pool);
 
-    // Upsample the YCbCr_420 image to YCbCr
-    ycbcr_upsampling_420(&ycbcr_image, subsampled_image);
-    // Free the YCbCr_420 image
-    free_ycbcr_image_420(&subsampled_image);
-    // Convert YCbCr to RGB
-    RGB_Image rgb_image = init_rgb_image();
+    // Free the coefficient planes
+    free_coefficient_buffer(&coefficients);
 
-    ycbcr_to_rgb(&rgb_image, ycbcr_image);
-    // Free the YCbCr image
-    free_ycbcr_image(&ycbcr_image);
-    // Save the RGB image to a new BMP file
-    save_rgb_image(argv[2], rgb_image, &file_header, &info_header);
-    // Free the RGB image
-    free_rgb_image(&rgb_image);
+    if (upsampling_mode != 0) {
+        if (!use_fused_kernel) {
+            planar_image = ycbcr_image_420_to_planar(subsampled_image);
+            free_ycbcr_image_420(&subsampled_image);
+        }
+        // Upsample, convert and interleave one output row at a time, straight from the planes
+        save_ycbcr_image_420(argv[2], &planar_image, upsampling_mode == 2, &file_header, &info_header);
+        free_planar_image(&planar_image);
+    } else {
+        if (use_fused_kernel) {
+            // The staged upsampling reads row matrices
+            subsampled_image = planar_to_ycbcr_image_420(&planar_image);
+            free_planar_image(&planar_image);
+        }
+        YCbCr_Image ycbcr_image = init_ycbcr_image();
+
+        // Upsample the YCbCr_420 image to YCbCr
+        ycbcr_upsampling_420(&ycbcr_image, subsampled_image);
+        // Free the YCbCr_420 image
+        free_ycbcr_image_420(&subsampled_image);
+        // Convert YCbCr to RGB
+        RGB_Image rgb_image = init_rgb_image();
+
+        ycbcr_to_rgb(&rgb_image, ycbcr_image);
+        // Free the YCbCr image
+        free_ycbcr_image(&ycbcr_image);
+        // Save the RGB image to a new BMP file
+        save_rgb_image(argv[2], rgb_image, &file_header, &info_header);
+        // Free the RGB image
+        free_rgb_image(&rgb_image);
+    }
 
     end = clock(); // Record end time
 
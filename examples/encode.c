@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "quantization.h"
 #include "dct.h"
 #include "heap_manager.h"
@@ -11,6 +12,228 @@
 #include "ac_encode.h"
 #include "dc_encode.h"
 #include "huffman.h"
+#include "coefficients.h"
+#include "block_kernel.h"
+#include "stream_encoder.h"
+#include "bin_format.h"
+#include "parallel_transform.h"
+#include "entropy_segments.h"
+#include "pipeline_encoder.h"
+
+// Quantization tables precomputed for each DCT method, indexed by QuantizationType
+typedef struct {
+    double aan_divisors[2][DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+    uint16_t int_divisors[2][DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+} QuantizationTables;
+
+/**
+ * @brief Level shift, DCT, quantization and zigzag scan of one block
+ *
+ * @param samples Input row-major 8x8 block of pixel values
+ * @param coefficients Output zigzag-ordered quantized coefficients
+ * @param method DCT implementation to use
+ * @param cosine_matrix Precomputed cosine coefficients (DCT_METHOD_MATRIX)
+ * @param tables Quantization tables for the AAN and integer methods
+ * @param type LUMINANCE or CHROMINANCE
+ * @param arena Scratch memory for the matrix and AAN methods
+ */
+static void transform_block(const int16_t samples[BLOCK_COEFFICIENTS], int16_t coefficients[BLOCK_COEFFICIENTS],
+                            DCTMethod method, double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE],
+                            QuantizationTables *tables, QuantizationType type, Arena *arena) {
+    int16_t quantized[BLOCK_COEFFICIENTS];
+
+    if (method == DCT_METHOD_INTEGER) {
+        // The whole chain runs on int16
+        for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+            quantized[k] = (int16_t) (samples[k] - 128);
+        }
+        fdct_islow(quantized);
+        quantize_block_int(quantized, tables->int_divisors[type]);
+    } else if (method == DCT_METHOD_SIMD) {
+        // Float AAN on vector registers, the scale factors are folded into the divisors
+        float data[BLOCK_COEFFICIENTS];
+        for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+            data[k] = (float) (samples[k] - 128);
+        }
+        fdct_aan_simd(data);
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                quantized[i * DCT_BLOCK_SIZE + j] = (int16_t) round(data[i * DCT_BLOCK_SIZE + j] / tables->aan_divisors[type][i][j]);
+            }
+        }
+    } else {
+        // The double routines take row pointers, so hand them a copy of the block on the stack
+        double rows[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+        double *block[DCT_BLOCK_SIZE];
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+            block[i] = rows[i];
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                rows[i][j] = samples[i * DCT_BLOCK_SIZE + j];
+            }
+        }
+
+        // Intermediate matrices come from the job arena and are dropped together
+        ArenaMark mark = arena_mark(arena);
+        double **shifted_block = level_shift_arena(arena, block);
+        double **dct_block;
+        double **quantized_block;
+
+        if (method == DCT_METHOD_AAN) {
+            // Scaled AAN output, the scale factors are folded into the divisors
+            dct_block = dct_2d_aan_arena(arena, shifted_block, 0);
+            quantized_block = quantize_block_aan_arena(arena, dct_block, tables->aan_divisors[type]);
+        } else {
+            dct_block = dct_2d_arena(arena, shifted_block, cosine_matrix);
+            quantized_block = quantize_block_arena(arena, dct_block, 1.0, type);
+        }
+
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                quantized[i * DCT_BLOCK_SIZE + j] = (int16_t) round(quantized_block[i][j]);
+            }
+        }
+
+        arena_release(arena, mark);
+    }
+
+    zigzag_scan_int16(quantized, coefficients);
+}
+
+/**
+ * @brief Transforms every block of one image channel into a coefficient plane
+ *
+ * @param image Channel data, at least plane->block_rows * 8 by plane->block_cols * 8
+ * @param plane Output plane, already allocated
+ * @param method DCT implementation to use
+ * @param cosine_matrix Precomputed cosine coefficients (DCT_METHOD_MATRIX)
+ * @param tables Quantization tables for the AAN and integer methods
+ * @param type LUMINANCE or CHROMINANCE
+ * @param arena Scratch memory for the matrix and AAN methods
+ */
+static void transform_plane(unsigned char **image, CoefficientPlane *plane, DCTMethod method,
+                            double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE],
+                            QuantizationTables *tables, QuantizationType type, Arena *arena) {
+    int16_t samples[BLOCK_COEFFICIENTS];
+
+    for (int i = 0; i < plane->block_rows; i++) {
+        for (int j = 0; j < plane->block_cols; j++) {
+            load_block_samples(image, i * DCT_BLOCK_SIZE, j * DCT_BLOCK_SIZE, samples);
+            transform_block(samples, coefficient_block(plane, i, j), method, cosine_matrix, tables, type, arena);
+        }
+    }
+}
+
+/**
+ * @brief Entropy codes one block of zigzag-ordered coefficients
+ *
+ * @param bw Destination bit writer
+ * @param block Zigzag-ordered quantized coefficients
+ * @param previous_dc DC predictor of the component, updated
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ */
+static void encode_block(BitWriter *bw, const int16_t block[BLOCK_COEFFICIENTS], int *previous_dc,
+                         DCEncoder dc_encoder, ACEncoder ac_encoder) {
+    int coefficients[BLOCK_COEFFICIENTS];
+    for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+        coefficients[k] = block[k];
+    }
+
+    dc_encoder(bw, coefficients[0], *previous_dc);
+    ac_encoder(bw, coefficients);
+    *previous_dc = coefficients[0];
+}
+
+/**
+ * @brief Encodes a bitmap one MCU row at a time with bounded memory
+ *
+ * Reads STREAM_MCU_ROWS stored rows per fread and hands them to the
+ * streaming encoder, so neither the source nor any full-size intermediate
+ * is held in memory. With pipeline_workers > 0 the rows go through
+ * pipeline_encode_file instead, which reads, transforms and entropy codes on
+ * separate threads; its output is always interleaved.
+ *
+ * @return Process exit status
+ */
+static int encode_streaming(const char *input, const char *output, DCTMethod dct_method,
+                            DCEncoder dc_encoder, ACEncoder ac_encoder, int use_fixed_color, const BinLayout *layout,
+                            int pipeline_workers) {
+    FILE *fp = fopen(input, "rb");
+    if (fp == NULL) {
+        printf("Error opening file: %s\n", input);
+        return 1;
+    }
+    BITMAPFILEHEADER file_header;
+    BITMAPINFOHEADER info_header;
+    load_bmp_header(fp, &file_header, &info_header);
+    fseek(fp, file_header.OffBits, SEEK_SET); // Skip the header
+
+    FILE *out = fopen(output, "wb");
+    if (out == NULL) {
+        printf("Error opening file for writing: %s\n", output);
+        fclose(fp);
+        return 1;
+    }
+
+    int row_stride = bmp_row_stride(info_header.Width);
+    size_t compressed_size;
+    int truncated = 0;
+    if (pipeline_workers > 0) {
+        PipelineResult result;
+        if (pipeline_encode_file(fp, &file_header, &info_header, out, dct_method, dc_encoder, ac_encoder,
+                                 use_fixed_color, layout, pipeline_workers, &result) != 0) {
+            printf("Error running the encoding pipeline for %s\n", output);
+            fclose(out);
+            fclose(fp);
+            return 1;
+        }
+        compressed_size = result.compressed_size;
+        truncated = result.truncated;
+    } else {
+        StreamEncoder encoder;
+        if (stream_encoder_init(&encoder, out, &file_header, &info_header, dct_method,
+                                dc_encoder, ac_encoder, use_fixed_color, layout) != 0) {
+            printf("Error creating temporary file\n");
+            fclose(out);
+            fclose(fp);
+            return 1;
+        }
+
+        unsigned char *strip = (unsigned char *)calloc((size_t) row_stride * STREAM_MCU_ROWS, 1);
+        if (strip == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < info_header.Height; i += STREAM_MCU_ROWS) {
+            int rows = info_header.Height - i < STREAM_MCU_ROWS ? info_header.Height - i : STREAM_MCU_ROWS;
+            if (read_bmp_rows(fp, strip, row_stride, rows)) {
+                truncated = 1;
+            }
+            stream_encoder_write_rows(&encoder, strip, row_stride, rows);
+        }
+        free(strip);
+        if (stream_encoder_finish(&encoder) != 0) {
+            printf("Error writing file: %s\n", output);
+            fclose(out);
+            fclose(fp);
+            return 1;
+        }
+        compressed_size = encoder.compressed_size;
+    }
+    if (truncated) {
+        fprintf(stderr, "Warning: bitmap pixel data is truncated\n");
+    }
+    fclose(fp);
+    fclose(out);
+
+    int image_size = (int) (file_header.OffBits + (size_t) row_stride * info_header.Height);
+    printf("Compression information:\n");
+
+    printf("Compressed size: %d bytes\n", (int) compressed_size);
+    printf("Original size: %d bytes\n", image_size);
+    printf("Compression ratio: %.2f%%\n", ((double) compressed_size / (double) image_size) * 100);
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
     clock_t start, end;
@@ -20,165 +243,278 @@ int main(int argc, char *argv[]) {
     double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
     compute_cosine_matrix(cosine_matrix);
 
-    if (argc != 3) {
-        printf("Usage: %s <input.bmp> <output.bin>\n", argv[0]);
+    if (argc < 3) {
+        printf("Usage: %s <input.bmp> <output.bin> [--huffman=table|string] [--dct=matrix|aan|int|simd] [--pipeline=fused|staged] [--input=mmap|stdio] [--color=float|fixed] [--subsampling=fused|staged] [--streaming] [--order=sequential|interleaved] [--threads=N] [--restart=MCUS|row] [--segment-table=on|off] [--pipelined]\n", argv[0]);
         return 1;
     }
-    FILE *fp = fopen(argv[1], "rb");
-    if (fp == NULL) {
-        printf("Error opening file: %s\n", argv[1]);
-        return 1;
+
+    // Select the entropy encoder backend (table-driven by default)
+    DCEncoder dc_encoder = encode_dc_table;
+    ACEncoder ac_encoder = encode_ac_table;
+    DCTMethod dct_method = DCT_METHOD_MATRIX;
+    int use_fused_kernel = 1;
+    int use_mapped_input = 1;
+    int use_fixed_color = 0;
+    int use_fused_subsampling = 1;
+    int use_streaming = 0;
+    int use_pipeline = 0;
+    BinLayout layout;
+    layout.interleaved = 0;
+    layout.restart_interval = 0;
+    layout.segment_table = 1;
+    int thread_count = 1;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--huffman=table") == 0) {
+            dc_encoder = encode_dc_table;
+            ac_encoder = encode_ac_table;
+        } else if (strcmp(argv[i], "--huffman=string") == 0) {
+            dc_encoder = encode_dc;
+            ac_encoder = encode_ac;
+        } else if (strcmp(argv[i], "--dct=matrix") == 0) {
+            dct_method = DCT_METHOD_MATRIX;
+        } else if (strcmp(argv[i], "--dct=aan") == 0) {
+            dct_method = DCT_METHOD_AAN;
+        } else if (strcmp(argv[i], "--dct=int") == 0) {
+            dct_method = DCT_METHOD_INTEGER;
+        } else if (strcmp(argv[i], "--dct=simd") == 0) {
+            dct_method = DCT_METHOD_SIMD;
+        } else if (strcmp(argv[i], "--pipeline=fused") == 0) {
+            use_fused_kernel = 1;
+        } else if (strcmp(argv[i], "--pipeline=staged") == 0) {
+            use_fused_kernel = 0;
+        } else if (strcmp(argv[i], "--input=mmap") == 0) {
+            use_mapped_input = 1;
+        } else if (strcmp(argv[i], "--input=stdio") == 0) {
+            use_mapped_input = 0;
+        } else if (strcmp(argv[i], "--color=float") == 0) {
+            use_fixed_color = 0;
+        } else if (strcmp(argv[i], "--color=fixed") == 0) {
+            use_fixed_color = 1;
+        } else if (strcmp(argv[i], "--subsampling=fused") == 0) {
+            use_fused_subsampling = 1;
+        } else if (strcmp(argv[i], "--subsampling=staged") == 0) {
+            use_fused_subsampling = 0;
+        } else if (strcmp(argv[i], "--streaming") == 0) {
+            use_streaming = 1;
+        } else if (strcmp(argv[i], "--pipelined") == 0) {
+            use_pipeline = 1;
+        } else if (strcmp(argv[i], "--order=sequential") == 0) {
+            layout.interleaved = 0;
+        } else if (strcmp(argv[i], "--order=interleaved") == 0) {
+            layout.interleaved = 1;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            thread_count = atoi(argv[i] + 10);
+            if (thread_count < 1) {
+                thread_count = thread_pool_default_threads();
+            }
+        } else if (strcmp(argv[i], "--restart=row") == 0) {
+            layout.restart_interval = BIN_RESTART_PER_MCU_ROW;
+        } else if (strncmp(argv[i], "--restart=", 10) == 0) {
+            layout.restart_interval = atoi(argv[i] + 10);
+            if (layout.restart_interval < 0 || layout.restart_interval > BIN_MAX_RESTART_INTERVAL) {
+                printf("Restart interval must be between 0 and %d MCUs\n", BIN_MAX_RESTART_INTERVAL);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--segment-table=on") == 0) {
+            layout.segment_table = 1;
+        } else if (strcmp(argv[i], "--segment-table=off") == 0) {
+            layout.segment_table = 0;
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (layout.restart_interval != 0) {
+        // Restart intervals count MCUs, so they need the interleaved order
+        layout.interleaved = 1;
+    }
+    if (use_streaming || use_pipeline) {
+        // One MCU row at a time through the fused kernels, memory bounded by the width
+        int status = encode_streaming(argv[1], argv[2], dct_method, dc_encoder, ac_encoder, use_fixed_color,
+                                      &layout, use_pipeline ? thread_count : 0);
+        end = clock();
+        cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+        printf("Time taken: %f seconds\n", cpu_time_used);
+        return status;
     }
+
     BITMAPFILEHEADER file_header;
     BITMAPINFOHEADER info_header;
-    load_bmp_header(fp, &file_header, &info_header);
-    // Create RGB image structure
-    RGB_Image rgb_image = init_rgb_image();
-    // Read the RGB image data from the BMP file
-    read_rgb_image(&rgb_image, fp, file_header, info_header);
-
-    int image_size = ftell(fp);
-
-    fclose(fp);
-    // Create YCbCr image structure
+    int image_size;
+    // Full-resolution YCbCr image, only built when subsampling is staged
     YCbCr_Image ycbcr_image = init_ycbcr_image();
-    // Convert RGB to YCbCr
-    rgb_to_ycbcr(&ycbcr_image, rgb_image);
-    // We can free the original RGB image now
-    free_rgb_image(&rgb_image);
-    // Create YCbCr_420 structure
+    // Subsampled image: aligned planes from the fused subsampling, row matrices from the staged one
+    PlanarImage planar_image;
     YCbCr_Image_420 subsampled_image = init_ycbcr_image_420();
-    // Apply chroma subsampling (4:2:0)
-    ycbcr_subsampling_420(&subsampled_image, ycbcr_image);
-    // Free the original YCbCr image
-    free_ycbcr_image(&ycbcr_image);
-    // Divide the YCbCr image into 8x8 blocks
-    DCTBlocks blocks = divide_ycbcr_420_into_blocks(subsampled_image);
-    // Free the subsampled image
-    free_ycbcr_image_420(&subsampled_image);
-
-    // Process each block for DCT and quantization
-    DCTBlocks quantized_blocks = init_dct_blocks(blocks.luminance_height, blocks.luminance_width, blocks.chrominance_height, blocks.chrominance_width);
-
-    // Quantize the luminance blocks
-    for (int i = 0; i < blocks.luminance_height; i++) {
-        for (int j = 0; j < blocks.luminance_width; j++) {
-            // Perform DCT on the luminance block
-            // Level shift the block
-            double **block = level_shift(blocks.y_blocks[i][j]);
-            // Perform DCT on the shifted block
-            double **dct_block = dct_2d(block, cosine_matrix);
-            // Quantize the DCT coefficients
-            double **quantized_block = quantize_block(dct_block, 1.0, LUMINANCE);
-            // Store the quantized block
-            quantized_blocks.y_blocks[i][j] = quantized_block;
-            // Free the DCT block
-            free_double_matrix(dct_block, DCT_BLOCK_SIZE);
-            // Free the shifted block
-            free_double_matrix(block, DCT_BLOCK_SIZE);
-        }
-    }
-
-    // Quantize the chrominance blocks
-    for (int i = 0; i < blocks.chrominance_height; i++) {
-        for (int j = 0; j < blocks.chrominance_width; j++) {
-            // Perform DCT on the chrominance blocks
-            // Level shift the block
-            double **block_cb = level_shift(blocks.cb_blocks[i][j]);
-            double **block_cr = level_shift(blocks.cr_blocks[i][j]);
-            // Perform DCT on the shifted block
-            double **dct_block_cb = dct_2d(block_cb, cosine_matrix);
-            double **dct_block_cr = dct_2d(block_cr, cosine_matrix);
-            // Quantize the DCT coefficients
-            double **quantized_block_cb = quantize_block(dct_block_cb, 1.0, CHROMINANCE);
-            double **quantized_block_cr = quantize_block(dct_block_cr, 1.0, CHROMINANCE);
-            // Store the quantized block
-            quantized_blocks.cb_blocks[i][j] = quantized_block_cb;
-            quantized_blocks.cr_blocks[i][j] = quantized_block_cr;
-            // Free the DCT block
-            free_double_matrix(dct_block_cb, DCT_BLOCK_SIZE);
-            free_double_matrix(dct_block_cr, DCT_BLOCK_SIZE);
-            // Free the shifted block
-            free_double_matrix(block_cb, DCT_BLOCK_SIZE);
-            free_double_matrix(block_cr, DCT_BLOCK_SIZE);
+    if (use_mapped_input) {
+        // Convert straight from the mapped BGR rows, no intermediate RGB image
+        MappedBitmap bitmap;
+        if (map_bmp_file(argv[1], &bitmap) != 0) {
+            printf("Error mapping bitmap: %s\n", argv[1]);
+            return 1;
         }
-    }
-    
-    // Free blocks
-    free_dct_blocks(&blocks);
-    blocks = init_dct_blocks(quantized_blocks.luminance_height, quantized_blocks.luminance_width, quantized_blocks.chrominance_height, quantized_blocks.chrominance_width);
-    
-    // Convert quantized_blocks to zigzag arrays
-    ZigzagMatrix zigzag_matrix = blocks_to_arrays(quantized_blocks);
+        file_header = bitmap.file_header;
+        info_header = bitmap.info_header;
+        print_bmp_headers(&file_header, &info_header);
+        if (use_fused_subsampling) {
+            // Convert two rows at a time straight into the 4:2:0 planes
+            bgr_rows_to_ycbcr_420(&planar_image, bitmap.pixels, bitmap.row_stride,
+                                  info_header.Height, info_header.Width, use_fixed_color);
+        } else if (use_fixed_color) {
+            bgr_rows_to_ycbcr_fixed(&ycbcr_image, bitmap.pixels, bitmap.row_stride, info_header.Height, info_header.Width);
+        } else {
+            bgr_rows_to_ycbcr(&ycbcr_image, bitmap.pixels, bitmap.row_stride, info_header.Height, info_header.Width);
+        }
+        image_size = (int) (file_header.OffBits + (size_t) bitmap.row_stride * info_header.Height);
+        unmap_bmp_file(&bitmap);
+    } else {
+        FILE *fp = fopen(argv[1], "rb");
+        if (fp == NULL) {
+            printf("Error opening file: %s\n", argv[1]);
+            return 1;
+        }
+        load_bmp_header(fp, &file_header, &info_header);
+        // Create RGB image structure
+        RGB_Image rgb_image = init_rgb_image();
+        // Read the RGB image data from the BMP file
+        read_rgb_image(&rgb_image, fp, file_header, info_header);
 
-    // Free the quantized blocks
-    free_dct_blocks(&quantized_blocks);
+        image_size = ftell(fp);
 
-    rgb_image.height = 0;
-    rgb_image.width = 0;
+        fclose(fp);
+        // Convert RGB to YCbCr
+        if (use_fused_subsampling) {
+            rgb_to_ycbcr_420(&planar_image, rgb_image, use_fixed_color);
+        } else if (use_fixed_color) {
+            rgb_to_ycbcr_fixed(&ycbcr_image, rgb_image);
+        } else {
+            rgb_to_ycbcr(&ycbcr_image, rgb_image);
+        }
+        // We can free the original RGB image now
+        free_rgb_image(&rgb_image);
+    }
+    if (!use_fused_subsampling) {
+        // Apply chroma subsampling (4:2:0)
+        ycbcr_subsampling_420(&subsampled_image, ycbcr_image);
+        // Free the original YCbCr image
+        free_ycbcr_image(&ycbcr_image);
+        if (use_fused_kernel) {
+            planar_image = ycbcr_image_420_to_planar(subsampled_image);
+            free_ycbcr_image_420(&subsampled_image);
+        }
+    } else if (!use_fused_kernel) {
+        // The staged transform reads row matrices
+        subsampled_image = planar_to_ycbcr_image_420(&planar_image);
+        free_planar_image(&planar_image);
+    }
+    // Quantization tables for the AAN (scale factors folded in) and integer methods
+    QuantizationTables tables;
+    compute_aan_quantization_table(tables.aan_divisors[LUMINANCE], 1.0, LUMINANCE);
+    compute_aan_quantization_table(tables.aan_divisors[CHROMINANCE], 1.0, CHROMINANCE);
+    compute_int_quantization_table(tables.int_divisors[LUMINANCE], 1.0, LUMINANCE);
+    compute_int_quantization_table(tables.int_divisors[CHROMINANCE], 1.0, CHROMINANCE);
 
+    // DCT, quantization and zigzag scan of every 8x8 block into flat coefficient planes
+    // One Cb and one Cr block per MCU, partial MCUs included, in either order
+    int luminance_block_rows = info_header.Height / DCT_BLOCK_SIZE;
+    int luminance_block_cols = info_header.Width / DCT_BLOCK_SIZE;
+    CoefficientBuffer coefficients = init_coefficient_buffer(luminance_block_rows, luminance_block_cols,
+                                                             mcu_count(luminance_block_rows),
+                                                             mcu_count(luminance_block_cols));
 
-    save_rgb_image(argv[2], rgb_image, &file_header, &info_header);
+    // Workers shared by the transform and the restart intervals
+    ThreadPool pool;
+    if (thread_pool_init(&pool, thread_count) != 0) {
+        printf("Error creating worker threads\n");
+        return 1;
+    }
 
-    //entropy coding
-    BitWriter bit_writer;
-    
-    bitwriter_init(&bit_writer, argv[2]);
+    if (use_fused_kernel) {
+        // One pass per block straight from contiguous planes into the coefficient buffer, MCU rows across threads
+        BlockKernel kernels[2];
+        init_block_kernel(&kernels[LUMINANCE], dct_method, 1.0, LUMINANCE);
+        init_block_kernel(&kernels[CHROMINANCE], dct_method, 1.0, CHROMINANCE);
 
-    // Encode iluminance
-    int previous_dc = 0; // Initialize previous DC value
-    for (int i = 0; i < zigzag_matrix.luminance_height; i++) {
-        for (int j = 0; j < zigzag_matrix.luminance_width; j++) {
-            // Encode the DC coefficient for the luminance block
-            int current_dc = zigzag_matrix.y_zigzag[i][j][0]; // DC coefficient is at (0, 0)
+        parallel_forward_transform(&pool, &planar_image, &coefficients, kernels);
+        free_planar_image(&planar_image);
+    } else {
+        // Per-block scratch memory for the whole job, released in one shot
+        Arena arena;
+        arena_init(&arena, 0);
 
-            encode_dc(&bit_writer, current_dc, previous_dc);
-            encode_ac(&bit_writer, zigzag_matrix.y_zigzag[i][j]);
-            previous_dc = current_dc; // Update previous DC value
-        }
-    }
+        transform_plane(subsampled_image.y, &coefficients.y, dct_method, cosine_matrix, &tables, LUMINANCE, &arena);
+        transform_plane(subsampled_image.cb, &coefficients.cb, dct_method, cosine_matrix, &tables, CHROMINANCE, &arena);
+        transform_plane(subsampled_image.cr, &coefficients.cr, dct_method, cosine_matrix, &tables, CHROMINANCE, &arena);
 
-    // Encode chrominanc
-    int previous_dc_cb = 0; // Initialize previous DC value for chrominance
-    int previous_dc_cr = 0; // Initialize previous DC value for chrominance
-    for (int i = 0; i < zigzag_matrix.chrominance_height; i++) {
-        for (int j = 0; j < zigzag_matrix.chrominance_width; j++) {
-            // Encode the DC coefficient for the chrominance blocks
-            int current_dc_cb = zigzag_matrix.cb_zigzag[i][j][0]; // DC coefficient is at (0, 0)
-            int current_dc_cr = zigzag_matrix.cr_zigzag[i][j][0]; // DC coefficient is at (0, 0)
+        arena_destroy(&arena);
+        free_ycbcr_image_420(&subsampled_image);
+    }
 
-            encode_dc(&bit_writer, current_dc_cb, previous_dc_cb);
+    //entropy coding into a growable memory buffer; the file is written once at the end
+    BitWriter bit_writer;
 
-            encode_ac(&bit_writer, zigzag_matrix.cb_zigzag[i][j]);
+    bitwriter_init_growable(&bit_writer, BITWRITER_DEFAULT_BUFFER_SIZE);
 
-            encode_dc(&bit_writer, current_dc_cr, previous_dc_cr);
+    // The original bitmap headers go first, padded up to OffBits; Reserved1/Reserved2 hold the layout
+    bin_store_layout(&file_header, &layout, info_header.Width);
+    int restart_interval = bin_restart_interval(&file_header);
+    unsigned char headers[BMP_HEADERS_SIZE];
+    serialize_bmp_headers(headers, &file_header, &info_header);
+    bitwriter_write_bytes(&bit_writer, headers, BMP_HEADERS_SIZE);
+    for (int i = BMP_HEADERS_SIZE; i < (int) file_header.OffBits; i++) {
+        bitwriter_write_code(&bit_writer, 0, 8);
+    }
 
-            encode_ac(&bit_writer, zigzag_matrix.cr_zigzag[i][j]);
+    if (restart_interval > 0) {
+        // Independent intervals, coded in parallel and joined with restart markers
+        encode_restart_segments(&pool, &bit_writer, &coefficients, restart_interval,
+                                bin_has_segment_table(&file_header), dc_encoder, ac_encoder);
+    } else if (layout.interleaved) {
+        encode_mcu_range(&bit_writer, &coefficients, 0, mcu_total(&coefficients), dc_encoder, ac_encoder);
+    } else {
+        // Encode iluminance
+        int previous_dc = 0; // Initialize previous DC value
+        for (int b = 0; b < coefficient_block_count(&coefficients.y); b++) {
+            encode_block(&bit_writer, coefficient_block_at(&coefficients.y, b), &previous_dc, dc_encoder, ac_encoder);
+        }
 
-            previous_dc_cb = current_dc_cb; // Update previous DC value for chrominance
-            previous_dc_cr = current_dc_cr; // Update previous DC value for chrominance
+        // Encode chrominance, Cb and Cr blocks alternate with separate DC predictors
+        int previous_dc_cb = 0; // Initialize previous DC value for chrominance
+        int previous_dc_cr = 0; // Initialize previous DC value for chrominance
+        for (int b = 0; b < coefficient_block_count(&coefficients.cb); b++) {
+            encode_block(&bit_writer, coefficient_block_at(&coefficients.cb, b), &previous_dc_cb, dc_encoder, ac_encoder);
+            encode_block(&bit_writer, coefficient_block_at(&coefficients.cr, b), &previous_dc_cr, dc_encoder, ac_encoder);
         }
     }
 
+    thread_pool_destroy(&pool);
+
     // Flush the bit writer to write all bits to the file
     bitwriter_flush(&bit_writer);
     // Free the Huffman tree
     //free_huffman_tree(huffman_tree);
     //printf("Entropy coding completed.\n");
 
-    fp = fopen(argv[2], "ab");
+    FILE *fp = fopen(argv[2], "wb");
+    if (fp == NULL) {
+        printf("Error opening file for writing: %s\n", argv[2]);
+        free(bit_writer.out_buffer);
+        return 1;
+    }
+    fwrite(bit_writer.out_buffer, 1, bit_writer.out_position, fp);
+    fclose(fp);
 
-    int compressed_size = ftell(fp);
+    int compressed_size = (int) bit_writer.out_position;
+    free(bit_writer.out_buffer);
 
     printf("Compression information:\n");
 
     printf("Compressed size: %d bytes\n", compressed_size);
     printf("Original size: %d bytes\n", image_size);
     printf("Compression ratio: %.2f%%\n", ((double) compressed_size/ (double)image_size) * 100);
-    fclose(fp);
 
-    // Free the zigzag matrix
-    free_zigzag_matrix(&zigzag_matrix);
+    // Free the coefficient planes
+    free_coefficient_buffer(&coefficients);
 
     end = clock(); // Record end time
 
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bitmap.h"
+#include "bin_format.h"
+#include "block_kernel.h"
+#include "coefficients.h"
+#include "color_convert.h"
+#include "entropy_segments.h"
+#include "heap_manager.h"
+#include "huffman.h"
+#include "parallel_transform.h"
+#include "stream_encoder.h"
+#include "stream_decoder.h"
+#include "thread_pool.h"
+
+#define CHECK_MIN_PSNR 30.0
+#define CHECK_THREADS 2
+
+// Sizes with a partial MCU, a partial block, a single block and no padding at all
+static const int check_sizes[][2] = {
+    { 33, 17 }, { 48, 48 }, { 40, 40 }, { 13, 9 }, { 200, 128 }
+};
+
+static const BinLayout check_layouts[] = {
+    { 0, 0, 1 },                       // Sequential
+    { 1, 0, 1 },                       // Interleaved
+    { 1, BIN_RESTART_PER_MCU_ROW, 1 }, // Interleaved, one restart interval per MCU row, segment table
+};
+static const char *check_layout_names[] = { "sequential", "interleaved", "restart" };
+
+/**
+ * @brief Reads a whole file into a new heap buffer
+ *
+ * @return The buffer, or NULL if the file cannot be read
+ */
+static unsigned char *read_whole_file(FILE *fp, size_t *size) {
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (length < 0) {
+        return NULL;
+    }
+    unsigned char *data = (unsigned char *)malloc(length > 0 ? (size_t) length : 1);
+    if (data == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fread(data, 1, (size_t) length, fp) != (size_t) length) {
+        free(data);
+        return NULL;
+    }
+    *size = (size_t) length;
+    return data;
+}
+
+/**
+ * @brief Reads a whole named file into a new heap buffer
+ *
+ * @return The buffer, or NULL if the file cannot be opened or read
+ */
+static unsigned char *read_named_file(const char *filename, size_t *size) {
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    unsigned char *data = read_whole_file(fp, size);
+    fclose(fp);
+    return data;
+}
+
+/**
+ * @brief Checks that BMP headers describe width x height rows ending exactly at the end of the file
+ *
+ * @return 0 if they do, -1 otherwise
+ */
+static int check_bmp_headers(const char *what, const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header,
+                             size_t file_size, int width, int height) {
+    unsigned int size_image = (unsigned int) bmp_row_stride(width) * (unsigned int) height;
+    if (info_header->Width != width || info_header->Height != height || info_header->SizeImage != size_image ||
+        file_header->Size != file_header->OffBits + size_image || file_header->Size != file_size) {
+        printf("%s: header says %dx%d, Size %u, SizeImage %u; expected %dx%d, Size %u, SizeImage %u\n", what,
+               info_header->Width, info_header->Height, file_header->Size, info_header->SizeImage,
+               width, height, (unsigned int) file_size, size_image);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks that a saved BMP is readable and its headers match the decoded size
+ *
+ * @return The file contents, or NULL (after printing why) if the check fails
+ */
+static unsigned char *load_checked_bmp(const char *what, const char *filename, int width, int height, size_t *size) {
+    unsigned char *saved = read_named_file(filename, size);
+    remove(filename);
+    BITMAPFILEHEADER file_header;
+    BITMAPINFOHEADER info_header;
+    if (saved == NULL || parse_bmp_headers(saved, *size, &file_header, &info_header) != 0) {
+        printf("%s: unreadable BMP\n", what);
+        free(saved);
+        return NULL;
+    }
+    if (check_bmp_headers(what, &file_header, &info_header, *size, width, height) != 0) {
+        free(saved);
+        return NULL;
+    }
+    return saved;
+}
+
+/**
+ * @brief Builds a smooth synthetic image, so the round trip is close to lossless
+ *
+ * @return Stored rows of bmp_row_stride(width) bytes, headers in file_header and info_header
+ */
+static unsigned char *make_source(int width, int height, BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header) {
+    memset(file_header, 0, sizeof(*file_header));
+    memset(info_header, 0, sizeof(*info_header));
+    file_header->Type = 0x4D42;
+    file_header->OffBits = BMP_HEADERS_SIZE;
+    info_header->Size = 40;
+    info_header->Planes = 1;
+    info_header->BitCount = 24;
+    set_bmp_dimensions(file_header, info_header, width, height);
+
+    int source_stride = bmp_row_stride(width);
+    unsigned char *source = (unsigned char *)calloc((size_t) source_stride * height, 1);
+    if (source == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            unsigned char *pixel = source + (size_t) i * source_stride + 3 * j;
+            pixel[0] = (unsigned char) (64 + j / 2);
+            pixel[1] = (unsigned char) (96 + i);
+            pixel[2] = (unsigned char) (160 - i / 2 - j / 4);
+        }
+    }
+    return source;
+}
+
+/**
+ * @brief Encodes stored rows with the streaming encoder into a new heap buffer
+ *
+ * @return The compressed file, or NULL on failure
+ */
+static unsigned char *encode_source(const unsigned char *source, BITMAPFILEHEADER *file_header,
+                                    BITMAPINFOHEADER *info_header, const BinLayout *layout, size_t *size) {
+    FILE *compressed = tmpfile();
+    if (compressed == NULL) {
+        printf("Error creating temporary file\n");
+        return NULL;
+    }
+    StreamEncoder encoder;
+    if (stream_encoder_init(&encoder, compressed, file_header, info_header, DCT_METHOD_MATRIX,
+                            encode_dc_table, encode_ac_table, 0, layout) != 0) {
+        printf("Error creating temporary file\n");
+        fclose(compressed);
+        return NULL;
+    }
+    stream_encoder_write_rows(&encoder, source, bmp_row_stride(info_header->Width), info_header->Height);
+    if (stream_encoder_finish(&encoder) != 0) {
+        printf("Error writing compressed data\n");
+        fclose(compressed);
+        return NULL;
+    }
+    unsigned char *data = read_whole_file(compressed, size);
+    fclose(compressed);
+    if (data == NULL) {
+        printf("Error reading compressed data\n");
+    }
+    return data;
+}
+
+/**
+ * @brief Decodes a whole file the way the batch decoder does and saves it with save_ycbcr_image_420
+ *
+ * The chroma grid is sized independently of the streaming decoder, so a
+ * disagreement between the two shows up as different output.
+ *
+ * @return 0 on success, -1 if the file cannot be decoded
+ */
+static int batch_decode(ThreadPool *pool, const unsigned char *data, size_t size, const char *filename) {
+    BITMAPFILEHEADER file_header;
+    BITMAPINFOHEADER info_header;
+    if (parse_bmp_headers(data, size, &file_header, &info_header) != 0 || file_header.OffBits > size) {
+        return -1;
+    }
+    int interleaved = bin_is_interleaved(&file_header);
+    int restart_interval = bin_restart_interval(&file_header);
+    int has_segment_table = bin_has_segment_table(&file_header);
+    file_header.Reserved1 = 0;
+    file_header.Reserved2 = 0;
+
+    int luma_block_rows = info_header.Height / DCT_BLOCK_SIZE;
+    int luma_block_cols = info_header.Width / DCT_BLOCK_SIZE;
+    CoefficientBuffer coefficients = init_coefficient_buffer(luma_block_rows, luma_block_cols,
+                                                             mcu_count(luma_block_rows), mcu_count(luma_block_cols));
+    HuffmanDecoder *huffman = create_huffman_decoder();
+    const uint8_t *bitstream = data + file_header.OffBits;
+    size_t bitstream_size = size - file_header.OffBits;
+    int status = 0;
+
+    if (has_segment_table) {
+        // Every restart interval from its own offset, in parallel
+        int segment_count = bin_segment_count(mcu_total(&coefficients), restart_interval);
+        size_t table_size = bin_segment_table_size(segment_count);
+        uint32_t *offsets = (uint32_t *)malloc((size_t) segment_count * sizeof(uint32_t));
+        if (offsets == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (table_size > bitstream_size ||
+            parse_segment_table(bitstream, bitstream_size, segment_count, bitstream_size - table_size, offsets) != 0 ||
+            decode_restart_segments(pool, huffman, bitstream + table_size, bitstream_size - table_size, offsets,
+                                    &coefficients, restart_interval) != 0) {
+            status = -1;
+        }
+        free(offsets);
+    } else {
+        BitReader reader;
+        bitreader_init_memory(&reader, bitstream, bitstream_size);
+        if (interleaved) {
+            decode_mcu_range(huffman, &reader, &coefficients, 0, mcu_total(&coefficients));
+        } else {
+            // All Y blocks, then Cb and Cr alternating
+            int block[BLOCK_COEFFICIENTS];
+            int previous_dc[3] = { 0, 0, 0 };
+            CoefficientPlane *planes[3] = { &coefficients.y, &coefficients.cb, &coefficients.cr };
+            for (int b = 0; b < coefficient_block_count(&coefficients.y); b++) {
+                decode_block(huffman, &reader, &previous_dc[0], block);
+                for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+                    coefficient_block_at(planes[0], b)[k] = (int16_t) block[k];
+                }
+            }
+            for (int b = 0; b < coefficient_block_count(&coefficients.cb); b++) {
+                for (int p = 1; p < 3; p++) {
+                    decode_block(huffman, &reader, &previous_dc[p], block);
+                    for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+                        coefficient_block_at(planes[p], b)[k] = (int16_t) block[k];
+                    }
+                }
+            }
+        }
+        bitreader_close(&reader);
+    }
+    free_huffman_decoder(huffman);
+
+    if (status == 0) {
+        BlockKernel kernels[2];
+        init_block_kernel(&kernels[LUMINANCE], DCT_METHOD_MATRIX, 1.0, LUMINANCE);
+        init_block_kernel(&kernels[CHROMINANCE], DCT_METHOD_MATRIX, 1.0, CHROMINANCE);
+        PlanarImage image;
+        image.planes[0] = init_image_plane(coefficients.y.block_rows * DCT_BLOCK_SIZE,
+                                           coefficients.y.block_cols * DCT_BLOCK_SIZE);
+        image.planes[1] = init_image_plane(coefficients.cb.block_rows * DCT_BLOCK_SIZE,
+                                           coefficients.cb.block_cols * DCT_BLOCK_SIZE);
+        image.planes[2] = init_image_plane(coefficients.cr.block_rows * DCT_BLOCK_SIZE,
+                                           coefficients.cr.block_cols * DCT_BLOCK_SIZE);
+        parallel_inverse_transform(pool, &coefficients, &image, kernels);
+        status = save_ycbcr_image_420(filename, &image, 0, &file_header, &info_header);
+        free_planar_image(&image);
+    }
+    free_coefficient_buffer(&coefficients);
+    return status;
+}
+
+/**
+ * @brief Decodes a whole file with the streaming decoder and saves it with save_rgb_image
+ *
+ * @param psnr Set to the PSNR of the decoded rows against the source rows they cover
+ * @return 0 on success, -1 if the file cannot be decoded
+ */
+static int stream_decode(const unsigned char *data, size_t size, const unsigned char *source, int source_stride,
+                         const char *filename, int *width, int *height, double *psnr) {
+    StreamDecoder decoder;
+    if (stream_decoder_init(&decoder, data, size, DCT_METHOD_MATRIX, 0) != 0) {
+        printf("Invalid compressed data\n");
+        return -1;
+    }
+    int status = 0;
+    if (check_bmp_headers("stream_decoder_init", &decoder.file_header, &decoder.info_header,
+                          decoder.file_header.OffBits + (size_t) bmp_row_stride(decoder.width) * decoder.height,
+                          decoder.width, decoder.height) != 0) {
+        status = -1;
+    }
+
+    RGB_Image rgb_image = init_rgb_image();
+    rgb_image.height = decoder.height;
+    rgb_image.width = decoder.width;
+    rgb_image.r = init_uchar_matrix(decoder.height, decoder.width);
+    rgb_image.g = init_uchar_matrix(decoder.height, decoder.width);
+    rgb_image.b = init_uchar_matrix(decoder.height, decoder.width);
+    unsigned char *row = (unsigned char *)malloc((size_t) 3 * decoder.width);
+    if (row == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    double squared_error = 0;
+    for (int i = 0; i < decoder.height; i++) {
+        stream_decoder_read_scanlines(&decoder, &row, 1);
+        deinterleave_bgr_row(row, rgb_image.r[i], rgb_image.g[i], rgb_image.b[i], decoder.width);
+        for (int j = 0; j < 3 * decoder.width; j++) {
+            double error = (double) row[j] - (double) source[(size_t) i * source_stride + j];
+            squared_error += error * error;
+        }
+    }
+    free(row);
+
+    double mse = squared_error / (3.0 * decoder.height * decoder.width);
+    *psnr = mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99.0;
+    *width = decoder.width;
+    *height = decoder.height;
+
+    // The saved BMP must describe the rows actually written, not the original size
+    if (save_rgb_image(filename, rgb_image, &decoder.file_header, &decoder.info_header) != 0) {
+        status = -1;
+    }
+    free_rgb_image(&rgb_image);
+    stream_decoder_close(&decoder);
+    return status;
+}
+
+/**
+ * @brief Encodes one size in one layout, then decodes it with both decoders
+ *
+ * The streaming decode must reach CHECK_MIN_PSNR against the source and
+ * both decoders must save byte-identical bitmaps with exact headers.
+ *
+ * @return Number of failed checks
+ */
+static int check_case(ThreadPool *pool, int width, int height, int layout, const char *stream_path,
+                      const char *batch_path) {
+    BITMAPFILEHEADER file_header;
+    BITMAPINFOHEADER info_header;
+    unsigned char *source = make_source(width, height, &file_header, &info_header);
+    size_t compressed_size = 0;
+    unsigned char *data = encode_source(source, &file_header, &info_header, &check_layouts[layout], &compressed_size);
+    if (data == NULL) {
+        free(source);
+        return 1;
+    }
+
+    int failures = 0;
+    int decoded_width = 0, decoded_height = 0;
+    double psnr = 0;
+    if (stream_decode(data, compressed_size, source, bmp_row_stride(width), stream_path,
+                      &decoded_width, &decoded_height, &psnr) != 0) {
+        failures++;
+    }
+    if (batch_decode(pool, data, compressed_size, batch_path) != 0) {
+        printf("Batch decode failed\n");
+        failures++;
+    }
+    free(data);
+    free(source);
+
+    size_t stream_size = 0, batch_size = 0;
+    unsigned char *stream_bmp = load_checked_bmp("save_rgb_image", stream_path, decoded_width, decoded_height,
+                                                 &stream_size);
+    unsigned char *batch_bmp = load_checked_bmp("save_ycbcr_image_420", batch_path, decoded_width, decoded_height,
+                                                &batch_size);
+    int same = stream_bmp != NULL && batch_bmp != NULL && stream_size == batch_size &&
+               memcmp(stream_bmp, batch_bmp, stream_size) == 0;
+    if (!same) {
+        failures++;
+    }
+    free(stream_bmp);
+    free(batch_bmp);
+
+    printf("%dx%d %s: decoded %dx%d, PSNR %.2f dB, batch %s\n", width, height, check_layout_names[layout],
+           decoded_width, decoded_height, psnr, same ? "identical" : "DIFFERS");
+    if (psnr < CHECK_MIN_PSNR) {
+        printf("PSNR below %.0f dB\n", CHECK_MIN_PSNR);
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = argc > 1 ? argv[1] : "roundtrip_check.bmp";
+    char batch_output[4096];
+    snprintf(batch_output, sizeof(batch_output), "%s.batch.bmp", output);
+
+    ThreadPool pool;
+    if (thread_pool_init(&pool, CHECK_THREADS) != 0) {
+        printf("Error creating worker threads\n");
+        return 1;
+    }
+
+    int failures = 0;
+    for (size_t s = 0; s < sizeof(check_sizes) / sizeof(check_sizes[0]); s++) {
+        for (size_t l = 0; l < sizeof(check_layouts) / sizeof(check_layouts[0]); l++) {
+            failures += check_case(&pool, check_sizes[s][0], check_sizes[s][1], (int) l, output, batch_output);
+        }
+    }
+    thread_pool_destroy(&pool);
+
+    printf("%s\n", failures == 0 ? "Round trip OK" : "Round trip FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -1,3 +1,12 @@
+#ifndef _AC_ENCODE_H
+#define _AC_ENCODE_H
+
 #include "bitstream.h"
 
-void encode_ac(BitWriter* bw, int ac[64]);
\ No newline at end of file
+// Signature shared by the AC entropy encoder backends
+typedef void (*ACEncoder)(BitWriter* bw, int ac[64]);
+
+void encode_ac(BitWriter* bw, int ac[64]);
+void encode_ac_table(BitWriter* bw, int ac[64]);
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef _BIN_FORMAT_H
+#define _BIN_FORMAT_H
+
+#include <stddef.h>
+#include "bitmap.h"
+#include "dct.h"
+
+// Layout flags of a compressed file, stored in BITMAPFILEHEADER.Reserved1 (0 for the original layout)
+#define BIN_FLAG_INTERLEAVED 0x0001 // Blocks in MCU order: four Y, then Cb and Cr, per 16x16 MCU
+#define BIN_FLAG_SEGMENT_TABLE 0x0002 // Restart segment offsets stored at OffBits, ahead of the bitstream
+
+#define MCU_LUMA_BLOCKS 2 // Luminance blocks along each side of an MCU with 4:2:0 sampling
+
+// Restart intervals (interleaved files only): BITMAPFILEHEADER.Reserved2 holds the
+// interval in MCUs, 0 for none. Every interval starts on a byte boundary with fresh
+// DC predictors and all but the first are preceded by a two-byte marker
+#define BIN_RESTART_MARKER 0xFFD0   // Cycles through BIN_RESTART_MARKER_CYCLE values, as JPEG RST0-RST7
+#define BIN_RESTART_MARKER_CYCLE 8
+#define BIN_MAX_RESTART_INTERVAL 0xFFFF
+
+// Segment table: a little-endian uint32 segment count, then the byte offset of every
+// restart interval (past its marker) from the start of the bitstream, which follows the table
+#define BIN_SEGMENT_ENTRY_SIZE 4
+
+#define BIN_RESTART_PER_MCU_ROW -1 // BinLayout.restart_interval for one interval per row of MCUs
+
+// Block layout requested from an encoder
+typedef struct {
+    int interleaved;      // Blocks in MCU order
+    int restart_interval; // MCUs per interval, 0 for none or BIN_RESTART_PER_MCU_ROW; implies interleaved
+    int segment_table;    // Store the segment table when there are restart intervals
+} BinLayout;
+
+/**
+ * @brief Whether the blocks of a compressed file are stored in MCU order
+ */
+static inline int bin_is_interleaved(const BITMAPFILEHEADER *file_header) {
+    return (file_header->Reserved1 & BIN_FLAG_INTERLEAVED) != 0;
+}
+
+/**
+ * @brief Restart interval of a compressed file in MCUs, 0 if it has none
+ */
+static inline int bin_restart_interval(const BITMAPFILEHEADER *file_header) {
+    return bin_is_interleaved(file_header) ? file_header->Reserved2 : 0;
+}
+
+/**
+ * @brief MCUs (and chroma blocks) along one side for a count of luminance blocks
+ *
+ * A partial MCU at the right or bottom edge carries only the Y blocks that
+ * exist, but always one Cb and one Cr block. The chroma grid is the same in
+ * either block order, so encoders and decoders all size it with this.
+ */
+static inline int mcu_count(int luma_blocks) {
+    return (luma_blocks + MCU_LUMA_BLOCKS - 1) / MCU_LUMA_BLOCKS;
+}
+
+/**
+ * @brief Restart interval in MCUs a layout gives for an image width, 0 for none
+ */
+static inline int bin_layout_restart_interval(const BinLayout *layout, int width) {
+    int interval = layout->restart_interval;
+    if (interval == BIN_RESTART_PER_MCU_ROW) {
+        interval = mcu_count(width / DCT_BLOCK_SIZE);
+    }
+    if (interval > BIN_MAX_RESTART_INTERVAL) {
+        interval = BIN_MAX_RESTART_INTERVAL;
+    }
+    return interval > 0 ? interval : 0;
+}
+
+/**
+ * @brief Records a layout in the file header: flags in Reserved1, restart interval in Reserved2
+ */
+static inline void bin_store_layout(BITMAPFILEHEADER *file_header, const BinLayout *layout, int width) {
+    int interval = bin_layout_restart_interval(layout, width);
+    file_header->Reserved1 = 0;
+    if (layout->interleaved || interval > 0) {
+        file_header->Reserved1 |= BIN_FLAG_INTERLEAVED;
+    }
+    if (interval > 0 && layout->segment_table) {
+        file_header->Reserved1 |= BIN_FLAG_SEGMENT_TABLE;
+    }
+    file_header->Reserved2 = (unsigned short) interval;
+}
+
+/**
+ * @brief Whether a compressed file carries a segment table
+ */
+static inline int bin_has_segment_table(const BITMAPFILEHEADER *file_header) {
+    return bin_restart_interval(file_header) > 0 && (file_header->Reserved1 & BIN_FLAG_SEGMENT_TABLE) != 0;
+}
+
+/**
+ * @brief Number of restart intervals (segments) a run of MCUs divides into
+ *
+ * @param total_mcus MCUs in the image
+ * @param restart_interval MCUs per interval, 0 or less for a single segment
+ */
+static inline int bin_segment_count(int total_mcus, int restart_interval) {
+    if (restart_interval <= 0 || total_mcus <= 0) {
+        return 1;
+    }
+    return (total_mcus + restart_interval - 1) / restart_interval;
+}
+
+/**
+ * @brief Bytes taken by the segment table of segment_count segments
+ */
+static inline size_t bin_segment_table_size(int segment_count) {
+    return (size_t) (segment_count + 1) * BIN_SEGMENT_ENTRY_SIZE;
+}
+
+/**
+ * @brief Marker written in front of restart interval k (k >= 1)
+ */
+static inline unsigned int bin_restart_marker(int interval) {
+    return BIN_RESTART_MARKER + (unsigned int) ((interval - 1) % BIN_RESTART_MARKER_CYCLE);
+}
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef _BITMAP_H
 #define _BITMAP_H
 
+#include <stddef.h>
+#include <stdio.h>
+
 typedef struct {
     unsigned short Type;       // Magic number
     unsigned int Size;        // Size of the file
@@ -10,6 +13,7 @@ typedef struct {
 } BITMAPFILEHEADER;
 
 # define BF_TYPE 0x4D42 // Bitmap file magic number
+# define BMP_HEADERS_SIZE 54 // Size of the file header + info header on disk
 
 typedef struct {
     unsigned int Size;        // Size of this header
@@ -25,9 +29,29 @@ typedef struct {
     unsigned int ImportantColors; // Important colors
 } BITMAPINFOHEADER;
 
+// A 24-bit bitmap file mapped read-only into memory, pixels read in place
+typedef struct {
+    BITMAPFILEHEADER file_header;
+    BITMAPINFOHEADER info_header;
+    const unsigned char *pixels; // First stored row
+    int row_stride;              // Bytes between stored rows, padding included
+    const unsigned char *data;   // Whole file
+    size_t size;                 // File size in bytes
+    int mapped;                  // 1 if data is an mmap, 0 if it was read into a heap buffer
+    unsigned char *filled;       // Zero-filled copy of truncated pixel data, NULL if the file is complete
+} MappedBitmap;
+
 void load_bmp_header(FILE *fp, BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header);
 void read_bmp_header(FILE *fp, BITMAPFILEHEADER *file_header);
 void read_bmp_info(FILE *fp, BITMAPINFOHEADER *info_header);
+int validate_bmp_headers(const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header);
+void serialize_bmp_headers(unsigned char *out, const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header);
+int parse_bmp_headers(const unsigned char *data, size_t size, BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header);
+int bmp_row_stride(int width);
+int read_bmp_rows(FILE *fp, unsigned char *rows, int row_stride, int count);
+void set_bmp_dimensions(BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header, int width, int height);
+int map_bmp_file(const char *filename, MappedBitmap *bitmap);
+void unmap_bmp_file(MappedBitmap *bitmap);
 void print_bmp_headers(BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header);
 
 #endif // _BITMAP_H
\ No newline at end of file
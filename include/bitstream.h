@@ -1,32 +1,96 @@
 #ifndef BITSTREAM_H
 #define BITSTREAM_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+// Tamanho padrão do buffer de saída do modo bufferizado
+#define BITWRITER_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+// Destino dos bytes produzidos pelo BitWriter
+typedef enum {
+    BITWRITER_SINK_FILE,     // Arquivo (FILE*)
+    BITWRITER_SINK_MEMORY,   // Memória do chamador com capacidade fixa
+    BITWRITER_SINK_GROWABLE  // Memória alocada e redimensionada pelo próprio BitWriter
+} BitWriterSink;
+
 // Estrutura para escrita de bits
 typedef struct {
     FILE* file;
     uint8_t buffer;
     int bits_filled;
+
+    // Modo bufferizado: acumulador de 64 bits + buffer de saída em bloco
+    uint64_t accumulator;
+    int accumulator_bits;
+    uint8_t* out_buffer;
+    size_t out_capacity;
+    size_t out_position;
+
+    BitWriterSink sink;
+    int owns_file;        // Fecha o arquivo no flush
+    int overflow;         // Destino de capacidade fixa cheio: bytes descartados
+    size_t bytes_flushed; // Bytes já enviados ao arquivo
 } BitWriter;
 
 void bitwriter_init(BitWriter* bw, const char* filename);
+void bitwriter_init_buffered(BitWriter* bw, const char* filename, size_t buffer_size);
+void bitwriter_init_file(BitWriter* bw, FILE* file, size_t buffer_size);
+void bitwriter_init_memory(BitWriter* bw, uint8_t* data, size_t capacity);
+void bitwriter_init_growable(BitWriter* bw, size_t initial_capacity);
 void bitwriter_write_bit(BitWriter* bw, int bit);
 void bitwriter_write_bits(BitWriter* bw, const char* bits);
 void bitwriter_write_int(BitWriter* bw, int value, int size);
+void bitwriter_write_code(BitWriter* bw, uint32_t code, int length);
+void bitwriter_write_bytes(BitWriter* bw, const void* data, size_t size);
+void bitwriter_align(BitWriter* bw);
+size_t bitwriter_bytes_written(const BitWriter* bw);
 void bitwriter_flush(BitWriter* bw);
+void bitwriter_detach(BitWriter* bw, uint32_t* tail_code, int* tail_bits);
+
+// Tamanho do buffer de bytes usado pelo BitReader
+#define BITREADER_INPUT_SIZE (64 * 1024)
 
 // Estrutura para leitura de bits
 typedef struct {
     FILE* file;
-    uint8_t buffer;
-    int bits_available;
+    int owns_file; // Fecha o arquivo e libera o buffer em bitreader_close
+
+    // Buffer de bytes: lido do arquivo ou memória do chamador
+    const uint8_t* input;
+    uint8_t* input_storage;
+    size_t input_size;
+    size_t input_position;
+
+    // Buffer de bits alinhado ao MSB, permite espiar até 57 bits de uma vez
+    uint64_t bit_buffer;
+    int bit_count;
 } BitReader;
 
 void bitreader_init(BitReader* br, const char* filename);
+void bitreader_init_file(BitReader* br, FILE* file);
+void bitreader_init_memory(BitReader* br, const uint8_t* data, size_t size);
+void bitreader_refill(BitReader* br);
 int bitreader_read_bit(BitReader* br);
 int bitreader_read_bits(BitReader* br, int size);
+void bitreader_read_bytes(BitReader* br, void* data, size_t size);
 void bitreader_close(BitReader* br);
+size_t bitreader_bits_consumed(const BitReader* br);
+void bitreader_align(BitReader* br);
+
+// Espia os próximos size bits (1 a 57) sem consumi-los; completa com zeros no fim do arquivo
+static inline uint32_t bitreader_peek_bits(BitReader* br, int size) {
+    if (br->bit_count < size) {
+        bitreader_refill(br);
+    }
+    return (uint32_t)(br->bit_buffer >> (64 - size));
+}
+
+// Descarta size bits previamente espiados
+static inline void bitreader_skip_bits(BitReader* br, int size) {
+    br->bit_buffer <<= size;
+    br->bit_count -= size;
+}
 
-#endif // BITSTREAM_H
\ No newline at end of file
+#endif // BITSTREAM_H
@@ -0,0 +1,24 @@
+#ifndef _BLOCK_KERNEL_H
+#define _BLOCK_KERNEL_H
+
+#include <stdint.h>
+#include "dct.h"
+#include "quantization.h"
+
+// Everything the fused per-block kernels need for one component type
+typedef struct {
+    DCTMethod method;
+    double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];   // DCT_METHOD_MATRIX
+    double divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];       // Row-major; AAN scale factors folded in for AAN
+    double multipliers[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];    // Row-major; AAN prescaling folded in for AAN/SIMD
+    uint16_t int_divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]; // DCT_METHOD_INTEGER dequantization
+    Quantizer quantizer;                                    // DCT_METHOD_INTEGER and DCT_METHOD_SIMD quantization
+} BlockKernel;
+
+void init_block_kernel(BlockKernel *kernel, DCTMethod method, double factor, QuantizationType type);
+void forward_block_kernel(const BlockKernel *kernel, const unsigned char *pixels, int stride,
+                          int16_t coefficients[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void inverse_block_kernel(const BlockKernel *kernel, const int16_t coefficients[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE],
+                          unsigned char *pixels, int stride);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _BOUNDED_QUEUE_H
+#define _BOUNDED_QUEUE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// One slot of the ring; sequence tells producers and consumers whose turn it is
+typedef struct {
+    size_t sequence;
+    void *value;
+} QueueCell;
+
+#define QUEUE_CACHE_LINE 64
+#define QUEUE_SPIN_LIMIT 64 // Failed attempts (each followed by a yield) before a push or pop blocks
+
+// Fixed-capacity queue of pointers, any number of producers and consumers, lock-free unless it has to wait
+typedef struct {
+    QueueCell *cells;
+    size_t mask;                                                   // Capacity - 1, capacity a power of two
+    char pad0[QUEUE_CACHE_LINE];
+    size_t enqueue_position;
+    char pad1[QUEUE_CACHE_LINE];
+    size_t dequeue_position;
+    char pad2[QUEUE_CACHE_LINE];
+    pthread_mutex_t lock;                                          // Only taken to sleep and to wake sleepers
+    pthread_cond_t not_empty;                                      // Broadcast after a push while consumers sleep
+    pthread_cond_t not_full;                                       // Broadcast after a pop while producers sleep
+    int sleeping_consumers, sleeping_producers;
+} BoundedQueue;
+
+void bounded_queue_init(BoundedQueue *queue, size_t capacity);
+void bounded_queue_destroy(BoundedQueue *queue);
+int bounded_queue_try_push(BoundedQueue *queue, void *value);
+int bounded_queue_try_pop(BoundedQueue *queue, void **value);
+void bounded_queue_push(BoundedQueue *queue, void *value);
+void *bounded_queue_pop(BoundedQueue *queue);
+
+#endif
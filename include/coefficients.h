@@ -0,0 +1,52 @@
+#ifndef _COEFFICIENTS_H
+#define _COEFFICIENTS_H
+
+#include <stdint.h>
+#include "dct.h"
+#include "planar_image.h"
+
+#define BLOCK_COEFFICIENTS (DCT_BLOCK_SIZE * DCT_BLOCK_SIZE)
+
+// One component stored as a single allocation of contiguous 64-coefficient blocks
+typedef struct {
+    int block_rows, block_cols; // Dimensions of matrix of blocks
+    int16_t *data;              // block_rows * block_cols blocks in raster order, 64 coefficients each
+} CoefficientPlane;
+
+typedef struct {
+    CoefficientPlane y;  // Luminance blocks
+    CoefficientPlane cb; // Chrominance-blue blocks
+    CoefficientPlane cr; // Chrominance-red blocks
+} CoefficientBuffer;
+
+CoefficientPlane init_coefficient_plane(int block_rows, int block_cols);
+void free_coefficient_plane(CoefficientPlane *plane);
+CoefficientBuffer init_coefficient_buffer(int y_block_rows, int y_block_cols, int c_block_rows, int c_block_cols);
+void free_coefficient_buffer(CoefficientBuffer *buffer);
+void load_block_samples(unsigned char **image, int yoffset, int xoffset, int16_t samples[BLOCK_COEFFICIENTS]);
+void store_block_samples(const int16_t samples[BLOCK_COEFFICIENTS], unsigned char **image, int yoffset, int xoffset);
+void load_plane_block_samples(const ImagePlane *plane, int yoffset, int xoffset, int16_t samples[BLOCK_COEFFICIENTS]);
+void store_plane_block_samples(const int16_t samples[BLOCK_COEFFICIENTS], ImagePlane *plane, int yoffset, int xoffset);
+
+/**
+ * @brief Number of blocks stored in a plane
+ */
+static inline int coefficient_block_count(const CoefficientPlane *plane) {
+    return plane->block_rows * plane->block_cols;
+}
+
+/**
+ * @brief Coefficients of the block at the given raster index
+ */
+static inline int16_t *coefficient_block_at(const CoefficientPlane *plane, int index) {
+    return plane->data + (size_t) index * BLOCK_COEFFICIENTS;
+}
+
+/**
+ * @brief Coefficients of the block at the given block row and column
+ */
+static inline int16_t *coefficient_block(const CoefficientPlane *plane, int row, int col) {
+    return coefficient_block_at(plane, row * plane->block_cols + col);
+}
+
+#endif
@@ -33,9 +33,24 @@ void free_rgb_image(RGB_Image *rgb_image);
 void free_ycbcr_image(YCbCr_Image *ycbcr_image);
 void free_ycbcr_image_420(YCbCr_Image_420 *ycbcr_image_420);
 void rgb_to_ycbcr(YCbCr_Image *ycbcr_image, RGB_Image rgb_image);
+void bgr_row_to_ycbcr(const unsigned char *bgr, unsigned char *y, unsigned char *cb, unsigned char *cr, int width);
+void bgr_rows_to_ycbcr(YCbCr_Image *ycbcr_image, const unsigned char *pixels, int row_stride, int height, int width);
+void rgb_to_ycbcr_fixed(YCbCr_Image *ycbcr_image, RGB_Image rgb_image);
+void bgr_rows_to_ycbcr_fixed(YCbCr_Image *ycbcr_image, const unsigned char *pixels, int row_stride, int height, int width);
 void ycbcr_to_rgb(RGB_Image *rgb_image, YCbCr_Image ycbcr_image);
 int save_rgb_image(const char *filename, RGB_Image rgb_image, BITMAPFILEHEADER *original_file_header, BITMAPINFOHEADER *original_info_header);
 void ycbcr_subsampling_420(YCbCr_Image_420 *ycbcr_image_420, YCbCr_Image ycbcr_image);
 void ycbcr_upsampling_420(YCbCr_Image *ycbcr_image, YCbCr_Image_420 ycbcr_image_420);
+void subsample_chroma_row(const unsigned char *row0, const unsigned char *row1, int c, int height, int width,
+                          const unsigned char *edges, unsigned char *out, int chroma_width);
+void upsample_chroma_row(const unsigned char *near, const unsigned char *far, int chroma_width,
+                         unsigned char *out, int width, int fancy_upsampling);
+void color_simd_init();
+void deinterleave_bgr_row(const unsigned char *bgr, unsigned char *r, unsigned char *g, unsigned char *b, int width);
+void interleave_bgr_row(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *bgr, int width);
+void bgr_row_to_ycbcr_fixed(const unsigned char *bgr, unsigned char *y, unsigned char *cb, unsigned char *cr, int width);
+void ycbcr_row_to_rgb(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                      unsigned char *r, unsigned char *g, unsigned char *b, int width);
+const char *color_simd_kernel_name();
 
 #endif
\ No newline at end of file
@@ -1,3 +1,12 @@
+#ifndef _DC_ENCODE_H
+#define _DC_ENCODE_H
+
 #include "bitstream.h"
 
-void encode_dc(BitWriter* bw, int current_dc, int previous_dc);
\ No newline at end of file
+// Signature shared by the DC entropy encoder backends
+typedef void (*DCEncoder)(BitWriter* bw, int current_dc, int previous_dc);
+
+void encode_dc(BitWriter* bw, int current_dc, int previous_dc);
+void encode_dc_table(BitWriter* bw, int current_dc, int previous_dc);
+
+#endif
@@ -1,13 +1,26 @@
 #ifndef _DCT_H
 #define _DCT_H
 
+#include <stdint.h>
 #include "color_convert.h"
+#include "heap_manager.h"
 
 #define DCT_BLOCK_SIZE 8
+#define DCT_ISLOW_OUTPUT_BITS 3 // fdct_islow coefficients are scaled up by 2^3, as libjpeg's jpeg_fdct_islow
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// Available forward/inverse DCT implementations
+typedef enum {
+    DCT_METHOD_MATRIX, // Two 8x8 matrix products with the cosine matrix
+    DCT_METHOD_AAN,    // Arai-Agui-Nakajima factored DCT (5 multiplies per 1D pass + scaling)
+    DCT_METHOD_INTEGER, // Loeffler-Ligtenberg-Moschytz DCT in 32-bit fixed point on int16 blocks
+    DCT_METHOD_SIMD    // Float AAN DCT vectorized with AVX2/SSE2, picked at runtime
+} DCTMethod;
+
+extern const double aan_scale_factors[DCT_BLOCK_SIZE];
+
 typedef struct {
     int luminance_height, luminance_width; // Dimensions of matrix of luminance blocks
     int chrominance_height, chrominance_width; // Dimensions of matrix of chrominance blocks
@@ -19,8 +32,26 @@ typedef struct {
 void compute_cosine_matrix(double matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
 double **dct_2d(double **block, double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
 double **idct_2d(double **block, double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+double **dct_2d_arena(Arena *arena, double **block, double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+double **idct_2d_arena(Arena *arena, double **block, double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+void fdct_aan(double data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void idct_aan(double data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+double **dct_2d_aan(double **block, int descale);
+double **idct_2d_aan(double **block, int prescaled);
+double **dct_2d_aan_arena(Arena *arena, double **block, int descale);
+double **idct_2d_aan_arena(Arena *arena, double **block, int prescaled);
+void fdct_islow(int16_t data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void idct_islow(int16_t data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void fdct_aan_float(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void idct_aan_float(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void fdct_aan_simd(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void idct_aan_simd(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void dct_simd_init();
+const char *dct_simd_kernel_name();
 double **level_shift(double **block);
 double **unlevel_shift(double **block);
+double **level_shift_arena(Arena *arena, double **block);
+double **unlevel_shift_arena(Arena *arena, double **block);
 
 DCTBlocks init_dct_blocks(int y_block_rows, int y_block_cols, int c_block_rows, int c_block_cols);
 void free_dct_blocks(DCTBlocks *blocks);
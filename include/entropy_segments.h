@@ -0,0 +1,49 @@
+#ifndef _ENTROPY_SEGMENTS_H
+#define _ENTROPY_SEGMENTS_H
+
+#include <stdio.h>
+#include "bitstream.h"
+#include "coefficients.h"
+#include "dc_encode.h"
+#include "ac_encode.h"
+#include "thread_pool.h"
+#include "huffman.h"
+
+#define SEGMENT_BYTES_PER_MCU 64 // Initial capacity of a segment's writer per MCU, grows as needed
+
+// Entropy coding state of an interleaved bitstream, shared by every encoder that writes MCU order
+typedef struct {
+    BitWriter *writer;
+    int restart_interval;       // MCUs per restart interval, 0 for none
+    int mcus_done;              // MCUs coded so far
+    int previous_dc_y, previous_dc_cb, previous_dc_cr;
+    uint32_t *segment_offsets;  // Start of every restart interval, NULL without a segment table
+    size_t bitstream_start;     // Bytes written before the first block, origin of segment_offsets
+    DCEncoder dc_encoder;
+    ACEncoder ac_encoder;
+} McuCoder;
+
+void encode_coefficient_block(BitWriter *bw, const int16_t block[BLOCK_COEFFICIENTS], int *previous_dc,
+                              DCEncoder dc_encoder, ACEncoder ac_encoder);
+int mcu_total(const CoefficientBuffer *coefficients);
+void mcu_coder_init(McuCoder *coder, BitWriter *writer, int restart_interval, uint32_t *segment_offsets,
+                    DCEncoder dc_encoder, ACEncoder ac_encoder);
+void mcu_coder_encode_row(McuCoder *coder, const int16_t *y, int luma_rows, int luma_cols,
+                          const int16_t *cb, const int16_t *cr, int first_mcu, int count);
+void encode_mcu_range(BitWriter *bw, const CoefficientBuffer *coefficients, int first_mcu, int count,
+                      DCEncoder dc_encoder, ACEncoder ac_encoder);
+void encode_restart_segments(ThreadPool *pool, BitWriter *bw, const CoefficientBuffer *coefficients,
+                             int restart_interval, int write_table, DCEncoder dc_encoder, ACEncoder ac_encoder);
+void decode_mcu_range(const HuffmanDecoder *decoder, BitReader *br, CoefficientBuffer *coefficients,
+                      int first_mcu, int count);
+int decode_restart_segments(ThreadPool *pool, const HuffmanDecoder *decoder, const uint8_t *bitstream,
+                            size_t size, const uint32_t *offsets, CoefficientBuffer *coefficients,
+                            int restart_interval);
+void serialize_segment_table(unsigned char *out, const uint32_t *offsets, int segment_count);
+int write_segment_table_at(FILE *file, long position, const uint32_t *offsets, int segment_count);
+int parse_segment_table(const uint8_t *table, size_t available, int segment_count, size_t bitstream_size,
+                        uint32_t *offsets);
+void write_restart_marker(BitWriter *bw, int interval);
+int read_restart_marker(BitReader *br, int interval);
+
+#endif
@@ -1,13 +1,47 @@
 #ifndef _HEAP_MANAGER_H
 #define _HEAP_MANAGER_H
 
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 16 // Alignment of every arena allocation, in bytes
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator: allocations are released all at once by arena_reset or arena_release
+typedef struct {
+    ArenaBlock *first;   // Chain of blocks, kept across resets for reuse
+    ArenaBlock *current; // Block allocations are served from
+    size_t block_size;   // Capacity of newly allocated blocks
+} Arena;
+
+// Position in an arena, to release everything allocated after it
+typedef struct {
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+void arena_init(Arena *arena, size_t block_size);
+void *arena_alloc(Arena *arena, size_t size);
+ArenaMark arena_mark(const Arena *arena);
+void arena_release(Arena *arena, ArenaMark mark);
+void arena_reset(Arena *arena);
+void arena_destroy(Arena *arena);
+
 int **init_int_matrix(int rows, int cols);
+int **init_int_matrix_arena(Arena *arena, int rows, int cols);
 void free_int_matrix(int **matrix, int rows);
+void free_int_matrix_arena(Arena *arena, int **matrix, int rows);
 double **init_double_matrix(int rows, int cols);
+double **init_double_matrix_arena(Arena *arena, int rows, int cols);
 void free_double_matrix(double **matrix, int rows);
+void free_double_matrix_arena(Arena *arena, double **matrix, int rows);
 unsigned char **init_uchar_matrix(int rows, int cols);
+unsigned char **init_uchar_matrix_arena(Arena *arena, int rows, int cols);
 void free_uchar_matrix(unsigned char **matrix, int rows);
+void free_uchar_matrix_arena(Arena *arena, unsigned char **matrix, int rows);
 int *init_int_array(int size);
+int *init_int_array_arena(Arena *arena, int size);
 double ****init_matrix_of_double_matrices(int rows, int cols);
 void free_matrix_of_double_matrices(double ****matrix, int rows);
 int ***init_matrix_of_int_arrays(int rows, int cols);
@@ -2,6 +2,7 @@
 #define HUFFMAN_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "bitstream.h"
 
 #define MAX_RUN 16
@@ -11,6 +12,16 @@ extern const char *huffman_ac_prefix[MAX_RUN][MAX_CATEGORY];
 
 extern const char *huffman_dc_prefix[MAX_CATEGORY];
 
+// Huffman code stored as right-aligned bits plus its length
+typedef struct {
+    uint16_t code;
+    uint8_t length;
+} HuffmanCode;
+
+extern const HuffmanCode huffman_ac_codes[MAX_RUN][MAX_CATEGORY];
+
+extern const HuffmanCode huffman_dc_codes[MAX_CATEGORY];
+
 typedef struct Huffman_node{
     int run;
     int category;
@@ -20,8 +31,45 @@ typedef struct Huffman_node{
 
 } Huffman_node;
 
+// Number of bits resolved by a single lookup in the fast decoder tables
+#define HUFFMAN_LOOKUP_BITS 10
+
+// One entry of a fast decoder lookup table, indexed by the next HUFFMAN_LOOKUP_BITS bits
+typedef struct {
+    int16_t value;        // Decoded coefficient, valid when total_length > 0
+    uint8_t run;          // Zero run (AC only)
+    uint8_t category;     // Category (number of mantissa bits)
+    uint8_t code_length;  // Length of the Huffman code, 0 if longer than HUFFMAN_LOOKUP_BITS
+    uint8_t total_length; // Code + mantissa length, 0 if the mantissa does not fit in the lookup
+} HuffmanLookupEntry;
+
+typedef struct {
+    HuffmanLookupEntry ac_lookup[1 << HUFFMAN_LOOKUP_BITS];
+    HuffmanLookupEntry dc_lookup[1 << HUFFMAN_LOOKUP_BITS];
+    Huffman_node *ac_tree; // Slow path for AC codes longer than HUFFMAN_LOOKUP_BITS
+} HuffmanDecoder;
+
 int get_category(int value);
 
+/**
+ * @brief Branch-free category (bit length of the magnitude) of a coefficient
+ *
+ * Equivalent to get_category for |value| <= 2047.
+ */
+static inline int get_category_fast(int value) {
+    unsigned int magnitude = (unsigned int)(value < 0 ? -value : value);
+#if defined(__GNUC__) || defined(__clang__)
+    return magnitude == 0 ? 0 : 32 - __builtin_clz(magnitude);
+#else
+    int category = 0;
+    while (magnitude) {
+        category++;
+        magnitude >>= 1;
+    }
+    return category;
+#endif
+}
+
 Huffman_node *read_ac_category(Huffman_node *huffman_tree, BitReader *br);
 
 int read_dc_category(BitReader *br);
@@ -32,6 +80,18 @@ Huffman_node *create_huffman_tree();
 
 void create_node(Huffman_node *node, const char *prefix, int run, int category);
 
+void free_huffman_tree(Huffman_node *node);
+
+HuffmanDecoder *create_huffman_decoder();
+
+void free_huffman_decoder(HuffmanDecoder *decoder);
+
+int decode_dc_difference(const HuffmanDecoder *decoder, BitReader *br, int *diff);
+
+int decode_ac_symbol(const HuffmanDecoder *decoder, BitReader *br, int *run, int *value);
+
+int decode_block(const HuffmanDecoder *decoder, BitReader *br, int *previous_dc, int block[64]);
+
 
 
 
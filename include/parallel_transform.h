@@ -0,0 +1,14 @@
+#ifndef _PARALLEL_TRANSFORM_H
+#define _PARALLEL_TRANSFORM_H
+
+#include "block_kernel.h"
+#include "coefficients.h"
+#include "planar_image.h"
+#include "thread_pool.h"
+
+void parallel_forward_transform(ThreadPool *pool, const PlanarImage *image, CoefficientBuffer *coefficients,
+                                const BlockKernel kernels[2]);
+void parallel_inverse_transform(ThreadPool *pool, const CoefficientBuffer *coefficients, PlanarImage *image,
+                                const BlockKernel kernels[2]);
+
+#endif
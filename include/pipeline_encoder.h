@@ -0,0 +1,24 @@
+#ifndef _PIPELINE_ENCODER_H
+#define _PIPELINE_ENCODER_H
+
+#include <stdio.h>
+#include "bitmap.h"
+#include "dct.h"
+#include "dc_encode.h"
+#include "ac_encode.h"
+#include "bin_format.h"
+
+#define PIPELINE_SLOTS_PER_WORKER 2 // Strips in flight per transform worker, plus PIPELINE_EXTRA_SLOTS
+#define PIPELINE_EXTRA_SLOTS 2      // One being read and one being coded
+
+// Outcome of pipeline_encode_file
+typedef struct {
+    size_t compressed_size; // Bytes written to the output
+    int truncated;          // Nonzero if the pixel data ended early and was padded with black
+} PipelineResult;
+
+int pipeline_encode_file(FILE *input, const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header,
+                         FILE *output, DCTMethod method, DCEncoder dc_encoder, ACEncoder ac_encoder,
+                         int fixed_point, const BinLayout *layout, int worker_count, PipelineResult *result);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _PLANAR_IMAGE_H
+#define _PLANAR_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "color_convert.h"
+
+#define PLANE_ALIGNMENT 64 // Alignment of the first byte of every row, in bytes
+
+// One image channel in a single allocation, rows PLANE_ALIGNMENT-aligned and stride bytes apart
+typedef struct {
+    int height, width;
+    int stride;                // Bytes between the start of consecutive rows, multiple of PLANE_ALIGNMENT
+    unsigned char *data;       // First sample of row 0, PLANE_ALIGNMENT-aligned
+    unsigned char *allocation; // Pointer returned by malloc, owned by the plane
+} ImagePlane;
+
+// Three channels (R, G, B or Y, Cb, Cr); with 4:2:0 the last two are half size
+typedef struct {
+    ImagePlane planes[3];
+} PlanarImage;
+
+ImagePlane init_image_plane(int height, int width);
+void free_image_plane(ImagePlane *plane);
+void free_planar_image(PlanarImage *image);
+ImagePlane uchar_matrix_to_plane(unsigned char **matrix, int height, int width);
+unsigned char **plane_to_uchar_matrix(const ImagePlane *plane);
+PlanarImage rgb_image_to_planar(RGB_Image rgb_image);
+RGB_Image planar_to_rgb_image(const PlanarImage *image);
+PlanarImage ycbcr_image_to_planar(YCbCr_Image ycbcr_image);
+YCbCr_Image planar_to_ycbcr_image(const PlanarImage *image);
+PlanarImage ycbcr_image_420_to_planar(YCbCr_Image_420 ycbcr_image_420);
+YCbCr_Image_420 planar_to_ycbcr_image_420(const PlanarImage *image);
+
+// Fused color stages working on planes directly, implemented in color_convert.c
+void bgr_rows_to_ycbcr_420(PlanarImage *image, const unsigned char *pixels, int row_stride,
+                           int height, int width, int fixed_point);
+void rgb_to_ycbcr_420(PlanarImage *image, RGB_Image rgb_image, int fixed_point);
+int save_ycbcr_image_420(const char *filename, const PlanarImage *image, int fancy_upsampling,
+                         BITMAPFILEHEADER *original_file_header, BITMAPINFOHEADER *original_info_header);
+
+/**
+ * @brief First sample of a row of the plane
+ */
+static inline unsigned char *image_plane_row(const ImagePlane *plane, int row) {
+    return plane->data + (size_t) row * plane->stride;
+}
+
+#endif
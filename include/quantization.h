@@ -20,6 +20,14 @@ typedef struct {
     int ***cr_zigzag;  // Chrominance-red zigzag arrays
 } ZigzagMatrix;
 
+// Division-free quantizer for one (table, factor) pair, all entries in zigzag order
+typedef struct {
+    uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];    // round(table * factor), at least 1
+    uint32_t reciprocals[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]; // ceil(2^32 / divisor), divisor scaled for fdct_islow output
+    uint16_t biases[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];      // Scaled divisor / 2, rounds half away from zero
+    float scales[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];         // 1 / (table * factor), AAN scaling optionally folded in
+} Quantizer;
+
 extern int luminance_quantization_table[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
 extern int chrominance_quantization_table[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
 
@@ -27,8 +35,26 @@ extern int zigzag_table[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE][2];
 
 double **quantize_block(double **block, double factor, QuantizationType type);
 double **dequantize_block(double **block, double factor, QuantizationType type);
+double **quantize_block_arena(Arena *arena, double **block, double factor, QuantizationType type);
+double **dequantize_block_arena(Arena *arena, double **block, double factor, QuantizationType type);
+void compute_aan_quantization_table(double divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE], double factor, QuantizationType type);
+void compute_aan_dequantization_table(double multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE], double factor, QuantizationType type);
+double **quantize_block_aan(double **block, double divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+double **dequantize_block_aan(double **block, double multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+double **quantize_block_aan_arena(Arena *arena, double **block, double divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+double **dequantize_block_aan_arena(Arena *arena, double **block, double multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]);
+void compute_int_quantization_table(uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], double factor, QuantizationType type);
+void quantize_block_int(int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void dequantize_block_int(int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void init_quantizer(Quantizer *quantizer, double factor, QuantizationType type, int aan_scaled);
+void quantize_block_reciprocal(const int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const Quantizer *quantizer,
+                               int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void quantize_float_block_reciprocal(const float block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const Quantizer *quantizer,
+                                     int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
 int *zigzag_scan(double **block);
 double **inverse_zigzag_scan(int *zigzag_array);
+void zigzag_scan_int16(const int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+void inverse_zigzag_scan_int16(const int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
 ZigzagMatrix init_zigzag_matrix(int y_block_rows, int y_block_cols, int c_block_rows, int c_block_cols);
 void free_zigzag_matrix(ZigzagMatrix *zigzag_matrix);
 ZigzagMatrix blocks_to_arrays(DCTBlocks blocks);
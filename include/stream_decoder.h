@@ -0,0 +1,52 @@
+#ifndef _STREAM_DECODER_H
+#define _STREAM_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitmap.h"
+#include "bitstream.h"
+#include "block_kernel.h"
+#include "huffman.h"
+#include "planar_image.h"
+
+#define STREAM_DECODER_MCU_ROWS 16 // Output scanlines per MCU row with 4:2:0 sampling
+#define STREAM_CHROMA_WINDOW 3     // Chroma block rows kept: previous, current and next
+
+// Receives decoded scanlines, count rows of interleaved BGR starting at first_row
+typedef void (*ScanlineCallback)(void *context, unsigned char **rows, int first_row, int count);
+
+// Decoder producing BGR scanlines one MCU row at a time. Decoded pixels held grow with the width, not
+// the height, but the compressed file is read from memory whole; see stream_decoder_init
+typedef struct {
+    BITMAPFILEHEADER file_header;               // Headers of the decoded bitmap, sized to height x width
+    BITMAPINFOHEADER info_header;
+    int height, width;                          // Decoded size, whole luminance blocks
+    int luma_block_rows, luma_block_cols;
+    int chroma_block_rows, chroma_block_cols;
+    int chroma_rows, chroma_cols;               // Chroma samples carrying image data
+    int fancy_upsampling;
+    int interleaved;                            // Blocks in MCU order, read with luma_reader alone
+    int restart_interval;                       // MCUs per restart interval, 0 for none
+    int mcus_decoded;                           // MCUs read so far when interleaved
+    int restart_errors;                         // Restart markers that were missing or out of order
+
+    BlockKernel kernels[2];                     // Indexed by QuantizationType
+    HuffmanDecoder *huffman;
+    BitReader luma_reader;                      // Positioned at the first Y block
+    BitReader chroma_reader;                    // Positioned at the first Cb block, unused when interleaved
+    int previous_dc_y, previous_dc_cb, previous_dc_cr;
+
+    ImagePlane y_strip;                         // Y of the current MCU row, and of the next one when interleaved
+    ImagePlane cb_window, cr_window;            // STREAM_CHROMA_WINDOW block rows, ring indexed by block row
+    int luma_mcu_row;                           // MCU row held in y_strip, -1 before the first
+    int chroma_block_rows_decoded;
+    int next_row;                               // Next scanline to produce
+    ImagePlane scratch;                         // Upsampled Cb, Cr and R, G, B of one row
+} StreamDecoder;
+
+int stream_decoder_init(StreamDecoder *decoder, const uint8_t *data, size_t size, DCTMethod method, int fancy_upsampling);
+int stream_decoder_read_scanlines(StreamDecoder *decoder, unsigned char **rows, int max_rows);
+void stream_decoder_run(StreamDecoder *decoder, ScanlineCallback callback, void *context);
+void stream_decoder_close(StreamDecoder *decoder);
+
+#endif
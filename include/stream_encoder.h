@@ -0,0 +1,73 @@
+#ifndef _STREAM_ENCODER_H
+#define _STREAM_ENCODER_H
+
+#include <stdio.h>
+#include "bitmap.h"
+#include "bitstream.h"
+#include "block_kernel.h"
+#include "dc_encode.h"
+#include "ac_encode.h"
+#include "planar_image.h"
+#include "bin_format.h"
+#include "entropy_segments.h"
+
+#define STREAM_MCU_ROWS 16 // Source rows per MCU row with 4:2:0 sampling
+
+// Spill file and row buffers kept between files by a caller encoding many of them
+typedef struct {
+    FILE *chroma_spill;                        // Created by the first sequential file, rewound for the next ones
+    ImagePlane y_strip;                        // Planes grow to the widest image encoded so far
+    ImagePlane cb_strip, cr_strip;
+    ImagePlane cb_pair, cr_pair;
+    unsigned char *cb_edge, *cr_edge;
+    int edge_capacity;                         // Entries of cb_edge and cr_edge
+    int16_t *mcu_blocks;
+    int mcu_block_capacity;                    // Blocks of mcu_blocks
+} StreamWorkspace;
+
+// Encoder fed a strip of rows at a time; memory grows with the width, not the height
+typedef struct {
+    int height, width;
+    int chroma_height, chroma_width;           // Padded 4:2:0 geometry, as ycbcr_subsampling_420
+    int luma_block_rows, luma_block_cols;
+    int chroma_block_rows, chroma_block_cols;
+    int fixed_point;                           // Use bgr_row_to_ycbcr_fixed for color conversion
+    int interleaved;                           // Blocks in MCU order, no chroma spill
+    int segment_count;
+    long table_position;                       // Output file position of the segment table
+
+    BlockKernel kernels[2];                    // Indexed by QuantizationType
+    DCEncoder dc_encoder;
+    ACEncoder ac_encoder;
+
+    BitWriter writer;                          // Headers and luminance, straight to the output file
+    McuCoder mcu_coder;                        // Restart intervals and segment offsets when interleaved
+    BitWriter chroma_writer;                   // Cb/Cr blocks, appended after the last luminance block
+    FILE *chroma_spill;                        // Temporary file behind chroma_writer, NULL when interleaved
+    int previous_dc_y, previous_dc_cb, previous_dc_cr;
+
+    int rows_received;                         // Source rows converted so far
+    int chroma_rows_ready;                     // Chroma rows completed so far
+    int luma_block_rows_done, chroma_block_rows_done; // Chroma block rows double as MCU rows when interleaved
+    ImagePlane y_strip;                        // STREAM_MCU_ROWS rows of Y
+    ImagePlane cb_strip, cr_strip;             // One block row of subsampled chroma
+    ImagePlane cb_pair, cr_pair;               // Full-resolution chroma of the current pair of rows
+    unsigned char *cb_edge, *cr_edge;          // Right padding of each chroma row, NULL if there is none
+    int16_t *mcu_blocks;                       // Coefficients of one MCU row when interleaved: Y, Cb, then Cr
+    size_t compressed_size;                    // Bytes written, valid after stream_encoder_finish
+    StreamWorkspace *workspace;                // Keeps the spill and buffers after finish, NULL to free them
+} StreamEncoder;
+
+int stream_encoder_init(StreamEncoder *encoder, FILE *output, const BITMAPFILEHEADER *file_header,
+                        const BITMAPINFOHEADER *info_header, DCTMethod method,
+                        DCEncoder dc_encoder, ACEncoder ac_encoder, int fixed_point, const BinLayout *layout);
+int stream_encoder_init_kernels(StreamEncoder *encoder, FILE *output, const BITMAPFILEHEADER *file_header,
+                                const BITMAPINFOHEADER *info_header, const BlockKernel kernels[2],
+                                DCEncoder dc_encoder, ACEncoder ac_encoder, int fixed_point, const BinLayout *layout,
+                                StreamWorkspace *workspace);
+void stream_encoder_write_rows(StreamEncoder *encoder, const unsigned char *bgr, int row_stride, int rows);
+int stream_encoder_finish(StreamEncoder *encoder);
+void stream_workspace_init(StreamWorkspace *workspace);
+void stream_workspace_destroy(StreamWorkspace *workspace);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <pthread.h>
+
+// Work item of a parallel loop, called once for every index in [0, count)
+typedef void (*ThreadTask)(void *context, int index);
+
+// Fixed set of worker threads running one parallel loop at a time
+typedef struct {
+    int thread_count;              // Threads taking part in a loop, the caller included
+    pthread_t *workers;            // thread_count - 1 worker threads
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;     // Signalled when a new loop starts or the pool shuts down
+    pthread_cond_t work_done;      // Signalled when the last index of a loop completes
+    ThreadTask task;
+    void *context;
+    int task_count;
+    int next_task;                 // Next index to hand out
+    int tasks_finished;
+    unsigned int generation;       // Incremented for every loop, so workers see each one once
+    int shutting_down;
+} ThreadPool;
+
+int thread_pool_init(ThreadPool *pool, int thread_count);
+void thread_pool_parallel_for(ThreadPool *pool, int count, ThreadTask task, void *context);
+void thread_pool_destroy(ThreadPool *pool);
+int thread_pool_default_threads();
+
+#endif
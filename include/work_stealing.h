@@ -0,0 +1,29 @@
+#ifndef _WORK_STEALING_H
+#define _WORK_STEALING_H
+
+#include <pthread.h>
+
+// Job of a work-stealing loop, called once for every index in [0, job_count) by the worker that owns it
+typedef void (*StealingTask)(void *context, int worker, int job);
+
+// Jobs [begin, end) still owned by one worker; the owner takes from begin, thieves split off the end
+typedef struct {
+    pthread_mutex_t lock;
+    int begin, end;
+    int jobs_run;     // Jobs this worker completed
+    int steals;       // Successful steals by this worker
+} WorkRange;
+
+// Jobs dealt out in contiguous ranges, idle workers steal half of a busy worker's remainder
+typedef struct {
+    int worker_count;
+    WorkRange *ranges;
+    StealingTask task;
+    void *context;
+} WorkStealingScheduler;
+
+void work_stealing_init(WorkStealingScheduler *scheduler, int worker_count, int job_count);
+int work_stealing_run(WorkStealingScheduler *scheduler, StealingTask task, void *context);
+void work_stealing_destroy(WorkStealingScheduler *scheduler);
+
+#endif
@@ -28,3 +28,39 @@ void encode_ac(BitWriter* bw, int ac[64]) {
     }
     
 }
+
+/**
+ * @brief Table-driven AC encoder
+ *
+ * Produces exactly the same bits as encode_ac, but looks the (run, category)
+ * code up in huffman_ac_codes and emits the code and the mantissa together
+ * with a single bitwriter_write_code call per coefficient.
+ *
+ * @param bw BitWriter receiving the encoded bits
+ * @param ac Zigzag-ordered block; ac[0] (the DC term) is ignored
+ */
+void encode_ac_table(BitWriter* bw, int ac[64]) {
+    int zero_run = 0;
+    for (int i = 1; i < 64; i++) {
+        int val = ac[i];
+        if (val == 0) {
+            zero_run++;
+            continue;
+        }
+        while (zero_run > 15) {
+            HuffmanCode zrl = huffman_ac_codes[15][0]; // ZRL F/0
+            bitwriter_write_code(bw, zrl.code, zrl.length);
+            zero_run -= 16;
+        }
+        int size = get_category_fast(val);
+        HuffmanCode prefix = huffman_ac_codes[zero_run][size];
+        uint32_t mask = (1u << size) - 1;
+        uint32_t mantissa = (uint32_t)(val > 0 ? val : val - 1) & mask;
+        bitwriter_write_code(bw, ((uint32_t)prefix.code << size) | mantissa, prefix.length + size);
+        zero_run = 0;
+    }
+    if (zero_run > 0) {
+        HuffmanCode eob = huffman_ac_codes[0][0]; // EOB
+        bitwriter_write_code(bw, eob.code, eob.length);
+    }
+}
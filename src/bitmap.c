@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bitmap.h"
 #include "platform.h"
 
@@ -7,7 +8,8 @@
  * @brief Loads and processes the BMP file headers
  *
  * This function reads both file header and info header from the BMP file.
- * If the file uses compression, it prints a warning and closes the file.
+ * If the bitmap is not supported (see validate_bmp_headers), it prints an
+ * error, closes the file and exits the program.
  * Otherwise, it displays the header information.
  *
  * @param fp File pointer to an opened BMP file
@@ -17,15 +19,39 @@
 void load_bmp_header(FILE *fp, BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header) {
     read_bmp_header(fp, file_header);
     read_bmp_info(fp, info_header);
-    if(info_header->Compression != 0) {
-        printf("This is a compressed bitmap file.\n");
+    if (validate_bmp_headers(file_header, info_header) != 0) {
+        if (info_header->Compression != 0) {
+            printf("This is a compressed bitmap file.\n");
+        } else {
+            printf("Unsupported bitmap file: only 24-bit bitmaps can be read.\n");
+        }
         fclose(fp);
-        return;
+        exit(EXIT_FAILURE);
     }
 
     print_bmp_headers(file_header, info_header);
 }
 
+/**
+ * @brief Checks that bitmap headers describe an image the codec can read
+ *
+ * The one rule set for every input path (load_bmp_header for stdio,
+ * streaming and pipelined input, map_bmp_file for mapped input): an
+ * uncompressed 24-bit bitmap with positive dimensions. Missing pixel data
+ * is not an error; the readers zero-fill it with a warning.
+ *
+ * @param file_header Bitmap file header read by read_bmp_header or parse_bmp_headers
+ * @param info_header Bitmap info header read by read_bmp_info or parse_bmp_headers
+ * @return 0 if the bitmap is supported, -1 otherwise
+ */
+int validate_bmp_headers(const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header) {
+    if (file_header->Type != BF_TYPE || info_header->Compression != 0 || info_header->BitCount != 24 ||
+        info_header->Width <= 0 || info_header->Height <= 0) {
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * @brief Reads the bitmap file header from a file
  *
@@ -72,6 +98,96 @@ void read_bmp_info(FILE *fp, BITMAPINFOHEADER *info_header) {
     }
 }
 
+static void put_u16(unsigned char *out, unsigned int value) {
+    out[0] = (unsigned char)(value & 0xFF);
+    out[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static void put_u32(unsigned char *out, unsigned int value) {
+    put_u16(out, value & 0xFFFF);
+    put_u16(out + 2, (value >> 16) & 0xFFFF);
+}
+
+static unsigned int get_u16(const unsigned char *in) {
+    return (unsigned int)in[0] | ((unsigned int)in[1] << 8);
+}
+
+static unsigned int get_u32(const unsigned char *in) {
+    return get_u16(in) | (get_u16(in + 2) << 16);
+}
+
+/**
+ * @brief Serializes the bitmap headers into their 54-byte on-disk layout
+ *
+ * The fields are written little-endian in the same order read_bmp_header and
+ * read_bmp_info read them, so the result can be written to any byte stream
+ * (for example a memory-backed BitWriter) instead of a FILE.
+ *
+ * @param out Output buffer of at least BMP_HEADERS_SIZE bytes
+ * @param file_header Bitmap file header to serialize
+ * @param info_header Bitmap info header to serialize
+ */
+void serialize_bmp_headers(unsigned char *out, const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header) {
+    put_u16(out + 0, file_header->Type);
+    put_u32(out + 2, file_header->Size);
+    put_u16(out + 6, file_header->Reserved1);
+    put_u16(out + 8, file_header->Reserved2);
+    put_u32(out + 10, file_header->OffBits);
+
+    put_u32(out + 14, info_header->Size);
+    put_u32(out + 18, (unsigned int)info_header->Width);
+    put_u32(out + 22, (unsigned int)info_header->Height);
+    put_u16(out + 26, info_header->Planes);
+    put_u16(out + 28, info_header->BitCount);
+    put_u32(out + 30, info_header->Compression);
+    put_u32(out + 34, info_header->SizeImage);
+    put_u32(out + 38, (unsigned int)info_header->XResolution);
+    put_u32(out + 42, (unsigned int)info_header->YResolution);
+    put_u32(out + 46, info_header->NColors);
+    put_u32(out + 50, info_header->ImportantColors);
+}
+
+/**
+ * @brief Parses the bitmap headers from a memory buffer
+ *
+ * Memory counterpart of read_bmp_header + read_bmp_info. Unlike those, it
+ * reports errors through the return value instead of exiting.
+ *
+ * @param data Buffer holding at least the first BMP_HEADERS_SIZE bytes of the file
+ * @param size Number of bytes available in data
+ * @param file_header Pointer to store the bitmap file header data
+ * @param info_header Pointer to store the bitmap info header data
+ * @return 0 on success, -1 if the buffer is too small or not a bitmap
+ */
+int parse_bmp_headers(const unsigned char *data, size_t size, BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header) {
+    if (size < BMP_HEADERS_SIZE) {
+        return -1;
+    }
+
+    file_header->Type = (unsigned short)get_u16(data + 0);
+    file_header->Size = get_u32(data + 2);
+    file_header->Reserved1 = (unsigned short)get_u16(data + 6);
+    file_header->Reserved2 = (unsigned short)get_u16(data + 8);
+    file_header->OffBits = get_u32(data + 10);
+
+    info_header->Size = get_u32(data + 14);
+    info_header->Width = (int)get_u32(data + 18);
+    info_header->Height = (int)get_u32(data + 22);
+    info_header->Planes = (unsigned short)get_u16(data + 26);
+    info_header->BitCount = (unsigned short)get_u16(data + 28);
+    info_header->Compression = get_u32(data + 30);
+    info_header->SizeImage = get_u32(data + 34);
+    info_header->XResolution = (int)get_u32(data + 38);
+    info_header->YResolution = (int)get_u32(data + 42);
+    info_header->NColors = get_u32(data + 46);
+    info_header->ImportantColors = get_u32(data + 50);
+
+    if (file_header->Type != BF_TYPE) {
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * @brief Prints the contents of bitmap headers
  *
@@ -107,4 +223,56 @@ void print_bmp_headers(BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_hea
     if (result != 0) {
         fprintf(stderr, "Warning: system pause command failed with code %d\n", result);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Bytes per stored row of a 24-bit bitmap
+ *
+ * Rows are padded with zeros to a multiple of 4 bytes.
+ *
+ * @param width Width of the bitmap in pixels
+ * @return Row size in bytes including padding
+ */
+int bmp_row_stride(int width) {
+    return ((width * 3 + 3) / 4) * 4;
+}
+
+/**
+ * @brief Reads count stored rows of a bitmap, zero-filling what the file is short of
+ *
+ * Missing pixels decode as black, as read_rgb_image does.
+ *
+ * @param fp File positioned at the first row to read
+ * @param rows Destination, count * row_stride bytes
+ * @param row_stride Bytes per stored row, padding included
+ * @param count Number of rows
+ * @return 1 if the file ended before the last row, 0 otherwise
+ */
+int read_bmp_rows(FILE *fp, unsigned char *rows, int row_stride, int count) {
+    size_t wanted = (size_t) row_stride * (size_t) count;
+    size_t got = fread(rows, 1, wanted, fp);
+    if (got < wanted) {
+        memset(rows + got, 0, wanted - got);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the dimensions of a 24-bit bitmap and the two size fields that follow from them
+ *
+ * Width and Height are replaced, SizeImage becomes the padded pixel data size
+ * and Size the pixel offset plus that, so the headers describe exactly the
+ * rows written after them.
+ *
+ * @param file_header Pointer to the file header to update
+ * @param info_header Pointer to the info header to update
+ * @param width Width of the stored rows in pixels
+ * @param height Number of stored rows
+ */
+void set_bmp_dimensions(BITMAPFILEHEADER *file_header, BITMAPINFOHEADER *info_header, int width, int height) {
+    info_header->Width = width;
+    info_header->Height = height;
+    info_header->SizeImage = (unsigned int) bmp_row_stride(width) * (unsigned int) height;
+    file_header->Size = file_header->OffBits + info_header->SizeImage;
+}
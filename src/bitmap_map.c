@@ -0,0 +1,153 @@
+#if defined(unix) || defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define BITMAP_MAP_POSIX 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitmap.h"
+
+#ifdef BITMAP_MAP_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Reads a whole file into a heap buffer, used where mmap is unavailable
+ */
+static int read_whole_file(const char *filename, MappedBitmap *bitmap) {
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    unsigned char *data = (unsigned char *)malloc((size_t) size);
+    if (data == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fread(data, 1, (size_t) size, fp) != (size_t) size) {
+        free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    bitmap->data = data;
+    bitmap->size = (size_t) size;
+    bitmap->mapped = 0;
+    return 0;
+}
+
+/**
+ * @brief Maps a 24-bit uncompressed bitmap file and validates its headers
+ *
+ * The headers are decoded with parse_bmp_headers, the in-memory counterpart
+ * of read_bmp_header/read_bmp_info, and checked with validate_bmp_headers like
+ * the stdio path. The pixel rows are not copied: bitmap->pixels points into
+ * the mapping and stays valid until unmap_bmp_file. Only when the pixel data
+ * is truncated are the rows copied, zero-filled like read_rgb_image does,
+ * with the same warning.
+ *
+ * @param filename Path of the bitmap
+ * @param bitmap Output description of the mapped file
+ * @return 0 on success, -1 if the file cannot be read or is not a supported bitmap
+ */
+int map_bmp_file(const char *filename, MappedBitmap *bitmap) {
+    bitmap->data = NULL;
+    bitmap->size = 0;
+    bitmap->mapped = 0;
+    bitmap->pixels = NULL;
+    bitmap->filled = NULL;
+
+#ifdef BITMAP_MAP_POSIX
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        // Some filesystems cannot be mapped; fall back to reading
+        if (read_whole_file(filename, bitmap) != 0) {
+            return -1;
+        }
+    } else {
+        bitmap->data = (const unsigned char *) data;
+        bitmap->size = (size_t) info.st_size;
+        bitmap->mapped = 1;
+    }
+#else
+    if (read_whole_file(filename, bitmap) != 0) {
+        return -1;
+    }
+#endif
+
+    BITMAPFILEHEADER *fh = &bitmap->file_header;
+    BITMAPINFOHEADER *ih = &bitmap->info_header;
+    if (parse_bmp_headers(bitmap->data, bitmap->size, fh, ih) != 0 || validate_bmp_headers(fh, ih) != 0) {
+        unmap_bmp_file(bitmap);
+        return -1;
+    }
+
+    bitmap->row_stride = bmp_row_stride(ih->Width);
+    size_t pixel_bytes = (size_t) bitmap->row_stride * (size_t) ih->Height;
+    size_t available = fh->OffBits < bitmap->size ? bitmap->size - fh->OffBits : 0;
+    if (available < pixel_bytes) {
+        // Missing pixels decode as black, as read_rgb_image does
+        bitmap->filled = (unsigned char *)calloc(pixel_bytes, 1);
+        if (bitmap->filled == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (available > 0) {
+            memcpy(bitmap->filled, bitmap->data + fh->OffBits, available);
+        }
+        fprintf(stderr, "Warning: bitmap pixel data is truncated\n");
+        bitmap->pixels = bitmap->filled;
+    } else {
+        bitmap->pixels = bitmap->data + fh->OffBits;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Releases a bitmap opened with map_bmp_file
+ *
+ * @param bitmap Bitmap to release
+ */
+void unmap_bmp_file(MappedBitmap *bitmap) {
+    if (bitmap->data != NULL) {
+#ifdef BITMAP_MAP_POSIX
+        if (bitmap->mapped) {
+            munmap((void *) bitmap->data, bitmap->size);
+        } else {
+            free((void *) bitmap->data);
+        }
+#else
+        free((void *) bitmap->data);
+#endif
+    }
+    free(bitmap->filled);
+    bitmap->filled = NULL;
+    bitmap->data = NULL;
+    bitmap->pixels = NULL;
+    bitmap->size = 0;
+    bitmap->mapped = 0;
+}
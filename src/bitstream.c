@@ -2,77 +2,365 @@
 #include <stdlib.h>
 #include "bitstream.h"
 
-void bitwriter_init(BitWriter* bw, const char* filename) {
-    bw->file = fopen(filename, "ab");
+// Coloca o BitWriter no estado inicial, sem destino associado
+static void bitwriter_reset(BitWriter* bw) {
+    bw->file = NULL;
     bw->buffer = 0;
     bw->bits_filled = 0;
+    bw->accumulator = 0;
+    bw->accumulator_bits = 0;
+    bw->out_buffer = NULL;
+    bw->out_capacity = 0;
+    bw->out_position = 0;
+    bw->sink = BITWRITER_SINK_FILE;
+    bw->owns_file = 1;
+    bw->overflow = 0;
+    bw->bytes_flushed = 0;
+}
+
+void bitwriter_init(BitWriter* bw, const char* filename) {
+    bitwriter_reset(bw);
+    bw->file = fopen(filename, "ab");
+}
+
+// Aloca o buffer de saída do modo bufferizado
+static void bitwriter_alloc_buffer(BitWriter* bw, size_t buffer_size) {
+    if (buffer_size == 0) {
+        buffer_size = BITWRITER_DEFAULT_BUFFER_SIZE;
+    }
+    bw->out_buffer = (uint8_t*)malloc(buffer_size);
+    if (bw->out_buffer == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    bw->out_capacity = buffer_size;
+}
+
+// Inicializa o BitWriter no modo bufferizado: os bits são acumulados em um
+// registrador de 64 bits e os bytes completos vão para um buffer de
+// buffer_size bytes, que só é escrito no arquivo quando enche (ou no flush)
+void bitwriter_init_buffered(BitWriter* bw, const char* filename, size_t buffer_size) {
+    bitwriter_init(bw, filename);
+    bitwriter_alloc_buffer(bw, buffer_size);
+}
+
+// Inicializa o BitWriter bufferizado sobre um arquivo já aberto pelo chamador,
+// a partir da posição atual; o arquivo não é fechado no flush
+void bitwriter_init_file(BitWriter* bw, FILE* file, size_t buffer_size) {
+    bitwriter_reset(bw);
+    bw->file = file;
+    bw->owns_file = 0;
+    bitwriter_alloc_buffer(bw, buffer_size);
+}
+
+// Inicializa o BitWriter escrevendo diretamente na memória do chamador;
+// se capacity bytes não forem suficientes, overflow é marcado e o excesso descartado
+void bitwriter_init_memory(BitWriter* bw, uint8_t* data, size_t capacity) {
+    bitwriter_reset(bw);
+    bw->sink = BITWRITER_SINK_MEMORY;
+    bw->owns_file = 0;
+    bw->out_buffer = data;
+    bw->out_capacity = capacity;
+}
+
+// Inicializa o BitWriter escrevendo em um buffer que cresce conforme necessário.
+// Após o flush, out_buffer/out_position contêm os dados e o chamador deve liberá-los com free
+void bitwriter_init_growable(BitWriter* bw, size_t initial_capacity) {
+    bitwriter_reset(bw);
+    bw->sink = BITWRITER_SINK_GROWABLE;
+    bw->owns_file = 0;
+    bitwriter_alloc_buffer(bw, initial_capacity);
+}
+
+// Esvazia o buffer de saída: grava no arquivo ou abre espaço na memória
+static void bitwriter_flush_buffer(BitWriter* bw) {
+    switch (bw->sink) {
+    case BITWRITER_SINK_FILE:
+        if (bw->out_position > 0) {
+            fwrite(bw->out_buffer, 1, bw->out_position, bw->file);
+            bw->bytes_flushed += bw->out_position;
+            bw->out_position = 0;
+        }
+        break;
+    case BITWRITER_SINK_GROWABLE:
+        if (bw->out_position == bw->out_capacity) {
+            size_t capacity = bw->out_capacity * 2;
+            uint8_t* data = (uint8_t*)realloc(bw->out_buffer, capacity);
+            if (data == NULL) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            bw->out_buffer = data;
+            bw->out_capacity = capacity;
+        }
+        break;
+    case BITWRITER_SINK_MEMORY:
+        break;
+    }
+}
+
+// Move os bytes completos do acumulador para o buffer de saída
+static void bitwriter_drain(BitWriter* bw) {
+    while (bw->accumulator_bits >= 8) {
+        if (bw->out_position == bw->out_capacity) {
+            bitwriter_flush_buffer(bw);
+        }
+        bw->accumulator_bits -= 8;
+        if (bw->out_position < bw->out_capacity) {
+            bw->out_buffer[bw->out_position++] = (uint8_t)(bw->accumulator >> bw->accumulator_bits);
+        } else {
+            bw->overflow = 1;
+        }
+    }
+}
+
+// Escreve os length bits menos significativos de code (MSB primeiro)
+void bitwriter_write_code(BitWriter* bw, uint32_t code, int length) {
+    if (length <= 0) {
+        return;
+    }
+    if (bw->out_buffer == NULL) {
+        for (int i = length - 1; i >= 0; i--) {
+            bitwriter_write_bit(bw, (code >> i) & 1);
+        }
+        return;
+    }
+    if (bw->accumulator_bits + length > 64) {
+        bitwriter_drain(bw);
+    }
+    if (length < 32) {
+        code &= ((uint32_t)1 << length) - 1;
+    }
+    bw->accumulator = (bw->accumulator << length) | code;
+    bw->accumulator_bits += length;
 }
 
 void bitwriter_write_bit(BitWriter* bw, int bit) {
+    if (bw->out_buffer != NULL) {
+        bitwriter_write_code(bw, (uint32_t)bit, 1);
+        return;
+    }
     bw->buffer = (bw->buffer << 1) | (bit & 1);
     bw->bits_filled++;
     if (bw->bits_filled == 8) {
         fwrite(&bw->buffer, 1, 1, bw->file);
+        bw->bytes_flushed++;
         bw->bits_filled = 0;
         bw->buffer = 0;
     }
 }
 
 void bitwriter_write_bits(BitWriter* bw, const char* bits) {
+    if (bw->out_buffer != NULL) {
+        uint32_t code = 0;
+        int length = 0;
+        for (int i = 0; bits[i]; i++) {
+            code = (code << 1) | (uint32_t)(bits[i] - '0');
+            if (++length == 32) {
+                bitwriter_write_code(bw, code, length);
+                code = 0;
+                length = 0;
+            }
+        }
+        bitwriter_write_code(bw, code, length);
+        return;
+    }
     for (int i = 0; bits[i]; i++) {
         bitwriter_write_bit(bw, bits[i] - '0');
     }
 }
 
 void bitwriter_write_int(BitWriter* bw, int value, int size) {
+    if (bw->out_buffer != NULL) {
+        bitwriter_write_code(bw, (uint32_t)value, size);
+        return;
+    }
     for (int i = size - 1; i >= 0; i--) {
         bitwriter_write_bit(bw, (value >> i) & 1);
     }
 }
 
+// Escreve bytes inteiros (o fluxo deve estar alinhado em byte, como no início do arquivo)
+void bitwriter_write_bytes(BitWriter* bw, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        bitwriter_write_code(bw, bytes[i], 8);
+    }
+}
+
+// Completa o byte atual com zeros, se houver bits pendentes
+void bitwriter_align(BitWriter* bw) {
+    if (bw->out_buffer != NULL) {
+        int pending = bw->accumulator_bits % 8;
+        if (pending > 0) {
+            bitwriter_write_code(bw, 0, 8 - pending);
+        }
+        return;
+    }
+    while (bw->bits_filled > 0) {
+        bitwriter_write_bit(bw, 0);
+    }
+}
+
+// Número de bytes completos produzidos até agora (sem contar bits pendentes)
+size_t bitwriter_bytes_written(const BitWriter* bw) {
+    if (bw->out_buffer == NULL) {
+        return bw->bytes_flushed;
+    }
+    return bw->bytes_flushed + bw->out_position + (size_t)(bw->accumulator_bits / 8);
+}
+
 void bitwriter_flush(BitWriter* bw) {
+    if (bw->out_buffer != NULL) {
+        bitwriter_drain(bw);
+        if (bw->accumulator_bits > 0) {
+            // Completa o último byte com zeros
+            bitwriter_write_code(bw, 0, 8 - bw->accumulator_bits);
+            bitwriter_drain(bw);
+        }
+        bw->accumulator = 0;
+        bw->accumulator_bits = 0;
+        if (bw->sink != BITWRITER_SINK_FILE) {
+            return; // Os dados ficam em out_buffer[0..out_position)
+        }
+        bitwriter_flush_buffer(bw);
+        free(bw->out_buffer);
+        bw->out_buffer = NULL;
+        if (bw->owns_file) {
+            fclose(bw->file);
+        }
+        return;
+    }
     if (bw->bits_filled > 0) {
         bw->buffer <<= (8 - bw->bits_filled);
         fwrite(&bw->buffer, 1, 1, bw->file);
+        bw->bytes_flushed++;
     }
     fclose(bw->file);
 }
 
+// Grava no arquivo todos os bytes completos e devolve em tail_code os bits
+// restantes (menos de 8), sem completar o último byte; o buffer é liberado,
+// mas o arquivo continua aberto. Só vale para o modo bufferizado em arquivo
+void bitwriter_detach(BitWriter* bw, uint32_t* tail_code, int* tail_bits) {
+    bitwriter_drain(bw);
+    *tail_bits = bw->accumulator_bits;
+    *tail_code = (uint32_t)(bw->accumulator & ((1u << bw->accumulator_bits) - 1));
+    bw->accumulator = 0;
+    bw->accumulator_bits = 0;
+    bitwriter_flush_buffer(bw);
+    free(bw->out_buffer);
+    bw->out_buffer = NULL;
+}
+
 // Inicializa o BitReader
 void bitreader_init(BitReader* br, const char* filename) {
-    br->file = fopen(filename, "rb");
-    br->buffer = 0;
-    br->bits_available = 0;
+    bitreader_init_file(br, fopen(filename, "rb"));
+    br->owns_file = 1;
+}
+
+// Inicializa o BitReader sobre um arquivo já aberto, a partir da posição atual.
+// O arquivo continua pertencendo ao chamador
+void bitreader_init_file(BitReader* br, FILE* file) {
+    br->file = file;
+    br->owns_file = 0;
+    br->input_storage = (uint8_t*)malloc(BITREADER_INPUT_SIZE);
+    if (br->input_storage == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    br->input = br->input_storage;
+    br->input_size = 0;
+    br->input_position = 0;
+    br->bit_buffer = 0;
+    br->bit_count = 0;
+}
+
+// Inicializa o BitReader lendo diretamente de size bytes na memória do chamador
+void bitreader_init_memory(BitReader* br, const uint8_t* data, size_t size) {
+    br->file = NULL;
+    br->owns_file = 0;
+    br->input_storage = NULL;
+    br->input = data;
+    br->input_size = size;
+    br->input_position = 0;
+    br->bit_buffer = 0;
+    br->bit_count = 0;
+}
+
+// Completa o buffer de bits com bytes da entrada (até ter mais de 56 bits)
+void bitreader_refill(BitReader* br) {
+    while (br->bit_count <= 56) {
+        if (br->input_position == br->input_size) {
+            if (br->file == NULL) {
+                return; // Fim dos dados em memória
+            }
+            br->input_size = fread(br->input_storage, 1, BITREADER_INPUT_SIZE, br->file);
+            br->input_position = 0;
+            if (br->input_size == 0) {
+                return; // Fim do arquivo
+            }
+        }
+        br->bit_buffer |= (uint64_t)br->input[br->input_position++] << (56 - br->bit_count);
+        br->bit_count += 8;
+    }
+}
+
+// Número de bits já consumidos desde o início dos dados em memória
+size_t bitreader_bits_consumed(const BitReader* br) {
+    return br->input_position * 8 - (size_t)br->bit_count;
+}
+
+// Descarta os bits restantes do byte atual
+void bitreader_align(BitReader* br) {
+    bitreader_skip_bits(br, br->bit_count % 8);
 }
 
 // Lê um único bit
 int bitreader_read_bit(BitReader* br) {
-    if (br->bits_available == 0) {
-        if (fread(&br->buffer, 1, 1, br->file) != 1) {
+    if (br->bit_count == 0) {
+        bitreader_refill(br);
+        if (br->bit_count == 0) {
             return -1; // Retorna -1 em caso de erro ou fim do arquivo
         }
-        br->bits_available = 8;
     }
 
-    int bit = (br->buffer >> (br->bits_available - 1)) & 1;
-    br->bits_available--;
+    int bit = (int)(br->bit_buffer >> 63);
+    bitreader_skip_bits(br, 1);
     return bit;
 }
 
 // Lê múltiplos bits
 int bitreader_read_bits(BitReader* br, int size) {
-    int value = 0;
-    for (int i = 0; i < size; i++) {
-        int bit = bitreader_read_bit(br);
-        if (bit == -1) {
+    if (size <= 0) {
+        return 0;
+    }
+    if (br->bit_count < size) {
+        bitreader_refill(br);
+        if (br->bit_count < size) {
             return -1; // Retorna -1 em caso de erro ou fim do arquivo
         }
-        value = (value << 1) | bit;
     }
+    int value = (int)bitreader_peek_bits(br, size);
+    bitreader_skip_bits(br, size);
     return value;
 }
 
+// Lê bytes inteiros (o fluxo deve estar alinhado em byte); faltando dados, completa com zeros
+void bitreader_read_bytes(BitReader* br, void* data, size_t size) {
+    uint8_t* bytes = (uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = (uint8_t)bitreader_peek_bits(br, 8);
+        bitreader_skip_bits(br, br->bit_count < 8 ? br->bit_count : 8);
+    }
+}
+
 // Fecha o BitReader
 void bitreader_close(BitReader* br) {
-    fclose(br->file);
-}
\ No newline at end of file
+    if (br->owns_file) {
+        fclose(br->file);
+    }
+    free(br->input_storage);
+    br->input_storage = NULL;
+    br->input = NULL;
+}
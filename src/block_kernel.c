@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "block_kernel.h"
+
+#define BLOCK_AREA (DCT_BLOCK_SIZE * DCT_BLOCK_SIZE)
+
+/**
+ * @brief Row-major index of the coefficient at a zigzag position
+ */
+static inline int zigzag_natural_index(int position) {
+    return zigzag_table[position][0] * DCT_BLOCK_SIZE + zigzag_table[position][1];
+}
+
+/**
+ * @brief Clamps a reconstructed sample to 0-255
+ */
+static inline unsigned char clamp_sample(int value) {
+    return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+/**
+ * @brief dct_2d on a flat array, same summation order
+ */
+static void fdct_matrix(const double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE], double data[BLOCK_AREA]) {
+    double temp[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            temp[i][j] = 0.0;
+            for (int k = 0; k < DCT_BLOCK_SIZE; k++) {
+                temp[i][j] += cosine_matrix[i][k] * data[k * DCT_BLOCK_SIZE + j];
+            }
+        }
+    }
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < DCT_BLOCK_SIZE; k++) {
+                sum += temp[i][k] * cosine_matrix[j][k];
+            }
+            data[i * DCT_BLOCK_SIZE + j] = sum;
+        }
+    }
+}
+
+/**
+ * @brief idct_2d on a flat array, same summation order and rounding
+ */
+static void idct_matrix(const double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE], double data[BLOCK_AREA]) {
+    double temp[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            temp[i][j] = 0.0;
+            for (int k = 0; k < DCT_BLOCK_SIZE; k++) {
+                temp[i][j] += cosine_matrix[k][i] * data[k * DCT_BLOCK_SIZE + j];
+            }
+        }
+    }
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < DCT_BLOCK_SIZE; k++) {
+                sum += (temp[i][k] * cosine_matrix[k][j]);
+            }
+            data[i * DCT_BLOCK_SIZE + j] = round(sum);
+        }
+    }
+}
+
+/**
+ * @brief Prepares the tables of the fused kernels for one component type
+ *
+ * @param kernel Kernel to initialize
+ * @param method DCT implementation to use
+ * @param factor Quality factor, as in quantize_block
+ * @param type LUMINANCE or CHROMINANCE
+ */
+void init_block_kernel(BlockKernel *kernel, DCTMethod method, double factor, QuantizationType type) {
+    int (*table)[DCT_BLOCK_SIZE] = type == LUMINANCE ? luminance_quantization_table : chrominance_quantization_table;
+    double aan_divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+    double aan_multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
+
+    kernel->method = method;
+    compute_cosine_matrix(kernel->cosine_matrix);
+    compute_aan_quantization_table(aan_divisors, factor, type);
+    compute_aan_dequantization_table(aan_multipliers, factor, type);
+    compute_int_quantization_table(kernel->int_divisors, factor, type);
+    init_quantizer(&kernel->quantizer, factor, type, method == DCT_METHOD_SIMD);
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            if (method == DCT_METHOD_MATRIX) {
+                kernel->divisors[i * DCT_BLOCK_SIZE + j] = table[i][j] * factor;
+                kernel->multipliers[i * DCT_BLOCK_SIZE + j] = table[i][j] * factor;
+            } else {
+                kernel->divisors[i * DCT_BLOCK_SIZE + j] = aan_divisors[i][j];
+                kernel->multipliers[i * DCT_BLOCK_SIZE + j] = aan_multipliers[i][j];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Level shift, DCT, quantization and zigzag scan of one block in one pass
+ *
+ * Produces the same coefficients as the staged level_shift / dct / quantize /
+ * zigzag_scan chain of the selected method, without any heap allocation. The
+ * integer and SIMD methods quantize with the division-free Quantizer.
+ *
+ * @param kernel Tables from init_block_kernel
+ * @param pixels Top-left sample of the 8x8 block
+ * @param stride Bytes between consecutive rows of pixels
+ * @param coefficients Output zigzag-ordered quantized coefficients
+ */
+void forward_block_kernel(const BlockKernel *kernel, const unsigned char *pixels, int stride,
+                          int16_t coefficients[BLOCK_AREA]) {
+    if (kernel->method == DCT_METHOD_INTEGER) {
+        int16_t data[BLOCK_AREA];
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++, pixels += stride) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                data[i * DCT_BLOCK_SIZE + j] = (int16_t) (pixels[j] - 128);
+            }
+        }
+        fdct_islow(data);
+        quantize_block_reciprocal(data, &kernel->quantizer, coefficients);
+        return;
+    }
+
+    if (kernel->method == DCT_METHOD_SIMD) {
+        float data[BLOCK_AREA];
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++, pixels += stride) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                data[i * DCT_BLOCK_SIZE + j] = (float) (pixels[j] - 128);
+            }
+        }
+        fdct_aan_simd(data);
+        quantize_float_block_reciprocal(data, &kernel->quantizer, coefficients);
+        return;
+    }
+
+    double data[BLOCK_AREA];
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++, pixels += stride) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            data[i * DCT_BLOCK_SIZE + j] = pixels[j] - 128.0;
+        }
+    }
+    if (kernel->method == DCT_METHOD_AAN) {
+        fdct_aan(data);
+    } else {
+        fdct_matrix(kernel->cosine_matrix, data);
+    }
+    for (int k = 0; k < BLOCK_AREA; k++) {
+        int n = zigzag_natural_index(k);
+        coefficients[k] = (int16_t) round(data[n] / kernel->divisors[n]);
+    }
+}
+
+/**
+ * @brief Inverse zigzag, dequantization, IDCT, level shift and clamping of one block in one pass
+ *
+ * Produces the same samples as the staged chain of the selected method,
+ * without any heap allocation.
+ *
+ * @param kernel Tables from init_block_kernel
+ * @param coefficients Zigzag-ordered quantized coefficients
+ * @param pixels Top-left sample of the destination 8x8 block
+ * @param stride Bytes between consecutive rows of pixels
+ */
+void inverse_block_kernel(const BlockKernel *kernel, const int16_t coefficients[BLOCK_AREA],
+                          unsigned char *pixels, int stride) {
+    if (kernel->method == DCT_METHOD_INTEGER) {
+        int16_t data[BLOCK_AREA];
+        for (int k = 0; k < BLOCK_AREA; k++) {
+            int n = zigzag_natural_index(k);
+            int32_t value = (int32_t) coefficients[k] * kernel->int_divisors[n];
+            data[n] = (int16_t)(value < INT16_MIN ? INT16_MIN : (value > INT16_MAX ? INT16_MAX : value));
+        }
+        idct_islow(data);
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++, pixels += stride) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                pixels[j] = clamp_sample(data[i * DCT_BLOCK_SIZE + j] + 128);
+            }
+        }
+        return;
+    }
+
+    if (kernel->method == DCT_METHOD_SIMD) {
+        float data[BLOCK_AREA];
+        for (int k = 0; k < BLOCK_AREA; k++) {
+            int n = zigzag_natural_index(k);
+            data[n] = (float) (coefficients[k] * kernel->multipliers[n]);
+        }
+        idct_aan_simd(data);
+        for (int i = 0; i < DCT_BLOCK_SIZE; i++, pixels += stride) {
+            for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+                pixels[j] = clamp_sample((int) round(data[i * DCT_BLOCK_SIZE + j]) + 128);
+            }
+        }
+        return;
+    }
+
+    double data[BLOCK_AREA];
+    for (int k = 0; k < BLOCK_AREA; k++) {
+        int n = zigzag_natural_index(k);
+        data[n] = coefficients[k] * kernel->multipliers[n];
+    }
+    if (kernel->method == DCT_METHOD_AAN) {
+        idct_aan(data);
+    } else {
+        idct_matrix(kernel->cosine_matrix, data);
+    }
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++, pixels += stride) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            pixels[j] = clamp_sample((int) round(data[i * DCT_BLOCK_SIZE + j]) + 128);
+        }
+    }
+}
@@ -0,0 +1,185 @@
+#if defined(unix) || defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define BOUNDED_QUEUE_POSIX 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bounded_queue.h"
+
+#ifdef BOUNDED_QUEUE_POSIX
+#include <sched.h>
+#endif
+
+/**
+ * @brief Gives up the processor while a queue is full or empty
+ */
+static void queue_backoff() {
+#ifdef BOUNDED_QUEUE_POSIX
+    sched_yield();
+#endif
+}
+
+/**
+ * @brief Initializes an empty queue
+ *
+ * Bounded multi-producer multi-consumer ring after D. Vyukov: each cell
+ * carries a sequence number, so producers and consumers claim positions
+ * with a single compare-and-swap. The lock is only there for threads that
+ * find the queue full or empty for longer than a short spin, so they can
+ * sleep on a condition variable instead of burning a core.
+ *
+ * @param queue Queue to initialize
+ * @param capacity Minimum number of entries, rounded up to a power of two
+ */
+void bounded_queue_init(BoundedQueue *queue, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    queue->cells = (QueueCell *)malloc(size * sizeof(QueueCell));
+    if (queue->cells == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < size; i++) {
+        queue->cells[i].sequence = i;
+        queue->cells[i].value = NULL;
+    }
+    queue->mask = size - 1;
+    queue->enqueue_position = 0;
+    queue->dequeue_position = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->sleeping_consumers = 0;
+    queue->sleeping_producers = 0;
+}
+
+/**
+ * @brief Releases the ring; entries still queued are not freed
+ */
+void bounded_queue_destroy(BoundedQueue *queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
+
+/**
+ * @brief Appends value unless the queue is full
+ *
+ * @return 1 if the value was queued, 0 if the queue is full
+ */
+int bounded_queue_try_push(BoundedQueue *queue, void *value) {
+    size_t position = __atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
+    for (;;) {
+        QueueCell *cell = &queue->cells[position & queue->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        ptrdiff_t difference = (ptrdiff_t) sequence - (ptrdiff_t) position;
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_position, &position, position + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->value = value;
+                __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            position = __atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Removes the oldest value unless the queue is empty
+ *
+ * @return 1 if *value was filled, 0 if the queue is empty
+ */
+int bounded_queue_try_pop(BoundedQueue *queue, void **value) {
+    size_t position = __atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+    for (;;) {
+        QueueCell *cell = &queue->cells[position & queue->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        ptrdiff_t difference = (ptrdiff_t) sequence - (ptrdiff_t) (position + 1);
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeue_position, &position, position + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *value = cell->value;
+                __atomic_store_n(&cell->sequence, position + queue->mask + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            position = __atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Wakes the threads sleeping on condition, if there are any
+ *
+ * The fence orders the caller's push or pop before the check of sleepers,
+ * matching the one a sleeper puts between counting itself and retrying, so
+ * either the sleeper sees the change or the caller sees the sleeper.
+ */
+static void queue_wake(BoundedQueue *queue, int *sleepers, pthread_cond_t *condition) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(sleepers, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(condition);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/**
+ * @brief Appends value, yielding while the queue is full, then sleeping until a pop makes room
+ */
+void bounded_queue_push(BoundedQueue *queue, void *value) {
+    for (int spin = 0; spin < QUEUE_SPIN_LIMIT; spin++) {
+        if (bounded_queue_try_push(queue, value)) {
+            queue_wake(queue, &queue->sleeping_consumers, &queue->not_empty);
+            return;
+        }
+        queue_backoff();
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    __atomic_add_fetch(&queue->sleeping_producers, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!bounded_queue_try_push(queue, value)) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    __atomic_sub_fetch(&queue->sleeping_producers, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->lock);
+    queue_wake(queue, &queue->sleeping_consumers, &queue->not_empty);
+}
+
+/**
+ * @brief Removes the oldest value, yielding while the queue is empty, then sleeping until a push
+ */
+void *bounded_queue_pop(BoundedQueue *queue) {
+    void *value;
+    for (int spin = 0; spin < QUEUE_SPIN_LIMIT; spin++) {
+        if (bounded_queue_try_pop(queue, &value)) {
+            queue_wake(queue, &queue->sleeping_producers, &queue->not_full);
+            return value;
+        }
+        queue_backoff();
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    __atomic_add_fetch(&queue->sleeping_consumers, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!bounded_queue_try_pop(queue, &value)) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    __atomic_sub_fetch(&queue->sleeping_consumers, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->lock);
+    queue_wake(queue, &queue->sleeping_producers, &queue->not_full);
+    return value;
+}
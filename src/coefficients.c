@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "coefficients.h"
+
+/**
+ * @brief Allocates a zeroed plane of coefficient blocks
+ *
+ * All blocks share one allocation, so walking the plane in raster order is a
+ * linear scan through memory.
+ *
+ * @param block_rows Number of block rows
+ * @param block_cols Number of block columns
+ * @return Initialized CoefficientPlane
+ */
+CoefficientPlane init_coefficient_plane(int block_rows, int block_cols) {
+    CoefficientPlane plane;
+    plane.block_rows = block_rows;
+    plane.block_cols = block_cols;
+
+    size_t count = (size_t) block_rows * block_cols * BLOCK_COEFFICIENTS;
+    plane.data = (int16_t *)calloc(count > 0 ? count : 1, sizeof(int16_t));
+    if (plane.data == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return plane;
+}
+
+/**
+ * @brief Frees the memory of a coefficient plane
+ *
+ * @param plane Pointer to the plane to free
+ */
+void free_coefficient_plane(CoefficientPlane *plane) {
+    free(plane->data);
+    plane->data = NULL;
+    plane->block_rows = 0;
+    plane->block_cols = 0;
+}
+
+/**
+ * @brief Allocates the coefficient planes of a 4:2:0 image
+ *
+ * @param y_block_rows Number of rows for Y blocks
+ * @param y_block_cols Number of columns for Y blocks
+ * @param c_block_rows Number of rows for Cb/Cr blocks
+ * @param c_block_cols Number of columns for Cb/Cr blocks
+ * @return Initialized CoefficientBuffer, one allocation per component
+ */
+CoefficientBuffer init_coefficient_buffer(int y_block_rows, int y_block_cols, int c_block_rows, int c_block_cols) {
+    CoefficientBuffer buffer;
+    buffer.y = init_coefficient_plane(y_block_rows, y_block_cols);
+    buffer.cb = init_coefficient_plane(c_block_rows, c_block_cols);
+    buffer.cr = init_coefficient_plane(c_block_rows, c_block_cols);
+
+    return buffer;
+}
+
+/**
+ * @brief Frees the memory allocated for a CoefficientBuffer
+ *
+ * @param buffer Pointer to the buffer to free
+ */
+void free_coefficient_buffer(CoefficientBuffer *buffer) {
+    free_coefficient_plane(&buffer->y);
+    free_coefficient_plane(&buffer->cb);
+    free_coefficient_plane(&buffer->cr);
+}
+
+/**
+ * @brief Copies an 8x8 block of samples out of an image channel
+ *
+ * @param image Channel data
+ * @param yoffset Y offset in the image
+ * @param xoffset X offset in the image
+ * @param samples Output row-major block of samples (0-255, not level shifted)
+ */
+void load_block_samples(unsigned char **image, int yoffset, int xoffset, int16_t samples[BLOCK_COEFFICIENTS]) {
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        const unsigned char *row = image[yoffset + i] + xoffset;
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            samples[i * DCT_BLOCK_SIZE + j] = row[j];
+        }
+    }
+}
+
+/**
+ * @brief Writes an 8x8 block of samples into an image channel, clamped to 0-255
+ *
+ * @param samples Row-major block of samples
+ * @param image Channel data
+ * @param yoffset Y offset in the image
+ * @param xoffset X offset in the image
+ */
+void store_block_samples(const int16_t samples[BLOCK_COEFFICIENTS], unsigned char **image, int yoffset, int xoffset) {
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        unsigned char *row = image[yoffset + i] + xoffset;
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            int value = samples[i * DCT_BLOCK_SIZE + j];
+            row[j] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+}
+
+/**
+ * @brief Copies an 8x8 block of samples out of an image plane
+ *
+ * @param plane Source plane
+ * @param yoffset Y offset in the plane
+ * @param xoffset X offset in the plane
+ * @param samples Output row-major block of samples (0-255, not level shifted)
+ */
+void load_plane_block_samples(const ImagePlane *plane, int yoffset, int xoffset, int16_t samples[BLOCK_COEFFICIENTS]) {
+    const unsigned char *row = image_plane_row(plane, yoffset) + xoffset;
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++, row += plane->stride) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            samples[i * DCT_BLOCK_SIZE + j] = row[j];
+        }
+    }
+}
+
+/**
+ * @brief Writes an 8x8 block of samples into an image plane, clamped to 0-255
+ *
+ * @param samples Row-major block of samples
+ * @param plane Destination plane
+ * @param yoffset Y offset in the plane
+ * @param xoffset X offset in the plane
+ */
+void store_plane_block_samples(const int16_t samples[BLOCK_COEFFICIENTS], ImagePlane *plane, int yoffset, int xoffset) {
+    unsigned char *row = image_plane_row(plane, yoffset) + xoffset;
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++, row += plane->stride) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            int value = samples[i * DCT_BLOCK_SIZE + j];
+            row[j] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+}
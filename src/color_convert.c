@@ -3,6 +3,7 @@
 #include "bitmap.h"
 #include "color_convert.h"
 #include "heap_manager.h"
+#include "planar_image.h"
 
 /**
  * @brief Initializes an RGB_Image structure
@@ -90,17 +91,46 @@ void read_rgb_image(RGB_Image *rgb_image, FILE *fp, BITMAPFILEHEADER file_header
     rgb_image->b = init_uchar_matrix(height, width);
     
     fseek(fp, file_header.OffBits, SEEK_SET); // Skip the header
-    
+
+    // One fread per stored row, padding included, then split BGR into the planes
+    int row_stride = bmp_row_stride(width);
+    unsigned char *row = (unsigned char *)malloc(row_stride > 0 ? row_stride : 1);
+    if (row == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int truncated = 0;
     for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            rgb_image->b[i][j] = fgetc(fp);
-            rgb_image->g[i][j] = fgetc(fp);
-            rgb_image->r[i][j] = fgetc(fp);
-        }
+        truncated |= read_bmp_rows(fp, row, row_stride, 1);
+        deinterleave_bgr_row(row, rgb_image->r[i], rgb_image->g[i], rgb_image->b[i], width);
     }
+    if (truncated) {
+        fprintf(stderr, "Warning: bitmap pixel data is truncated\n");
+    }
+
+    free(row);
 }
 
 
+/**
+ * @brief Converts one pixel from RGB to YCbCr, truncating and clamping to 0-255
+ */
+static inline void rgb_pixel_to_ycbcr(unsigned char red, unsigned char green, unsigned char blue,
+                                      unsigned char *y_out, unsigned char *cb_out, unsigned char *cr_out) {
+    double r = (double)red;
+    double g = (double)green;
+    double b = (double)blue;
+
+    double y = 0.299*r + 0.587*g + 0.114*b;
+    double cb = 128 - 0.168736*r - 0.331264*g + 0.5*b;
+    double cr = 128 + 0.5*r - 0.418688*g - 0.081312*b;
+
+    *y_out = (unsigned char)(y < 0 ? 0 : (y > 255 ? 255 : y));
+    *cb_out = (unsigned char)(cb < 0 ? 0 : (cb > 255 ? 255 : cb));
+    *cr_out = (unsigned char)(cr < 0 ? 0 : (cr > 255 ? 255 : cr));
+}
+
 /**
  * @brief Converts an RGB_Image to YCbCr color space
  *
@@ -132,19 +162,124 @@ void rgb_to_ycbcr(YCbCr_Image *ycbcr_image, RGB_Image rgb_image) {
     
     for (int i = 0; i < height; i++) {
         for (int j = 0; j < width; j++) {
-            double r = (double)rgb_image.r[i][j];
-            double g = (double)rgb_image.g[i][j];
-            double b = (double)rgb_image.b[i][j];
+            rgb_pixel_to_ycbcr(rgb_image.r[i][j], rgb_image.g[i][j], rgb_image.b[i][j],
+                               &ycbcr_image->y[i][j], &ycbcr_image->cb[i][j], &ycbcr_image->cr[i][j]);
+        }
+    }
+}
 
-            double y = 0.299*r + 0.587*g + 0.114*b;
-            double cb = 128 - 0.168736*r - 0.331264*g + 0.5*b;
-            double cr = 128 + 0.5*r - 0.418688*g - 0.081312*b;
+/**
+ * @brief Converts one row of interleaved BGR bytes to Y, Cb and Cr samples
+ *
+ * Same arithmetic as rgb_to_ycbcr.
+ *
+ * @param bgr Input row, 3 * width bytes in B, G, R order
+ * @param y Output luminance samples
+ * @param cb Output blue-difference samples
+ * @param cr Output red-difference samples
+ * @param width Number of pixels
+ */
+void bgr_row_to_ycbcr(const unsigned char *bgr, unsigned char *y, unsigned char *cb, unsigned char *cr, int width) {
+    for (int j = 0; j < width; j++) {
+        rgb_pixel_to_ycbcr(bgr[3 * j + 2], bgr[3 * j + 1], bgr[3 * j], &y[j], &cb[j], &cr[j]);
+    }
+}
 
-            ycbcr_image->y[i][j] = (unsigned char)(y < 0 ? 0 : (y > 255 ? 255 : y));
-            ycbcr_image->cb[i][j] = (unsigned char)(cb < 0 ? 0 : (cb > 255 ? 255 : cb));
-            ycbcr_image->cr[i][j] = (unsigned char)(cr < 0 ? 0 : (cr > 255 ? 255 : cr));
-        }
+/**
+ * @brief Converts interleaved BGR rows straight to YCbCr
+ *
+ * Same arithmetic as rgb_to_ycbcr, but reads the pixels where they are
+ * (e.g. a memory-mapped bitmap) instead of going through an RGB_Image.
+ *
+ * @param ycbcr_image Pointer to YCbCr_Image structure to store the result
+ * @param pixels First stored row, 3 bytes per pixel in B, G, R order
+ * @param row_stride Bytes between consecutive rows, padding included
+ * @param height Number of rows
+ * @param width Number of pixels per row
+ */
+void bgr_rows_to_ycbcr(YCbCr_Image *ycbcr_image, const unsigned char *pixels, int row_stride, int height, int width) {
+    // Free any previously allocated memory if height and width are not 0
+    if (ycbcr_image->height != 0 && ycbcr_image->width != 0) {
+        free_ycbcr_image(ycbcr_image);
+    }
+
+    ycbcr_image->height = height;
+    ycbcr_image->width = width;
+
+    ycbcr_image->y = init_uchar_matrix(height, width);
+    ycbcr_image->cb = init_uchar_matrix(height, width);
+    ycbcr_image->cr = init_uchar_matrix(height, width);
+
+    for (int i = 0; i < height; i++) {
+        bgr_row_to_ycbcr(pixels + (size_t) i * row_stride, ycbcr_image->y[i], ycbcr_image->cb[i], ycbcr_image->cr[i], width);
+    }
+}
+
+/**
+ * @brief Fixed-point counterpart of bgr_rows_to_ycbcr
+ *
+ * Each row goes through bgr_row_to_ycbcr_fixed, so the result is bit-exact
+ * to its documented integer reference whichever SIMD kernel runs.
+ *
+ * @param ycbcr_image Pointer to YCbCr_Image structure to store the result
+ * @param pixels First stored row, 3 bytes per pixel in B, G, R order
+ * @param row_stride Bytes between consecutive rows, padding included
+ * @param height Number of rows
+ * @param width Number of pixels per row
+ */
+void bgr_rows_to_ycbcr_fixed(YCbCr_Image *ycbcr_image, const unsigned char *pixels, int row_stride, int height, int width) {
+    // Free any previously allocated memory if height and width are not 0
+    if (ycbcr_image->height != 0 && ycbcr_image->width != 0) {
+        free_ycbcr_image(ycbcr_image);
+    }
+
+    ycbcr_image->height = height;
+    ycbcr_image->width = width;
+
+    ycbcr_image->y = init_uchar_matrix(height, width);
+    ycbcr_image->cb = init_uchar_matrix(height, width);
+    ycbcr_image->cr = init_uchar_matrix(height, width);
+
+    for (int i = 0; i < height; i++) {
+        bgr_row_to_ycbcr_fixed(pixels + (size_t) i * row_stride,
+                               ycbcr_image->y[i], ycbcr_image->cb[i], ycbcr_image->cr[i], width);
+    }
+}
+
+/**
+ * @brief Fixed-point counterpart of rgb_to_ycbcr
+ *
+ * Planar input is re-interleaved one row at a time into a scratch buffer
+ * and converted with bgr_row_to_ycbcr_fixed.
+ *
+ * @param ycbcr_image Pointer to YCbCr_Image structure to store the result
+ * @param rgb_image Source RGB_Image
+ */
+void rgb_to_ycbcr_fixed(YCbCr_Image *ycbcr_image, RGB_Image rgb_image) {
+    unsigned char *bgr = (unsigned char *)malloc((size_t) rgb_image.width * 3);
+    if (bgr == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
     }
+
+    // Free any previously allocated memory if height and width are not 0
+    if (ycbcr_image->height != 0 && ycbcr_image->width != 0) {
+        free_ycbcr_image(ycbcr_image);
+    }
+
+    ycbcr_image->height = rgb_image.height;
+    ycbcr_image->width = rgb_image.width;
+
+    ycbcr_image->y = init_uchar_matrix(rgb_image.height, rgb_image.width);
+    ycbcr_image->cb = init_uchar_matrix(rgb_image.height, rgb_image.width);
+    ycbcr_image->cr = init_uchar_matrix(rgb_image.height, rgb_image.width);
+
+    for (int i = 0; i < rgb_image.height; i++) {
+        interleave_bgr_row(rgb_image.r[i], rgb_image.g[i], rgb_image.b[i], bgr, rgb_image.width);
+        bgr_row_to_ycbcr_fixed(bgr, ycbcr_image->y[i], ycbcr_image->cb[i], ycbcr_image->cr[i], rgb_image.width);
+    }
+
+    free(bgr);
 }
 
 /**
@@ -192,6 +327,29 @@ void ycbcr_to_rgb(RGB_Image *rgb_image, YCbCr_Image ycbcr_image) {
     }
 }
 
+/**
+ * @brief Writes both BMP headers and zero padding up to the original pixel offset
+ *
+ * The dimensions and sizes are those of the width x height rows that follow,
+ * which can be smaller than the original when it was not a whole number of blocks.
+ */
+static void write_bmp_preamble(FILE *fp, const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header,
+                               int width, int height) {
+    BITMAPFILEHEADER written_file_header = *file_header;
+    BITMAPINFOHEADER written_info_header = *info_header;
+    set_bmp_dimensions(&written_file_header, &written_info_header, width, height);
+
+    // Both headers in one write, then zeros up to the original pixel offset
+    unsigned char headers[BMP_HEADERS_SIZE];
+    serialize_bmp_headers(headers, &written_file_header, &written_info_header);
+    fwrite(headers, 1, BMP_HEADERS_SIZE, fp);
+
+    int padding_needed = (int) file_header->OffBits - BMP_HEADERS_SIZE;
+    for (int i = 0; i < padding_needed; i++) {
+        fputc(0, fp);
+    }
+}
+
 /**
  * @brief Saves an RGB_Image to a BMP file
  *
@@ -211,50 +369,26 @@ int save_rgb_image(const char *filename, RGB_Image rgb_image, BITMAPFILEHEADER *
         return -1;
     }
 
-    // Write file header
-    fwrite(&(original_file_header->Type), sizeof(unsigned short), 1, fp);
-    fwrite(&(original_file_header->Size), sizeof(unsigned int), 1, fp);
-    fwrite(&(original_file_header->Reserved1), sizeof(unsigned short), 1, fp);
-    fwrite(&(original_file_header->Reserved2), sizeof(unsigned short), 1, fp);
-    fwrite(&(original_file_header->OffBits), sizeof(unsigned int), 1, fp);
-
-    // Write info header
-    fwrite(&(original_info_header->Size), sizeof(unsigned int), 1, fp);
-    fwrite(&(original_info_header->Width), sizeof(int), 1, fp);
-    fwrite(&(original_info_header->Height), sizeof(int), 1, fp);
-    fwrite(&(original_info_header->Planes), sizeof(unsigned short int), 1, fp);
-    fwrite(&(original_info_header->BitCount), sizeof(unsigned short int), 1, fp);
-    fwrite(&(original_info_header->Compression), sizeof(unsigned int), 1, fp);
-    fwrite(&(original_info_header->SizeImage), sizeof(unsigned int), 1, fp);
-    fwrite(&(original_info_header->XResolution), sizeof(int), 1, fp);
-    fwrite(&(original_info_header->YResolution), sizeof(int), 1, fp);
-    fwrite(&(original_info_header->NColors), sizeof(unsigned int), 1, fp);
-    fwrite(&(original_info_header->ImportantColors), sizeof(unsigned int), 1, fp);
-
-    // Standard headers total 54 bytes. If original offset is larger, add padding
-    int current_pos = ftell(fp);
-    int padding_needed = original_file_header->OffBits - current_pos;
-    
-    // Add any additional header data/padding to match original offset
-    if (padding_needed > 0) {
-        unsigned char padding = 0;
-        for (int i = 0; i < padding_needed; i++) {
-            fwrite(&padding, 1, 1, fp);
-        }
-    }
-
     int height = rgb_image.height;
     int width = rgb_image.width;
 
-    // Write pixel data
-    for (int i = 0; i < (int) height; i++) {
-        for (int j = 0; j < (int) width; j++) {
-            fputc(rgb_image.b[i][j], fp);
-            fputc(rgb_image.g[i][j], fp);
-            fputc(rgb_image.r[i][j], fp);
-        }
+    write_bmp_preamble(fp, original_file_header, original_info_header, width, height);
+
+    // Write pixel data a whole row at a time, padded to 4 bytes
+    int row_stride = bmp_row_stride(width);
+    unsigned char *row = (unsigned char *)calloc(row_stride > 0 ? row_stride : 1, 1);
+    if (row == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        fclose(fp);
+        return -1;
     }
 
+    for (int i = 0; i < height; i++) {
+        interleave_bgr_row(rgb_image.r[i], rgb_image.g[i], rgb_image.b[i], row, width);
+        fwrite(row, 1, (size_t) row_stride, fp);
+    }
+
+    free(row);
     fclose(fp);
     return 0;
 }
@@ -301,9 +435,9 @@ void ycbcr_subsampling_420(YCbCr_Image_420 *ycbcr_image_420, YCbCr_Image ycbcr_i
         }
     }
     
-    // Subsample chrominance (Cb, Cr) values
-    for (int i = 0; i < luminance_height; i += 2) {
-        for (int j = 0; j < luminance_width; j += 2) {
+    // Subsample chrominance (Cb, Cr) values; an odd last row or column has no 2x2 block and is left to the padding
+    for (int i = 0; i < luminance_height / 2 * 2; i += 2) {
+        for (int j = 0; j < luminance_width / 2 * 2; j += 2) {
             // Average the chrominance values in 2x2 blocks
             unsigned char cb_avg = (ycbcr_image.cb[i][j] + ycbcr_image.cb[i][j+1] + 
                                    ycbcr_image.cb[i+1][j] + ycbcr_image.cb[i+1][j+1]) >> 2;
@@ -338,6 +472,199 @@ void ycbcr_subsampling_420(YCbCr_Image_420 *ycbcr_image_420, YCbCr_Image ycbcr_i
     }
 }
 
+/**
+ * @brief Source of full-resolution YCbCr rows for the fused 4:2:0 pass
+ */
+typedef struct {
+    const unsigned char *pixels; // Interleaved BGR rows, or NULL to read rgb_image
+    int row_stride;
+    RGB_Image rgb_image;
+    unsigned char *bgr;          // Scratch row for the fixed-point RGB_Image path
+    int fixed_point;
+} ColorRowSource;
+
+/**
+ * @brief Converts source row i into one row each of Y, Cb and Cr
+ */
+static void convert_source_row(ColorRowSource *source, int i, int width,
+                               unsigned char *y, unsigned char *cb, unsigned char *cr) {
+    const unsigned char *bgr = NULL;
+    if (source->pixels != NULL) {
+        bgr = source->pixels + (size_t) i * source->row_stride;
+    } else if (source->fixed_point) {
+        interleave_bgr_row(source->rgb_image.r[i], source->rgb_image.g[i], source->rgb_image.b[i], source->bgr, width);
+        bgr = source->bgr;
+    }
+
+    if (source->fixed_point) {
+        bgr_row_to_ycbcr_fixed(bgr, y, cb, cr, width);
+    } else if (bgr != NULL) {
+        bgr_row_to_ycbcr(bgr, y, cb, cr, width);
+    } else {
+        for (int j = 0; j < width; j++) {
+            rgb_pixel_to_ycbcr(source->rgb_image.r[i][j], source->rgb_image.g[i][j], source->rgb_image.b[i][j],
+                               &y[j], &cb[j], &cr[j]);
+        }
+    }
+}
+
+/**
+ * @brief Produces chroma row c of the padded 4:2:0 planes from full-resolution chroma
+ *
+ * Rows under height / 2 average each 2x2 block of full-resolution rows 2c
+ * and 2c + 1, then repeat edges[c], the last sample of full-resolution row
+ * c, up to chroma_width. The rows past them are bottom padding and replicate
+ * the last full-resolution row, its last sample included. These are the
+ * samples of ycbcr_subsampling_420, for the encoders that subsample a few
+ * rows at a time.
+ *
+ * @param row0 Full-resolution row 2c, or the last row for bottom padding
+ * @param row1 Full-resolution row 2c + 1, unused for bottom padding
+ * @param c Chroma row to produce
+ * @param height Number of full-resolution rows
+ * @param width Number of full-resolution samples per row
+ * @param edges Right padding of every chroma row under height / 2, unused if chroma_width is width / 2
+ * @param out Output samples
+ * @param chroma_width Padded chroma width
+ */
+void subsample_chroma_row(const unsigned char *row0, const unsigned char *row1, int c, int height, int width,
+                          const unsigned char *edges, unsigned char *out, int chroma_width) {
+    if (c >= height / 2) {
+        for (int j = 0; j < width / 2; j++) {
+            out[j] = row0[j];
+        }
+        for (int j = width / 2; j < chroma_width; j++) {
+            out[j] = row0[width - 1];
+        }
+        return;
+    }
+    for (int j = 0; j < width / 2; j++) {
+        out[j] = (row0[2 * j] + row0[2 * j + 1] + row1[2 * j] + row1[2 * j + 1]) >> 2;
+    }
+    for (int j = width / 2; j < chroma_width; j++) {
+        out[j] = edges[c];
+    }
+}
+
+/**
+ * @brief Color conversion and 4:2:0 subsampling in a single pass over the source
+ *
+ * Rows are converted two at a time: Y goes straight into the output plane,
+ * Cb and Cr into two scratch rows that are averaged into one chroma row. The
+ * chroma padding replicates the same full-resolution samples
+ * ycbcr_subsampling_420 uses, so the result is identical to converting and
+ * then subsampling.
+ */
+static void convert_subsample_420(PlanarImage *image, ColorRowSource *source, int height, int width) {
+    int chrominance_height = (height / 2) + (height / 2) % 8;
+    int chrominance_width = (width / 2) + (width / 2) % 8;
+
+    image->planes[0] = init_image_plane(height, width);
+    image->planes[1] = init_image_plane(chrominance_height, chrominance_width);
+    image->planes[2] = init_image_plane(chrominance_height, chrominance_width);
+    ImagePlane *y_plane = &image->planes[0];
+    ImagePlane *cb_plane = &image->planes[1];
+    ImagePlane *cr_plane = &image->planes[2];
+
+    // Full-resolution chroma for the current pair of rows only, and the last sample of the rows under height / 2
+    unsigned char **cb_rows = init_uchar_matrix(2, width);
+    unsigned char **cr_rows = init_uchar_matrix(2, width);
+    unsigned char *cb_edges = (unsigned char *)malloc((size_t) (height / 2) + 1);
+    unsigned char *cr_edges = (unsigned char *)malloc((size_t) (height / 2) + 1);
+    if (cb_edges == NULL || cr_edges == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < height; i++) {
+        unsigned char *cb = cb_rows[i % 2];
+        unsigned char *cr = cr_rows[i % 2];
+        convert_source_row(source, i, width, image_plane_row(y_plane, i), cb, cr);
+        if (i < height / 2) {
+            cb_edges[i] = cb[width - 1];
+            cr_edges[i] = cr[width - 1];
+        }
+
+        // Each pair of rows gives one chroma row, the last row all of the bottom padding
+        if (i % 2 == 1) {
+            subsample_chroma_row(cb_rows[0], cb_rows[1], i / 2, height, width, cb_edges,
+                                 image_plane_row(cb_plane, i / 2), chrominance_width);
+            subsample_chroma_row(cr_rows[0], cr_rows[1], i / 2, height, width, cr_edges,
+                                 image_plane_row(cr_plane, i / 2), chrominance_width);
+        }
+        if (i == height - 1) {
+            for (int k = height / 2; k < chrominance_height; k++) {
+                subsample_chroma_row(cb, NULL, k, height, width, cb_edges, image_plane_row(cb_plane, k),
+                                     chrominance_width);
+                subsample_chroma_row(cr, NULL, k, height, width, cr_edges, image_plane_row(cr_plane, k),
+                                     chrominance_width);
+            }
+        }
+    }
+
+    free_uchar_matrix(cb_rows, 2);
+    free_uchar_matrix(cr_rows, 2);
+    free(cb_edges);
+    free(cr_edges);
+}
+
+/**
+ * @brief Converts interleaved BGR rows to 4:2:0 YCbCr planes in one pass
+ *
+ * Produces the same samples as bgr_rows_to_ycbcr (or bgr_rows_to_ycbcr_fixed)
+ * followed by ycbcr_subsampling_420, written straight into the aligned planes
+ * the fused kernels read, without the full-resolution YCbCr_Image or any
+ * row-allocated matrix in between.
+ *
+ * @param image Receives newly allocated Y, Cb and Cr planes, freed with free_planar_image
+ * @param pixels First stored row, 3 bytes per pixel in B, G, R order
+ * @param row_stride Bytes between consecutive rows, padding included
+ * @param height Number of rows
+ * @param width Number of pixels per row
+ * @param fixed_point Nonzero to use the fixed-point conversion
+ */
+void bgr_rows_to_ycbcr_420(PlanarImage *image, const unsigned char *pixels, int row_stride,
+                           int height, int width, int fixed_point) {
+    ColorRowSource source;
+    source.pixels = pixels;
+    source.row_stride = row_stride;
+    source.rgb_image = init_rgb_image();
+    source.bgr = NULL;
+    source.fixed_point = fixed_point;
+
+    convert_subsample_420(image, &source, height, width);
+}
+
+/**
+ * @brief Converts an RGB_Image to 4:2:0 YCbCr planes in one pass
+ *
+ * Produces the same samples as rgb_to_ycbcr (or rgb_to_ycbcr_fixed) followed
+ * by ycbcr_subsampling_420 without the full-resolution intermediate.
+ *
+ * @param image Receives newly allocated Y, Cb and Cr planes, freed with free_planar_image
+ * @param rgb_image Source RGB_Image
+ * @param fixed_point Nonzero to use the fixed-point conversion
+ */
+void rgb_to_ycbcr_420(PlanarImage *image, RGB_Image rgb_image, int fixed_point) {
+    ColorRowSource source;
+    source.pixels = NULL;
+    source.row_stride = 0;
+    source.rgb_image = rgb_image;
+    source.bgr = NULL;
+    source.fixed_point = fixed_point;
+    if (fixed_point) {
+        source.bgr = (unsigned char *)malloc((size_t) rgb_image.width * 3);
+        if (source.bgr == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    convert_subsample_420(image, &source, rgb_image.height, rgb_image.width);
+
+    free(source.bgr);
+}
+
 /**
  * @brief Performs an upsampling of a YCbCr image from 4:2:0 to full resolution
  *
@@ -398,6 +725,114 @@ void ycbcr_upsampling_420(YCbCr_Image *ycbcr_image, YCbCr_Image_420 ycbcr_image_
     }
 }
 
+/**
+ * @brief Upsamples one row of a 4:2:0 chroma plane to full width
+ *
+ * Without fancy_upsampling each sample of near is duplicated, as in
+ * ycbcr_upsampling_420. With it, the triangle filter weighs the nearer chroma
+ * sample 3/4 and the farther one 1/4, both vertically (near against far) and
+ * horizontally (libjpeg's "fancy" h2v2 upsampling). Columns past
+ * chroma_width repeat the edge.
+ *
+ * @param near Chroma row nearest to the output row
+ * @param far Chroma row on the other side of the output row (may equal near at the edges)
+ * @param chroma_width Number of chroma samples carrying image data
+ * @param out Output samples
+ * @param width Number of output samples
+ * @param fancy_upsampling Nonzero for the triangle filter
+ */
+void upsample_chroma_row(const unsigned char *near, const unsigned char *far, int chroma_width,
+                         unsigned char *out, int width, int fancy_upsampling) {
+    if (!fancy_upsampling) {
+        for (int j = 0; j < width; j++) {
+            out[j] = near[j / 2 < chroma_width - 1 ? j / 2 : chroma_width - 1];
+        }
+        return;
+    }
+
+    for (int j = 0; j < width; j++) {
+        int col = j / 2;
+        int side = (j % 2) ? col + 1 : col - 1;
+        if (side < 0) side = 0;
+        if (side > chroma_width - 1) side = chroma_width - 1;
+        if (col > chroma_width - 1) col = chroma_width - 1;
+
+        int near_sum = 3 * near[col] + far[col];
+        int side_sum = 3 * near[side] + far[side];
+        // Alternate the rounding bias so halves do not all round the same way
+        out[j] = (unsigned char) ((3 * near_sum + side_sum + ((j % 2) ? 7 : 8)) >> 4);
+    }
+}
+
+/**
+ * @brief Writes decoded 4:2:0 planes straight to a BMP file
+ *
+ * Chroma is upsampled, converted and interleaved one output row at a time,
+ * reading the aligned planes the fused kernels decode into, so neither a
+ * row-allocated copy, the full-resolution YCbCr_Image nor the RGB_Image is
+ * built.
+ * With fancy_upsampling 0 the chroma is duplicated like ycbcr_upsampling_420
+ * and the file is byte-identical to ycbcr_upsampling_420, ycbcr_to_rgb and
+ * save_rgb_image in sequence; otherwise the triangle filter is used.
+ *
+ * @param filename Path to the output file
+ * @param image Decoded Y plane and half-size Cb and Cr planes
+ * @param fancy_upsampling Nonzero for triangle-filter chroma upsampling
+ * @param original_file_header Pointer to the original BMP file header to be copied
+ * @param original_info_header Pointer to the original BMP info header to be copied
+ * @return 0 on success, -1 on failure
+ */
+int save_ycbcr_image_420(const char *filename, const PlanarImage *image, int fancy_upsampling,
+                         BITMAPFILEHEADER *original_file_header, BITMAPINFOHEADER *original_info_header) {
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        printf("Error opening file for writing: %s\n", filename);
+        return -1;
+    }
+
+    const ImagePlane *y_plane = &image->planes[0];
+    const ImagePlane *cb_plane = &image->planes[1];
+    const ImagePlane *cr_plane = &image->planes[2];
+    int height = y_plane->height;
+    int width = y_plane->width;
+
+    write_bmp_preamble(fp, original_file_header, original_info_header, width, height);
+    // Chroma rows and columns that carry image data rather than block padding
+    int chroma_rows = (height + 1) / 2 < cb_plane->height ? (height + 1) / 2 : cb_plane->height;
+    int chroma_cols = (width + 1) / 2 < cb_plane->width ? (width + 1) / 2 : cb_plane->width;
+
+    // Full-width chroma and RGB scratch for a single row, then the padded output row
+    int row_stride = bmp_row_stride(width);
+    unsigned char **scratch = init_uchar_matrix(5, width > 0 ? width : 1);
+    unsigned char *row = (unsigned char *)calloc(row_stride > 0 ? row_stride : 1, 1);
+    if (row == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned char *cb = scratch[0], *cr = scratch[1];
+    unsigned char *r = scratch[2], *g = scratch[3], *b = scratch[4];
+
+    for (int i = 0; i < height; i++) {
+        int chroma_row = i / 2 < chroma_rows - 1 ? i / 2 : chroma_rows - 1;
+        int far_row = (i % 2) ? i / 2 + 1 : i / 2 - 1;
+        if (far_row < 0) far_row = 0;
+        if (far_row > chroma_rows - 1) far_row = chroma_rows - 1;
+        upsample_chroma_row(image_plane_row(cb_plane, chroma_row), image_plane_row(cb_plane, far_row), chroma_cols,
+                            cb, width, fancy_upsampling);
+        upsample_chroma_row(image_plane_row(cr_plane, chroma_row), image_plane_row(cr_plane, far_row), chroma_cols,
+                            cr, width, fancy_upsampling);
+
+        ycbcr_row_to_rgb(image_plane_row(y_plane, i), cb, cr, r, g, b, width);
+        interleave_bgr_row(r, g, b, row, width);
+        fwrite(row, 1, (size_t) row_stride, fp);
+    }
+
+    free(row);
+    free_uchar_matrix(scratch, 5);
+    fclose(fp);
+    return 0;
+}
+
 /**
  * @brief Frees the memory allocated for an RGB_Image
  *
@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_convert.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*DeinterleaveRow)(const unsigned char *bgr, unsigned char *r, unsigned char *g, unsigned char *b, int width);
+typedef void (*InterleaveRow)(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *bgr, int width);
+typedef void (*RGBRow)(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                       unsigned char *r, unsigned char *g, unsigned char *b, int width);
+typedef void (*YCbCrRow)(const unsigned char *bgr, unsigned char *y, unsigned char *cb, unsigned char *cr, int width);
+
+/*
+ * JFIF coefficients in 2.14 fixed point, each rounded to nearest. Every row
+ * of the matrix sums to exactly 1 << 14 (Y) or 0 (Cb, Cr), so with the
+ * biases below results always land in 0-255 and no clamping is needed.
+ * All multipliers fit in a signed 16-bit word for pmaddwd.
+ */
+#define YCC_FIXED_BITS 14
+#define FIX_Y_R 4899        // 0.299
+#define FIX_Y_G 9617        // 0.587
+#define FIX_Y_B 1868        // 0.114
+#define FIX_CB_R (-2765)    // -0.168736
+#define FIX_CB_G (-5427)    // -0.331264
+#define FIX_CB_B 8192       // 0.5
+#define FIX_CR_R 8192       // 0.5
+#define FIX_CR_G (-6860)    // -0.418688
+#define FIX_CR_B (-1332)    // -0.081312
+#define FIX_Y_BIAS (1 << (YCC_FIXED_BITS - 1))
+// One half minus one, as libjpeg does, keeps the 255.5 corner case at 255
+#define FIX_CHROMA_BIAS ((128 << YCC_FIXED_BITS) + (1 << (YCC_FIXED_BITS - 1)) - 1)
+// Two signed 16-bit multipliers packed into one 32-bit pmaddwd operand
+#define WORD_PAIR(lo, hi) ((int) (((unsigned) (unsigned short) (hi) << 16) | (unsigned short) (lo)))
+
+/**
+ * @brief Portable BGR to planar split, also handles the SIMD tails
+ */
+static void deinterleave_bgr_row_scalar(const unsigned char *bgr, unsigned char *r, unsigned char *g,
+                                        unsigned char *b, int width) {
+    for (int j = 0; j < width; j++) {
+        b[j] = bgr[3 * j];
+        g[j] = bgr[3 * j + 1];
+        r[j] = bgr[3 * j + 2];
+    }
+}
+
+/**
+ * @brief Portable planar to BGR merge, also handles the SIMD tails
+ */
+static void interleave_bgr_row_scalar(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                      unsigned char *bgr, int width) {
+    for (int j = 0; j < width; j++) {
+        bgr[3 * j] = b[j];
+        bgr[3 * j + 1] = g[j];
+        bgr[3 * j + 2] = r[j];
+    }
+}
+
+/**
+ * @brief Fixed-point reference conversion; the SIMD kernels match it bit for bit
+ */
+static void bgr_row_to_ycbcr_fixed_scalar(const unsigned char *bgr, unsigned char *y, unsigned char *cb,
+                                          unsigned char *cr, int width) {
+    for (int j = 0; j < width; j++) {
+        int b = bgr[3 * j];
+        int g = bgr[3 * j + 1];
+        int r = bgr[3 * j + 2];
+
+        y[j] = (unsigned char) ((FIX_Y_R * r + FIX_Y_G * g + FIX_Y_B * b + FIX_Y_BIAS) >> YCC_FIXED_BITS);
+        cb[j] = (unsigned char) ((FIX_CB_R * r + FIX_CB_G * g + FIX_CB_B * b + FIX_CHROMA_BIAS) >> YCC_FIXED_BITS);
+        cr[j] = (unsigned char) ((FIX_CR_R * r + FIX_CR_G * g + FIX_CR_B * b + FIX_CHROMA_BIAS) >> YCC_FIXED_BITS);
+    }
+}
+
+/**
+ * @brief Reference YCbCr to RGB row conversion, the same arithmetic as ycbcr_to_rgb
+ */
+static void ycbcr_row_to_rgb_scalar(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                                    unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    for (int j = 0; j < width; j++) {
+        double luma = (double)y[j];
+        double blue_diff = (double)cb[j] - 128;
+        double red_diff = (double)cr[j] - 128;
+
+        double red = luma + 1.402*red_diff;
+        double green = luma - 0.344136*blue_diff - 0.714136*red_diff;
+        double blue = luma + 1.772*blue_diff;
+
+        r[j] = (unsigned char)(red < 0 ? 0 : (red > 255 ? 255 : red));
+        g[j] = (unsigned char)(green < 0 ? 0 : (green > 255 ? 255 : green));
+        b[j] = (unsigned char)(blue < 0 ? 0 : (blue > 255 ? 255 : blue));
+    }
+}
+
+#ifdef COLOR_SIMD_X86
+
+/*
+ * SSSE3: 16 pixels (48 bytes, three registers) per step. Each output
+ * register is the OR of three byte shuffles, one per input register; -1 in
+ * a shuffle mask zeroes the byte.
+ */
+__attribute__((target("ssse3")))
+static void deinterleave_bgr_row_ssse3(const unsigned char *bgr, unsigned char *r, unsigned char *g,
+                                       unsigned char *b, int width) {
+    const __m128i b0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i r0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+    int j = 0;
+    for (; j + 16 <= width; j += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *) (bgr + 3 * j));
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (bgr + 3 * j + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (bgr + 3 * j + 32));
+
+        __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, b0), _mm_shuffle_epi8(v1, b1)),
+                                    _mm_shuffle_epi8(v2, b2));
+        __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, g0), _mm_shuffle_epi8(v1, g1)),
+                                     _mm_shuffle_epi8(v2, g2));
+        __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, r0), _mm_shuffle_epi8(v1, r1)),
+                                   _mm_shuffle_epi8(v2, r2));
+
+        _mm_storeu_si128((__m128i *) (b + j), blue);
+        _mm_storeu_si128((__m128i *) (g + j), green);
+        _mm_storeu_si128((__m128i *) (r + j), red);
+    }
+    deinterleave_bgr_row_scalar(bgr + 3 * j, r + j, g + j, b + j, width - j);
+}
+
+__attribute__((target("ssse3")))
+static void interleave_bgr_row_ssse3(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                     unsigned char *bgr, int width) {
+    const __m128i b0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i b1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i b2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i g0 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i g1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i r0 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+    int j = 0;
+    for (; j + 16 <= width; j += 16) {
+        __m128i blue = _mm_loadu_si128((const __m128i *) (b + j));
+        __m128i green = _mm_loadu_si128((const __m128i *) (g + j));
+        __m128i red = _mm_loadu_si128((const __m128i *) (r + j));
+
+        __m128i v0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(blue, b0), _mm_shuffle_epi8(green, g0)),
+                                  _mm_shuffle_epi8(red, r0));
+        __m128i v1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(blue, b1), _mm_shuffle_epi8(green, g1)),
+                                  _mm_shuffle_epi8(red, r1));
+        __m128i v2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(blue, b2), _mm_shuffle_epi8(green, g2)),
+                                  _mm_shuffle_epi8(red, r2));
+
+        _mm_storeu_si128((__m128i *) (bgr + 3 * j), v0);
+        _mm_storeu_si128((__m128i *) (bgr + 3 * j + 16), v1);
+        _mm_storeu_si128((__m128i *) (bgr + 3 * j + 32), v2);
+    }
+    interleave_bgr_row_scalar(r + j, g + j, b + j, bgr + 3 * j, width - j);
+}
+
+/*
+ * Fixed-point conversion of eight pixels held as 16-bit words: (r, g) pairs
+ * go through one pmaddwd and (b, 0) pairs through another, then the bias is
+ * added and the 32-bit sums are shifted back down to 16-bit results.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i ycbcr_channel_sse(__m128i rg_lo, __m128i rg_hi, __m128i b0_lo, __m128i b0_hi,
+                                        __m128i rg_coef, __m128i b_coef, __m128i bias) {
+    __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg_lo, rg_coef), _mm_madd_epi16(b0_lo, b_coef)), bias);
+    __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg_hi, rg_coef), _mm_madd_epi16(b0_hi, b_coef)), bias);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, YCC_FIXED_BITS), _mm_srai_epi32(hi, YCC_FIXED_BITS));
+}
+
+/*
+ * SSSE3: 16 pixels per step, split with the same shuffles as
+ * deinterleave_bgr_row_ssse3 and converted as two groups of eight.
+ */
+__attribute__((target("ssse3")))
+static void bgr_row_to_ycbcr_fixed_ssse3(const unsigned char *bgr, unsigned char *y, unsigned char *cb,
+                                         unsigned char *cr, int width) {
+    const __m128i b0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i r0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+    const __m128i y_rg = _mm_set1_epi32(WORD_PAIR(FIX_Y_R, FIX_Y_G));
+    const __m128i y_b = _mm_set1_epi32(WORD_PAIR(FIX_Y_B, 0));
+    const __m128i cb_rg = _mm_set1_epi32(WORD_PAIR(FIX_CB_R, FIX_CB_G));
+    const __m128i cb_b = _mm_set1_epi32(WORD_PAIR(FIX_CB_B, 0));
+    const __m128i cr_rg = _mm_set1_epi32(WORD_PAIR(FIX_CR_R, FIX_CR_G));
+    const __m128i cr_b = _mm_set1_epi32(WORD_PAIR(FIX_CR_B, 0));
+    const __m128i y_bias = _mm_set1_epi32(FIX_Y_BIAS);
+    const __m128i chroma_bias = _mm_set1_epi32(FIX_CHROMA_BIAS);
+    const __m128i zero = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 16 <= width; j += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *) (bgr + 3 * j));
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (bgr + 3 * j + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (bgr + 3 * j + 32));
+
+        __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, b0), _mm_shuffle_epi8(v1, b1)),
+                                    _mm_shuffle_epi8(v2, b2));
+        __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, g0), _mm_shuffle_epi8(v1, g1)),
+                                     _mm_shuffle_epi8(v2, g2));
+        __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, r0), _mm_shuffle_epi8(v1, r1)),
+                                   _mm_shuffle_epi8(v2, r2));
+
+        __m128i y_words[2], cb_words[2], cr_words[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i r16 = half ? _mm_unpackhi_epi8(red, zero) : _mm_unpacklo_epi8(red, zero);
+            __m128i g16 = half ? _mm_unpackhi_epi8(green, zero) : _mm_unpacklo_epi8(green, zero);
+            __m128i b16 = half ? _mm_unpackhi_epi8(blue, zero) : _mm_unpacklo_epi8(blue, zero);
+
+            __m128i rg_lo = _mm_unpacklo_epi16(r16, g16);
+            __m128i rg_hi = _mm_unpackhi_epi16(r16, g16);
+            __m128i b0_lo = _mm_unpacklo_epi16(b16, zero);
+            __m128i b0_hi = _mm_unpackhi_epi16(b16, zero);
+
+            y_words[half] = ycbcr_channel_sse(rg_lo, rg_hi, b0_lo, b0_hi, y_rg, y_b, y_bias);
+            cb_words[half] = ycbcr_channel_sse(rg_lo, rg_hi, b0_lo, b0_hi, cb_rg, cb_b, chroma_bias);
+            cr_words[half] = ycbcr_channel_sse(rg_lo, rg_hi, b0_lo, b0_hi, cr_rg, cr_b, chroma_bias);
+        }
+
+        _mm_storeu_si128((__m128i *) (y + j), _mm_packus_epi16(y_words[0], y_words[1]));
+        _mm_storeu_si128((__m128i *) (cb + j), _mm_packus_epi16(cb_words[0], cb_words[1]));
+        _mm_storeu_si128((__m128i *) (cr + j), _mm_packus_epi16(cr_words[0], cr_words[1]));
+    }
+    bgr_row_to_ycbcr_fixed_scalar(bgr + 3 * j, y + j, cb + j, cr + j, width - j);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i ycbcr_channel_avx2(__m256i rg_lo, __m256i rg_hi, __m256i b0_lo, __m256i b0_hi,
+                                         __m256i rg_coef, __m256i b_coef, __m256i bias) {
+    __m256i lo = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(rg_lo, rg_coef), _mm256_madd_epi16(b0_lo, b_coef)), bias);
+    __m256i hi = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(rg_hi, rg_coef), _mm256_madd_epi16(b0_hi, b_coef)), bias);
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, YCC_FIXED_BITS), _mm256_srai_epi32(hi, YCC_FIXED_BITS));
+}
+
+/*
+ * AVX2: 32 pixels per step as two groups of 16. The BGR split stays on
+ * 128-bit shuffles; each group is then widened to 16 words. The in-lane
+ * unpack and pack steps cancel out within a group, so only the final byte
+ * pack needs a cross-lane permute to restore pixel order.
+ */
+__attribute__((target("avx2")))
+static void bgr_row_to_ycbcr_fixed_avx2(const unsigned char *bgr, unsigned char *y, unsigned char *cb,
+                                        unsigned char *cr, int width) {
+    const __m128i b0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i r0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+    const __m256i y_rg = _mm256_set1_epi32(WORD_PAIR(FIX_Y_R, FIX_Y_G));
+    const __m256i y_b = _mm256_set1_epi32(WORD_PAIR(FIX_Y_B, 0));
+    const __m256i cb_rg = _mm256_set1_epi32(WORD_PAIR(FIX_CB_R, FIX_CB_G));
+    const __m256i cb_b = _mm256_set1_epi32(WORD_PAIR(FIX_CB_B, 0));
+    const __m256i cr_rg = _mm256_set1_epi32(WORD_PAIR(FIX_CR_R, FIX_CR_G));
+    const __m256i cr_b = _mm256_set1_epi32(WORD_PAIR(FIX_CR_B, 0));
+    const __m256i y_bias = _mm256_set1_epi32(FIX_Y_BIAS);
+    const __m256i chroma_bias = _mm256_set1_epi32(FIX_CHROMA_BIAS);
+    const __m256i zero = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 32 <= width; j += 32) {
+        __m256i y_words[2], cb_words[2], cr_words[2];
+        for (int group = 0; group < 2; group++) {
+            const unsigned char *src = bgr + 3 * (j + 16 * group);
+            __m128i v0 = _mm_loadu_si128((const __m128i *) src);
+            __m128i v1 = _mm_loadu_si128((const __m128i *) (src + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i *) (src + 32));
+
+            __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, b0), _mm_shuffle_epi8(v1, b1)),
+                                        _mm_shuffle_epi8(v2, b2));
+            __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, g0), _mm_shuffle_epi8(v1, g1)),
+                                         _mm_shuffle_epi8(v2, g2));
+            __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, r0), _mm_shuffle_epi8(v1, r1)),
+                                       _mm_shuffle_epi8(v2, r2));
+
+            __m256i r16 = _mm256_cvtepu8_epi16(red);
+            __m256i g16 = _mm256_cvtepu8_epi16(green);
+            __m256i b16 = _mm256_cvtepu8_epi16(blue);
+
+            // Lanes hold pixels 0-3 | 8-11 (lo) and 4-7 | 12-15 (hi)
+            __m256i rg_lo = _mm256_unpacklo_epi16(r16, g16);
+            __m256i rg_hi = _mm256_unpackhi_epi16(r16, g16);
+            __m256i b0_lo = _mm256_unpacklo_epi16(b16, zero);
+            __m256i b0_hi = _mm256_unpackhi_epi16(b16, zero);
+
+            y_words[group] = ycbcr_channel_avx2(rg_lo, rg_hi, b0_lo, b0_hi, y_rg, y_b, y_bias);
+            cb_words[group] = ycbcr_channel_avx2(rg_lo, rg_hi, b0_lo, b0_hi, cb_rg, cb_b, chroma_bias);
+            cr_words[group] = ycbcr_channel_avx2(rg_lo, rg_hi, b0_lo, b0_hi, cr_rg, cr_b, chroma_bias);
+        }
+
+        __m256i y_bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(y_words[0], y_words[1]), 0xD8);
+        __m256i cb_bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(cb_words[0], cb_words[1]), 0xD8);
+        __m256i cr_bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(cr_words[0], cr_words[1]), 0xD8);
+        _mm256_storeu_si256((__m256i *) (y + j), y_bytes);
+        _mm256_storeu_si256((__m256i *) (cb + j), cb_bytes);
+        _mm256_storeu_si256((__m256i *) (cr + j), cr_bytes);
+    }
+    bgr_row_to_ycbcr_fixed_ssse3(bgr + 3 * j, y + j, cb + j, cr + j, width - j);
+}
+
+/*
+ * YCbCr to RGB stays in double precision with the multiplies and adds in
+ * the same order as the scalar code (and no FMA), so every kernel rounds
+ * exactly like ycbcr_to_rgb. Clamping is a branch-free max/min before the
+ * truncating conversion.
+ */
+
+/**
+ * @brief Two pixels of YCbCr to RGB, results in the low two 32-bit lanes
+ */
+__attribute__((target("sse2")))
+static inline void ycbcr_to_rgb2_sse2(__m128d luma, __m128d blue_diff, __m128d red_diff,
+                                      __m128i *red, __m128i *green, __m128i *blue) {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d max = _mm_set1_pd(255.0);
+    __m128d r = _mm_add_pd(luma, _mm_mul_pd(_mm_set1_pd(1.402), red_diff));
+    __m128d g = _mm_sub_pd(_mm_sub_pd(luma, _mm_mul_pd(_mm_set1_pd(0.344136), blue_diff)),
+                           _mm_mul_pd(_mm_set1_pd(0.714136), red_diff));
+    __m128d b = _mm_add_pd(luma, _mm_mul_pd(_mm_set1_pd(1.772), blue_diff));
+    *red = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(r, zero), max));
+    *green = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(g, zero), max));
+    *blue = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(b, zero), max));
+}
+
+/*
+ * SSE2: 8 pixels per step, widened to 32-bit and converted two at a time.
+ */
+__attribute__((target("sse2")))
+static void ycbcr_row_to_rgb_sse2(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                                  unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128d bias = _mm_set1_pd(128.0);
+
+    int j = 0;
+    for (; j + 8 <= width; j += 8) {
+        __m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (y + j)), zero);
+        __m128i cb16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (cb + j)), zero);
+        __m128i cr16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (cr + j)), zero);
+        __m128i y32[2] = {_mm_unpacklo_epi16(y16, zero), _mm_unpackhi_epi16(y16, zero)};
+        __m128i cb32[2] = {_mm_unpacklo_epi16(cb16, zero), _mm_unpackhi_epi16(cb16, zero)};
+        __m128i cr32[2] = {_mm_unpacklo_epi16(cr16, zero), _mm_unpackhi_epi16(cr16, zero)};
+
+        __m128i red[4], green[4], blue[4];
+        for (int k = 0; k < 4; k++) {
+            // Pair k holds pixels 2k and 2k + 1
+            __m128i yk = (k & 1) ? _mm_srli_si128(y32[k >> 1], 8) : y32[k >> 1];
+            __m128i cbk = (k & 1) ? _mm_srli_si128(cb32[k >> 1], 8) : cb32[k >> 1];
+            __m128i crk = (k & 1) ? _mm_srli_si128(cr32[k >> 1], 8) : cr32[k >> 1];
+            ycbcr_to_rgb2_sse2(_mm_cvtepi32_pd(yk), _mm_sub_pd(_mm_cvtepi32_pd(cbk), bias),
+                               _mm_sub_pd(_mm_cvtepi32_pd(crk), bias), &red[k], &green[k], &blue[k]);
+        }
+
+        __m128i r16 = _mm_packs_epi32(_mm_unpacklo_epi64(red[0], red[1]), _mm_unpacklo_epi64(red[2], red[3]));
+        __m128i g16 = _mm_packs_epi32(_mm_unpacklo_epi64(green[0], green[1]), _mm_unpacklo_epi64(green[2], green[3]));
+        __m128i b16 = _mm_packs_epi32(_mm_unpacklo_epi64(blue[0], blue[1]), _mm_unpacklo_epi64(blue[2], blue[3]));
+        _mm_storel_epi64((__m128i *) (r + j), _mm_packus_epi16(r16, r16));
+        _mm_storel_epi64((__m128i *) (g + j), _mm_packus_epi16(g16, g16));
+        _mm_storel_epi64((__m128i *) (b + j), _mm_packus_epi16(b16, b16));
+    }
+    ycbcr_row_to_rgb_scalar(y + j, cb + j, cr + j, r + j, g + j, b + j, width - j);
+}
+
+/**
+ * @brief Four pixels of YCbCr to RGB as 32-bit lanes
+ */
+__attribute__((target("avx2")))
+static inline void ycbcr_to_rgb4_avx2(__m128i y32, __m128i cb32, __m128i cr32,
+                                      __m128i *red, __m128i *green, __m128i *blue) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d max = _mm256_set1_pd(255.0);
+    const __m256d bias = _mm256_set1_pd(128.0);
+    __m256d luma = _mm256_cvtepi32_pd(y32);
+    __m256d blue_diff = _mm256_sub_pd(_mm256_cvtepi32_pd(cb32), bias);
+    __m256d red_diff = _mm256_sub_pd(_mm256_cvtepi32_pd(cr32), bias);
+
+    __m256d r = _mm256_add_pd(luma, _mm256_mul_pd(_mm256_set1_pd(1.402), red_diff));
+    __m256d g = _mm256_sub_pd(_mm256_sub_pd(luma, _mm256_mul_pd(_mm256_set1_pd(0.344136), blue_diff)),
+                              _mm256_mul_pd(_mm256_set1_pd(0.714136), red_diff));
+    __m256d b = _mm256_add_pd(luma, _mm256_mul_pd(_mm256_set1_pd(1.772), blue_diff));
+    *red = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(r, zero), max));
+    *green = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(g, zero), max));
+    *blue = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(b, zero), max));
+}
+
+/*
+ * AVX2: 16 pixels per step, four groups of four doubles.
+ */
+__attribute__((target("avx2")))
+static void ycbcr_row_to_rgb_avx2(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                                  unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    int j = 0;
+    for (; j + 16 <= width; j += 16) {
+        __m128i red[4], green[4], blue[4];
+        for (int k = 0; k < 4; k++) {
+            // Group k holds pixels 4k to 4k + 3
+            int y4, cb4, cr4;
+            memcpy(&y4, y + j + 4 * k, sizeof(int));
+            memcpy(&cb4, cb + j + 4 * k, sizeof(int));
+            memcpy(&cr4, cr + j + 4 * k, sizeof(int));
+            ycbcr_to_rgb4_avx2(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(y4)), _mm_cvtepu8_epi32(_mm_cvtsi32_si128(cb4)),
+                               _mm_cvtepu8_epi32(_mm_cvtsi32_si128(cr4)), &red[k], &green[k], &blue[k]);
+        }
+
+        __m128i r16_lo = _mm_packs_epi32(red[0], red[1]), r16_hi = _mm_packs_epi32(red[2], red[3]);
+        __m128i g16_lo = _mm_packs_epi32(green[0], green[1]), g16_hi = _mm_packs_epi32(green[2], green[3]);
+        __m128i b16_lo = _mm_packs_epi32(blue[0], blue[1]), b16_hi = _mm_packs_epi32(blue[2], blue[3]);
+        _mm_storeu_si128((__m128i *) (r + j), _mm_packus_epi16(r16_lo, r16_hi));
+        _mm_storeu_si128((__m128i *) (g + j), _mm_packus_epi16(g16_lo, g16_hi));
+        _mm_storeu_si128((__m128i *) (b + j), _mm_packus_epi16(b16_lo, b16_hi));
+    }
+    ycbcr_row_to_rgb_sse2(y + j, cb + j, cr + j, r + j, g + j, b + j, width - j);
+}
+
+#endif // COLOR_SIMD_X86
+
+static DeinterleaveRow selected_deinterleave = NULL;
+static InterleaveRow selected_interleave = NULL;
+static YCbCrRow selected_ycbcr = NULL;
+static RGBRow selected_rgb = NULL;
+
+/**
+ * @brief Picks the BGR row kernels for the running CPU
+ *
+ * Called implicitly by the first conversion; callers that start threads
+ * should call it once first.
+ */
+void color_simd_init() {
+    if (selected_deinterleave != NULL) {
+        return;
+    }
+#ifdef COLOR_SIMD_X86
+    __builtin_cpu_init();
+    // SSE2 is part of every x86-64 target, so it is the floor for this kernel
+    selected_rgb = __builtin_cpu_supports("avx2") ? ycbcr_row_to_rgb_avx2 : ycbcr_row_to_rgb_sse2;
+    if (__builtin_cpu_supports("avx2")) {
+        selected_ycbcr = bgr_row_to_ycbcr_fixed_avx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        selected_ycbcr = bgr_row_to_ycbcr_fixed_ssse3;
+    } else {
+        selected_ycbcr = bgr_row_to_ycbcr_fixed_scalar;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        selected_interleave = interleave_bgr_row_ssse3;
+        selected_deinterleave = deinterleave_bgr_row_ssse3;
+        return;
+    }
+#else
+    selected_rgb = ycbcr_row_to_rgb_scalar;
+    selected_ycbcr = bgr_row_to_ycbcr_fixed_scalar;
+#endif
+    selected_interleave = interleave_bgr_row_scalar;
+    selected_deinterleave = deinterleave_bgr_row_scalar;
+}
+
+/**
+ * @brief Splits one row of interleaved BGR bytes into R, G and B planes
+ *
+ * @param bgr Input row, 3 * width bytes in B, G, R order
+ * @param r Output red samples
+ * @param g Output green samples
+ * @param b Output blue samples
+ * @param width Number of pixels
+ */
+void deinterleave_bgr_row(const unsigned char *bgr, unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    color_simd_init();
+    selected_deinterleave(bgr, r, g, b, width);
+}
+
+/**
+ * @brief Merges one row of R, G and B samples into interleaved BGR bytes
+ *
+ * @param r Red samples
+ * @param g Green samples
+ * @param b Blue samples
+ * @param bgr Output row, 3 * width bytes in B, G, R order
+ * @param width Number of pixels
+ */
+void interleave_bgr_row(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *bgr, int width) {
+    color_simd_init();
+    selected_interleave(r, g, b, bgr, width);
+}
+
+/**
+ * @brief Converts one row of interleaved BGR bytes to Y, Cb and Cr planes in fixed point
+ *
+ * Bit-exact on every kernel to the integer reference
+ *   Y  = ( 4899 R +  9617 G +  1868 B + 8192) >> 14
+ *   Cb = (-2765 R -  5427 G +  8192 B + (128 << 14) + 8191) >> 14
+ *   Cr = ( 8192 R -  6860 G -  1332 B + (128 << 14) + 8191) >> 14
+ * i.e. the JFIF matrix rounded to 2.14 fixed point. Results are rounded
+ * rather than truncated, so they can differ by one from rgb_to_ycbcr.
+ *
+ * @param bgr Input row, 3 * width bytes in B, G, R order
+ * @param y Output luminance samples
+ * @param cb Output blue-difference samples
+ * @param cr Output red-difference samples
+ * @param width Number of pixels
+ */
+void bgr_row_to_ycbcr_fixed(const unsigned char *bgr, unsigned char *y, unsigned char *cb, unsigned char *cr, int width) {
+    color_simd_init();
+    selected_ycbcr(bgr, y, cb, cr, width);
+}
+
+/**
+ * @brief Converts one row of Y, Cb and Cr samples to R, G and B planes
+ *
+ * Bit-exact to ycbcr_to_rgb on every kernel.
+ *
+ * @param y Luminance samples
+ * @param cb Blue-difference samples, already at full resolution
+ * @param cr Red-difference samples, already at full resolution
+ * @param r Output red samples
+ * @param g Output green samples
+ * @param b Output blue samples
+ * @param width Number of pixels
+ */
+void ycbcr_row_to_rgb(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                      unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    color_simd_init();
+    selected_rgb(y, cb, cr, r, g, b, width);
+}
+
+/**
+ * @brief Name of the fixed-point color conversion kernel picked for this CPU
+ */
+const char *color_simd_kernel_name() {
+    color_simd_init();
+#ifdef COLOR_SIMD_X86
+    if (selected_ycbcr == bgr_row_to_ycbcr_fixed_avx2) {
+        return "avx2";
+    }
+    if (selected_ycbcr == bgr_row_to_ycbcr_fixed_ssse3) {
+        return "ssse3";
+    }
+#endif
+    return "scalar";
+}
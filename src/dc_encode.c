@@ -15,3 +15,22 @@ void encode_dc(BitWriter* bw, int current_dc, int previous_dc) {
         bitwriter_write_int(bw, mantissa, category);
     }
 }
+
+/**
+ * @brief Table-driven DC encoder
+ *
+ * Produces exactly the same bits as encode_dc, emitting the category code and
+ * the mantissa of the difference with a single bitwriter_write_code call.
+ *
+ * @param bw BitWriter receiving the encoded bits
+ * @param current_dc DC coefficient of the current block
+ * @param previous_dc DC coefficient of the previous block of the same component
+ */
+void encode_dc_table(BitWriter* bw, int current_dc, int previous_dc) {
+    int diff = current_dc - previous_dc;
+    int category = get_category_fast(diff);
+    HuffmanCode prefix = huffman_dc_codes[category];
+    uint32_t mask = (1u << category) - 1;
+    uint32_t mantissa = (uint32_t)(diff > 0 ? diff : diff - 1) & mask;
+    bitwriter_write_code(bw, ((uint32_t)prefix.code << category) | mantissa, prefix.length + category);
+}
@@ -40,8 +40,18 @@ void compute_cosine_matrix(double matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
  */
 double** dct_2d(double** block, 
                double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
+    return dct_2d_arena(NULL, block, cosine_matrix);
+}
+
+/**
+ * @brief Same as dct_2d, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **dct_2d_arena(Arena *arena, double **block,
+                      double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
     
-    double** result = init_double_matrix(DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+    double** result = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
     
     double temp[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
     
@@ -79,8 +89,18 @@ double** dct_2d(double** block,
  */
 double **idct_2d(double **block, 
                double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
+    return idct_2d_arena(NULL, block, cosine_matrix);
+}
+
+/**
+ * @brief Same as idct_2d, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **idct_2d_arena(Arena *arena, double **block,
+                       double cosine_matrix[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
     
-    double** result = init_double_matrix(DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+    double** result = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
     
     double temp[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE];
     
@@ -106,6 +126,451 @@ double **idct_2d(double **block,
     return result;
 }
 
+/**
+ * @brief AAN scale factors: 1 for k = 0, sqrt(2) * cos(k * PI / 16) otherwise
+ *
+ * The AAN kernels leave coefficient (u, v) scaled by
+ * 8 * aan_scale_factors[u] * aan_scale_factors[v] (forward) and expect the
+ * inverse input pre-multiplied by aan_scale_factors[u] * aan_scale_factors[v] / 8.
+ * Both scalings can be folded into the quantization tables.
+ */
+const double aan_scale_factors[DCT_BLOCK_SIZE] = {
+    1.0, 1.387039845322148, 1.306562964876377, 1.175875602419359,
+    1.0, 0.785694958387102, 0.541196100146197, 0.275899379282943
+};
+
+/**
+ * @brief In-place 8-point AAN forward DCT over 8 values spaced by stride
+ */
+static void fdct_aan_1d(double *d, int stride) {
+    double tmp0 = d[0 * stride] + d[7 * stride];
+    double tmp7 = d[0 * stride] - d[7 * stride];
+    double tmp1 = d[1 * stride] + d[6 * stride];
+    double tmp6 = d[1 * stride] - d[6 * stride];
+    double tmp2 = d[2 * stride] + d[5 * stride];
+    double tmp5 = d[2 * stride] - d[5 * stride];
+    double tmp3 = d[3 * stride] + d[4 * stride];
+    double tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    double tmp10 = tmp0 + tmp3;
+    double tmp13 = tmp0 - tmp3;
+    double tmp11 = tmp1 + tmp2;
+    double tmp12 = tmp1 - tmp2;
+
+    d[0 * stride] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    double z1 = (tmp12 + tmp13) * 0.707106781186547524;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    double z5 = (tmp10 - tmp12) * 0.382683432365089772;
+    double z2 = 0.541196100146196984 * tmp10 + z5;
+    double z4 = 1.306562964876376527 * tmp12 + z5;
+    double z3 = tmp11 * 0.707106781186547524;
+
+    double z11 = tmp7 + z3;
+    double z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[1 * stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+/**
+ * @brief In-place 8-point AAN inverse DCT over 8 values spaced by stride
+ */
+static void idct_aan_1d(double *d, int stride) {
+    // Even part
+    double tmp0 = d[0 * stride];
+    double tmp1 = d[2 * stride];
+    double tmp2 = d[4 * stride];
+    double tmp3 = d[6 * stride];
+
+    double tmp10 = tmp0 + tmp2;
+    double tmp11 = tmp0 - tmp2;
+    double tmp13 = tmp1 + tmp3;
+    double tmp12 = (tmp1 - tmp3) * 1.414213562373095049 - tmp13;
+
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    // Odd part
+    double tmp4 = d[1 * stride];
+    double tmp5 = d[3 * stride];
+    double tmp6 = d[5 * stride];
+    double tmp7 = d[7 * stride];
+
+    double z13 = tmp6 + tmp5;
+    double z10 = tmp6 - tmp5;
+    double z11 = tmp4 + tmp7;
+    double z12 = tmp4 - tmp7;
+
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562373095049;
+
+    double z5 = (z10 + z12) * 1.847759065022573512;
+    tmp10 = 1.082392200292393968 * z12 - z5;
+    tmp12 = -2.613125929752753055 * z10 + z5;
+
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
+
+    d[0 * stride] = tmp0 + tmp7;
+    d[7 * stride] = tmp0 - tmp7;
+    d[1 * stride] = tmp1 + tmp6;
+    d[6 * stride] = tmp1 - tmp6;
+    d[2 * stride] = tmp2 + tmp5;
+    d[5 * stride] = tmp2 - tmp5;
+    d[4 * stride] = tmp3 + tmp4;
+    d[3 * stride] = tmp3 - tmp4;
+}
+
+/**
+ * @brief In-place separable AAN forward DCT of a row-major 8x8 block
+ *
+ * Rows then columns, 5 multiplications per 1D pass. The output is left
+ * scaled: coefficient (u, v) equals 8 * aan_scale_factors[u] *
+ * aan_scale_factors[v] times the dct_2d coefficient.
+ *
+ * @param data Row-major 8x8 block, replaced by the scaled coefficients
+ */
+void fdct_aan(double data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        fdct_aan_1d(data + i * DCT_BLOCK_SIZE, 1);
+    }
+    for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+        fdct_aan_1d(data + j, DCT_BLOCK_SIZE);
+    }
+}
+
+/**
+ * @brief In-place separable AAN inverse DCT of a row-major 8x8 block
+ *
+ * Columns then rows. The input must be pre-multiplied by
+ * aan_scale_factors[u] * aan_scale_factors[v] / 8; the output is then the
+ * spatial block, unrounded.
+ *
+ * @param data Row-major 8x8 block of prescaled coefficients, replaced by the samples
+ */
+void idct_aan(double data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+        idct_aan_1d(data + j, DCT_BLOCK_SIZE);
+    }
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        idct_aan_1d(data + i * DCT_BLOCK_SIZE, 1);
+    }
+}
+
+/**
+ * @brief Performs 2D DCT on an 8x8 block with the AAN fast algorithm
+ *
+ * With descale set, the result matches dct_2d. Without it, the coefficients
+ * stay scaled by 8 * aan_scale_factors[u] * aan_scale_factors[v] so that the
+ * scaling can be folded into the quantization table (see quantize_block_aan).
+ *
+ * @param block Input 8x8 block of (level-shifted) pixel values
+ * @param descale Non-zero to remove the AAN scale factors
+ * @return Pointer to a new 8x8 matrix containing DCT coefficients
+ */
+double **dct_2d_aan(double **block, int descale) {
+    return dct_2d_aan_arena(NULL, block, descale);
+}
+
+/**
+ * @brief Same as dct_2d_aan, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **dct_2d_aan_arena(Arena *arena, double **block, int descale) {
+    double data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+    double **result = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            data[i * DCT_BLOCK_SIZE + j] = block[i][j];
+        }
+    }
+
+    fdct_aan(data);
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            double value = data[i * DCT_BLOCK_SIZE + j];
+            if (descale) {
+                value /= 8.0 * aan_scale_factors[i] * aan_scale_factors[j];
+            }
+            result[i][j] = value;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Performs 2D inverse DCT on an 8x8 block with the AAN fast algorithm
+ *
+ * With prescaled unset, the input is a plain coefficient block and the result
+ * matches idct_2d. With it set, the input has already been multiplied by
+ * aan_scale_factors[u] * aan_scale_factors[v] / 8 (see dequantize_block_aan).
+ * The output is rounded like idct_2d.
+ *
+ * @param block Input 8x8 block of DCT coefficients
+ * @param prescaled Non-zero if the AAN scale factors were folded in already
+ * @return Pointer to a new 8x8 matrix containing pixel values in spatial domain
+ */
+double **idct_2d_aan(double **block, int prescaled) {
+    return idct_2d_aan_arena(NULL, block, prescaled);
+}
+
+/**
+ * @brief Same as idct_2d_aan, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **idct_2d_aan_arena(Arena *arena, double **block, int prescaled) {
+    double data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+    double **result = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            double value = block[i][j];
+            if (!prescaled) {
+                value *= aan_scale_factors[i] * aan_scale_factors[j] / 8.0;
+            }
+            data[i * DCT_BLOCK_SIZE + j] = value;
+        }
+    }
+
+    idct_aan(data);
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            result[i][j] = round(data[i * DCT_BLOCK_SIZE + j]);
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Fixed-point constants for the integer DCT: FIX(x) = round(x * 2^CONST_BITS).
+ * Intermediate results between the two passes keep PASS1_BITS extra bits.
+ */
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+#define FIX_0_298631336 ((int32_t) 2446)
+#define FIX_0_390180644 ((int32_t) 3196)
+#define FIX_0_541196100 ((int32_t) 4433)
+#define FIX_0_765366865 ((int32_t) 6270)
+#define FIX_0_899976223 ((int32_t) 7373)
+#define FIX_1_175875602 ((int32_t) 9633)
+#define FIX_1_501321110 ((int32_t) 12299)
+#define FIX_1_847759065 ((int32_t) 15137)
+#define FIX_1_961570560 ((int32_t) 16069)
+#define FIX_2_053119869 ((int32_t) 16819)
+#define FIX_2_562915447 ((int32_t) 20995)
+#define FIX_3_072711026 ((int32_t) 25172)
+
+// Right shift by n bits with rounding
+#define DESCALE(x, n) (((x) + ((int32_t) 1 << ((n) - 1))) >> (n))
+
+/**
+ * @brief In-place 8-point LLM forward DCT in fixed point
+ *
+ * The even outputs 0 and 4 are scaled by 2^(CONST_BITS) before the final
+ * descale, the rest come out of the rotations already scaled; every output is
+ * descaled by the given shifts.
+ */
+static void fdct_islow_1d(int32_t *d, int stride, int shift_even, int shift_rot) {
+    int32_t tmp0 = d[0 * stride] + d[7 * stride];
+    int32_t tmp7 = d[0 * stride] - d[7 * stride];
+    int32_t tmp1 = d[1 * stride] + d[6 * stride];
+    int32_t tmp6 = d[1 * stride] - d[6 * stride];
+    int32_t tmp2 = d[2 * stride] + d[5 * stride];
+    int32_t tmp5 = d[2 * stride] - d[5 * stride];
+    int32_t tmp3 = d[3 * stride] + d[4 * stride];
+    int32_t tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    if (shift_even < 0) {
+        d[0 * stride] = (tmp10 + tmp11) * ((int32_t) 1 << -shift_even);
+        d[4 * stride] = (tmp10 - tmp11) * ((int32_t) 1 << -shift_even);
+    } else {
+        d[0 * stride] = DESCALE(tmp10 + tmp11, shift_even);
+        d[4 * stride] = DESCALE(tmp10 - tmp11, shift_even);
+    }
+
+    int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+    d[2 * stride] = DESCALE(z1 + tmp13 * FIX_0_765366865, shift_rot);
+    d[6 * stride] = DESCALE(z1 - tmp12 * FIX_1_847759065, shift_rot);
+
+    // Odd part
+    z1 = tmp4 + tmp7;
+    int32_t z2 = tmp5 + tmp6;
+    int32_t z3 = tmp4 + tmp6;
+    int32_t z4 = tmp5 + tmp7;
+    int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+    tmp4 *= FIX_0_298631336;
+    tmp5 *= FIX_2_053119869;
+    tmp6 *= FIX_3_072711026;
+    tmp7 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 = z3 * -FIX_1_961570560 + z5;
+    z4 = z4 * -FIX_0_390180644 + z5;
+
+    d[7 * stride] = DESCALE(tmp4 + z1 + z3, shift_rot);
+    d[5 * stride] = DESCALE(tmp5 + z2 + z4, shift_rot);
+    d[3 * stride] = DESCALE(tmp6 + z2 + z3, shift_rot);
+    d[1 * stride] = DESCALE(tmp7 + z1 + z4, shift_rot);
+}
+
+/**
+ * @brief In-place 8-point LLM inverse DCT in fixed point
+ */
+static void idct_islow_1d(int32_t *d, int stride, int shift) {
+    // Even part
+    int32_t z2 = d[2 * stride];
+    int32_t z3 = d[6 * stride];
+    int32_t z1 = (z2 + z3) * FIX_0_541196100;
+    int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+    int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+
+    z2 = d[0 * stride];
+    z3 = d[4 * stride];
+    int32_t tmp0 = (z2 + z3) * ((int32_t) 1 << CONST_BITS);
+    int32_t tmp1 = (z2 - z3) * ((int32_t) 1 << CONST_BITS);
+
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    // Odd part
+    tmp0 = d[7 * stride];
+    tmp1 = d[5 * stride];
+    tmp2 = d[3 * stride];
+    tmp3 = d[1 * stride];
+
+    z1 = tmp0 + tmp3;
+    z2 = tmp1 + tmp2;
+    z3 = tmp0 + tmp2;
+    int32_t z4 = tmp1 + tmp3;
+    int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+    tmp0 *= FIX_0_298631336;
+    tmp1 *= FIX_2_053119869;
+    tmp2 *= FIX_3_072711026;
+    tmp3 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 = z3 * -FIX_1_961570560 + z5;
+    z4 = z4 * -FIX_0_390180644 + z5;
+
+    tmp0 += z1 + z3;
+    tmp1 += z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    d[0 * stride] = DESCALE(tmp10 + tmp3, shift);
+    d[7 * stride] = DESCALE(tmp10 - tmp3, shift);
+    d[1 * stride] = DESCALE(tmp11 + tmp2, shift);
+    d[6 * stride] = DESCALE(tmp11 - tmp2, shift);
+    d[2 * stride] = DESCALE(tmp12 + tmp1, shift);
+    d[5 * stride] = DESCALE(tmp12 - tmp1, shift);
+    d[3 * stride] = DESCALE(tmp13 + tmp0, shift);
+    d[4 * stride] = DESCALE(tmp13 - tmp0, shift);
+}
+
+/**
+ * @brief In-place fixed-point forward DCT of a row-major 8x8 int16 block
+ *
+ * Loeffler-Ligtenberg-Moschytz factorization (12 multiplications per 1D pass)
+ * with 13-bit constants and 32-bit intermediates. The input is a level-shifted
+ * block in [-128, 127]; the output is the dct_2d coefficient scaled up by
+ * 2^DCT_ISLOW_OUTPUT_BITS and rounded to the nearest integer. Like libjpeg,
+ * the extra bits are left for the quantizer to remove, so each coefficient
+ * is rounded only once on its way to the quantized value.
+ *
+ * Accuracy versus round(dct_2d * 8), measured on 100000 random level-shifted
+ * blocks: at most 1 in absolute value (an eighth of a coefficient), with
+ * about 14% of the values off by one.
+ *
+ * @param data Row-major 8x8 block, replaced by the coefficients
+ */
+void fdct_islow(int16_t data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    int32_t workspace[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+
+    for (int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        workspace[i] = data[i];
+    }
+
+    // Rows: results scaled up by 2^PASS1_BITS
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        fdct_islow_1d(workspace + i * DCT_BLOCK_SIZE, 1, -PASS1_BITS, CONST_BITS - PASS1_BITS);
+    }
+    // Columns: remove PASS1_BITS, keep the overall factor of 8 of the unnormalized transform
+    for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+        fdct_islow_1d(workspace + j, DCT_BLOCK_SIZE, PASS1_BITS + 3 - DCT_ISLOW_OUTPUT_BITS,
+                      CONST_BITS + PASS1_BITS + 3 - DCT_ISLOW_OUTPUT_BITS);
+    }
+
+    for (int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        data[i] = (int16_t) workspace[i];
+    }
+}
+
+/**
+ * @brief In-place fixed-point inverse DCT of a row-major 8x8 int16 block
+ *
+ * Same factorization as fdct_islow. The input holds dequantized coefficients,
+ * the output the level-shifted samples rounded to the nearest integer (not
+ * clamped), like idct_2d.
+ *
+ * Accuracy versus idct_2d, measured on 100000 random quantized coefficient
+ * blocks: at most 1 in absolute value, with about 2% of the samples off by one.
+ *
+ * @param data Row-major 8x8 block of coefficients, replaced by the samples
+ */
+void idct_islow(int16_t data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    int32_t workspace[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+
+    for (int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        workspace[i] = data[i];
+    }
+
+    // Columns: keep PASS1_BITS of extra precision
+    for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+        idct_islow_1d(workspace + j, DCT_BLOCK_SIZE, CONST_BITS - PASS1_BITS);
+    }
+    // Rows: remove PASS1_BITS and the factor of 8
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        idct_islow_1d(workspace + i * DCT_BLOCK_SIZE, 1, CONST_BITS + PASS1_BITS + 3);
+    }
+
+    for (int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        data[i] = (int16_t) workspace[i];
+    }
+}
+
 /**
  * @brief Applies level shifting to pixel values before DCT
  *
@@ -117,7 +582,16 @@ double **idct_2d(double **block,
  * @return Pointer to a new 8x8 matrix with level-shifted double values
  */
 double **level_shift(double **block) {
-    double **shifted_block = init_double_matrix(DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+    return level_shift_arena(NULL, block);
+}
+
+/**
+ * @brief Same as level_shift, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **level_shift_arena(Arena *arena, double **block) {
+    double **shifted_block = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
     for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
         for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
             shifted_block[i][j] = block[i][j] - 128.0;
@@ -137,7 +611,16 @@ double **level_shift(double **block) {
  * @return Pointer to a new 8x8 matrix with double pixel values
  */
 double **unlevel_shift(double **block) {
-    double **unshifted_block = init_double_matrix(DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+    return unlevel_shift_arena(NULL, block);
+}
+
+/**
+ * @brief Same as unlevel_shift, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **unlevel_shift_arena(Arena *arena, double **block) {
+    double **unshifted_block = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
     for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
         for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
             unshifted_block[i][j] = (block[i][j] + 128.0);
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dct.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DCT_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * One 8-point AAN pass applied "vertically" over eight vectors: v[k] holds
+ * element k of as many independent 1D transforms as the vector has lanes.
+ * The same macro serves the scalar, SSE2 and AVX2 kernels through the
+ * ADD/SUB/MUL/SET1 operations.
+ */
+#define AAN_FDCT_PASS(v, T, ADD, SUB, MUL, SET1) do {                     \
+    T tmp0 = ADD(v[0], v[7]);                                               \
+    T tmp7 = SUB(v[0], v[7]);                                               \
+    T tmp1 = ADD(v[1], v[6]);                                               \
+    T tmp6 = SUB(v[1], v[6]);                                               \
+    T tmp2 = ADD(v[2], v[5]);                                               \
+    T tmp5 = SUB(v[2], v[5]);                                               \
+    T tmp3 = ADD(v[3], v[4]);                                               \
+    T tmp4 = SUB(v[3], v[4]);                                               \
+                                                                            \
+    T tmp10 = ADD(tmp0, tmp3);                                              \
+    T tmp13 = SUB(tmp0, tmp3);                                              \
+    T tmp11 = ADD(tmp1, tmp2);                                              \
+    T tmp12 = SUB(tmp1, tmp2);                                              \
+                                                                            \
+    v[0] = ADD(tmp10, tmp11);                                               \
+    v[4] = SUB(tmp10, tmp11);                                               \
+                                                                            \
+    T z1 = MUL(ADD(tmp12, tmp13), SET1(0.707106781f));                      \
+    v[2] = ADD(tmp13, z1);                                                  \
+    v[6] = SUB(tmp13, z1);                                                  \
+                                                                            \
+    tmp10 = ADD(tmp4, tmp5);                                                \
+    tmp11 = ADD(tmp5, tmp6);                                                \
+    tmp12 = ADD(tmp6, tmp7);                                                \
+                                                                            \
+    T z5 = MUL(SUB(tmp10, tmp12), SET1(0.382683433f));                      \
+    T z2 = ADD(MUL(tmp10, SET1(0.541196100f)), z5);                         \
+    T z4 = ADD(MUL(tmp12, SET1(1.306562965f)), z5);                         \
+    T z3 = MUL(tmp11, SET1(0.707106781f));                                  \
+                                                                            \
+    T z11 = ADD(tmp7, z3);                                                  \
+    T z13 = SUB(tmp7, z3);                                                  \
+                                                                            \
+    v[5] = ADD(z13, z2);                                                    \
+    v[3] = SUB(z13, z2);                                                    \
+    v[1] = ADD(z11, z4);                                                    \
+    v[7] = SUB(z11, z4);                                                    \
+} while (0)
+
+#define AAN_IDCT_PASS(v, T, ADD, SUB, MUL, SET1) do {                     \
+    T tmp10 = ADD(v[0], v[4]);                                              \
+    T tmp11 = SUB(v[0], v[4]);                                              \
+    T tmp13 = ADD(v[2], v[6]);                                              \
+    T tmp12 = SUB(MUL(SUB(v[2], v[6]), SET1(1.414213562f)), tmp13);         \
+                                                                            \
+    T tmp0 = ADD(tmp10, tmp13);                                             \
+    T tmp3 = SUB(tmp10, tmp13);                                             \
+    T tmp1 = ADD(tmp11, tmp12);                                             \
+    T tmp2 = SUB(tmp11, tmp12);                                             \
+                                                                            \
+    T z13 = ADD(v[5], v[3]);                                                \
+    T z10 = SUB(v[5], v[3]);                                                \
+    T z11 = ADD(v[1], v[7]);                                                \
+    T z12 = SUB(v[1], v[7]);                                                \
+                                                                            \
+    T tmp7 = ADD(z11, z13);                                                 \
+    tmp11 = MUL(SUB(z11, z13), SET1(1.414213562f));                         \
+                                                                            \
+    T z5 = MUL(ADD(z10, z12), SET1(1.847759065f));                          \
+    tmp10 = SUB(MUL(z12, SET1(1.082392200f)), z5);                          \
+    tmp12 = SUB(z5, MUL(z10, SET1(2.613125930f)));                          \
+                                                                            \
+    T tmp6 = SUB(tmp12, tmp7);                                              \
+    T tmp5 = SUB(tmp11, tmp6);                                              \
+    T tmp4 = ADD(tmp10, tmp5);                                              \
+                                                                            \
+    v[0] = ADD(tmp0, tmp7);                                                 \
+    v[7] = SUB(tmp0, tmp7);                                                 \
+    v[1] = ADD(tmp1, tmp6);                                                 \
+    v[6] = SUB(tmp1, tmp6);                                                 \
+    v[2] = ADD(tmp2, tmp5);                                                 \
+    v[5] = SUB(tmp2, tmp5);                                                 \
+    v[4] = ADD(tmp3, tmp4);                                                 \
+    v[3] = SUB(tmp3, tmp4);                                                 \
+} while (0)
+
+#define SCALAR_ADD(a, b) ((a) + (b))
+#define SCALAR_SUB(a, b) ((a) - (b))
+#define SCALAR_MUL(a, b) ((a) * (b))
+#define SCALAR_SET1(a) (a)
+
+/**
+ * @brief Portable float AAN forward DCT, reference for the SIMD kernels
+ *
+ * Same scaling as fdct_aan, in single precision.
+ *
+ * @param data Row-major 8x8 block, replaced by the scaled coefficients
+ */
+void fdct_aan_float(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    float v[DCT_BLOCK_SIZE];
+
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) v[k] = data[i * DCT_BLOCK_SIZE + k];
+        AAN_FDCT_PASS(v, float, SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_SET1);
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) data[i * DCT_BLOCK_SIZE + k] = v[k];
+    }
+    for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) v[k] = data[k * DCT_BLOCK_SIZE + j];
+        AAN_FDCT_PASS(v, float, SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_SET1);
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) data[k * DCT_BLOCK_SIZE + j] = v[k];
+    }
+}
+
+/**
+ * @brief Portable float AAN inverse DCT, reference for the SIMD kernels
+ *
+ * Same scaling as idct_aan, in single precision.
+ *
+ * @param data Row-major 8x8 block of prescaled coefficients, replaced by the samples
+ */
+void idct_aan_float(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    float v[DCT_BLOCK_SIZE];
+
+    for (int j = 0; j < DCT_BLOCK_SIZE; j++) {
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) v[k] = data[k * DCT_BLOCK_SIZE + j];
+        AAN_IDCT_PASS(v, float, SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_SET1);
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) data[k * DCT_BLOCK_SIZE + j] = v[k];
+    }
+    for (int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) v[k] = data[i * DCT_BLOCK_SIZE + k];
+        AAN_IDCT_PASS(v, float, SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_SET1);
+        for (int k = 0; k < DCT_BLOCK_SIZE; k++) data[i * DCT_BLOCK_SIZE + k] = v[k];
+    }
+}
+
+#ifdef DCT_SIMD_X86
+
+/*
+ * SSE2: a block is 16 registers of 4 floats, left[k] holding columns 0-3 of
+ * row k and right[k] columns 4-7. Each pass runs over the columns of both
+ * halves, then the block is transposed in registers as four 4x4 tiles.
+ */
+__attribute__((target("sse2")))
+static void transpose_8x8_sse2(__m128 left[8], __m128 right[8]) {
+    __m128 a0 = left[0], a1 = left[1], a2 = left[2], a3 = left[3];
+    __m128 b0 = right[0], b1 = right[1], b2 = right[2], b3 = right[3];
+    __m128 c0 = left[4], c1 = left[5], c2 = left[6], c3 = left[7];
+    __m128 d0 = right[4], d1 = right[5], d2 = right[6], d3 = right[7];
+
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+    // Top-left and bottom-right tiles stay in place, the other two swap
+    left[0] = a0; left[1] = a1; left[2] = a2; left[3] = a3;
+    right[0] = c0; right[1] = c1; right[2] = c2; right[3] = c3;
+    left[4] = b0; left[5] = b1; left[6] = b2; left[7] = b3;
+    right[4] = d0; right[5] = d1; right[6] = d2; right[7] = d3;
+}
+
+__attribute__((target("sse2")))
+static void fdct_aan_sse2(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    __m128 left[8], right[8];
+
+    for (int k = 0; k < 8; k++) {
+        left[k] = _mm_loadu_ps(data + k * 8);
+        right[k] = _mm_loadu_ps(data + k * 8 + 4);
+    }
+
+    AAN_FDCT_PASS(left, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    AAN_FDCT_PASS(right, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    transpose_8x8_sse2(left, right);
+    AAN_FDCT_PASS(left, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    AAN_FDCT_PASS(right, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    transpose_8x8_sse2(left, right);
+
+    for (int k = 0; k < 8; k++) {
+        _mm_storeu_ps(data + k * 8, left[k]);
+        _mm_storeu_ps(data + k * 8 + 4, right[k]);
+    }
+}
+
+__attribute__((target("sse2")))
+static void idct_aan_sse2(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    __m128 left[8], right[8];
+
+    for (int k = 0; k < 8; k++) {
+        left[k] = _mm_loadu_ps(data + k * 8);
+        right[k] = _mm_loadu_ps(data + k * 8 + 4);
+    }
+
+    AAN_IDCT_PASS(left, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    AAN_IDCT_PASS(right, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    transpose_8x8_sse2(left, right);
+    AAN_IDCT_PASS(left, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    AAN_IDCT_PASS(right, __m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps);
+    transpose_8x8_sse2(left, right);
+
+    for (int k = 0; k < 8; k++) {
+        _mm_storeu_ps(data + k * 8, left[k]);
+        _mm_storeu_ps(data + k * 8 + 4, right[k]);
+    }
+}
+
+/*
+ * AVX2: one row per 256-bit register, the whole block in eight registers.
+ */
+__attribute__((target("avx2")))
+static void transpose_8x8_avx2(__m256 r[8]) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void fdct_aan_avx2(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    __m256 r[8];
+
+    for (int k = 0; k < 8; k++) {
+        r[k] = _mm256_loadu_ps(data + k * 8);
+    }
+
+    AAN_FDCT_PASS(r, __m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps);
+    transpose_8x8_avx2(r);
+    AAN_FDCT_PASS(r, __m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps);
+    transpose_8x8_avx2(r);
+
+    for (int k = 0; k < 8; k++) {
+        _mm256_storeu_ps(data + k * 8, r[k]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void idct_aan_avx2(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    __m256 r[8];
+
+    for (int k = 0; k < 8; k++) {
+        r[k] = _mm256_loadu_ps(data + k * 8);
+    }
+
+    AAN_IDCT_PASS(r, __m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps);
+    transpose_8x8_avx2(r);
+    AAN_IDCT_PASS(r, __m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps);
+    transpose_8x8_avx2(r);
+
+    for (int k = 0; k < 8; k++) {
+        _mm256_storeu_ps(data + k * 8, r[k]);
+    }
+}
+
+#endif // DCT_SIMD_X86
+
+typedef void (*FloatBlockKernel)(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]);
+
+static FloatBlockKernel selected_fdct = NULL;
+static FloatBlockKernel selected_idct = NULL;
+static const char *selected_name = NULL;
+
+/**
+ * @brief Picks the best float DCT kernels for the running CPU
+ *
+ * AVX2 if available, then SSE2, then the portable code. Called implicitly by
+ * the first transform; callers that start threads should call it once first.
+ */
+void dct_simd_init() {
+    if (selected_fdct != NULL) {
+        return;
+    }
+#ifdef DCT_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        selected_idct = idct_aan_avx2;
+        selected_name = "avx2";
+        selected_fdct = fdct_aan_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        selected_idct = idct_aan_sse2;
+        selected_name = "sse2";
+        selected_fdct = fdct_aan_sse2;
+        return;
+    }
+#endif
+    selected_idct = idct_aan_float;
+    selected_name = "scalar";
+    selected_fdct = fdct_aan_float;
+}
+
+/**
+ * @brief Name of the kernels chosen by dct_simd_init ("avx2", "sse2" or "scalar")
+ */
+const char *dct_simd_kernel_name() {
+    dct_simd_init();
+    return selected_name;
+}
+
+/**
+ * @brief Float AAN forward DCT using the fastest kernel for this CPU
+ *
+ * Same scaling as fdct_aan: coefficient (u, v) is left multiplied by
+ * 8 * aan_scale_factors[u] * aan_scale_factors[v].
+ *
+ * @param data Row-major 8x8 block, replaced by the scaled coefficients
+ */
+void fdct_aan_simd(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    dct_simd_init();
+    selected_fdct(data);
+}
+
+/**
+ * @brief Float AAN inverse DCT using the fastest kernel for this CPU
+ *
+ * Same scaling as idct_aan: the input must be prescaled by
+ * aan_scale_factors[u] * aan_scale_factors[v] / 8.
+ *
+ * @param data Row-major 8x8 block of prescaled coefficients, replaced by the samples
+ */
+void idct_aan_simd(float data[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    dct_simd_init();
+    selected_idct(data);
+}
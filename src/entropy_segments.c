@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "entropy_segments.h"
+#include "bin_format.h"
+
+// One restart interval per task, each coded into its own memory writer
+typedef struct {
+    const CoefficientBuffer *coefficients;
+    int restart_interval;
+    DCEncoder dc_encoder;
+    ACEncoder ac_encoder;
+    BitWriter *segments;
+} SegmentJob;
+
+// One restart interval per task, each read from its own offset of the bitstream
+typedef struct {
+    const HuffmanDecoder *decoder;
+    const uint8_t *bitstream;
+    size_t size;
+    const uint32_t *offsets;
+    CoefficientBuffer *coefficients;
+    int restart_interval;
+    int segment_count;
+} SegmentReadJob;
+
+/**
+ * @brief Entropy codes one block of zigzag-ordered coefficients
+ *
+ * Shared by every encoder that codes from int16_t coefficient blocks: the
+ * restart segments here, the streaming encoder and the pipelined encoder.
+ *
+ * @param bw Destination bit writer
+ * @param block Quantized coefficients in zigzag order
+ * @param previous_dc DC predictor of the component, updated to this block's DC
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ */
+void encode_coefficient_block(BitWriter *bw, const int16_t block[BLOCK_COEFFICIENTS], int *previous_dc,
+                              DCEncoder dc_encoder, ACEncoder ac_encoder) {
+    int coefficients[BLOCK_COEFFICIENTS];
+    for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+        coefficients[k] = block[k];
+    }
+
+    dc_encoder(bw, coefficients[0], *previous_dc);
+    ac_encoder(bw, coefficients);
+    *previous_dc = coefficients[0];
+}
+
+/**
+ * @brief Number of MCUs of an image in interleaved order, one per chroma block
+ */
+int mcu_total(const CoefficientBuffer *coefficients) {
+    return coefficient_block_count(&coefficients->cb);
+}
+
+/**
+ * @brief Starts interleaved coding at the writer's current position, DC predictors at 0
+ *
+ * @param coder Coder to initialize
+ * @param writer Destination bit writer, positioned at the first block
+ * @param restart_interval MCUs per restart interval, 0 for none
+ * @param segment_offsets Filled with the start of every interval after the first, or NULL
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ */
+void mcu_coder_init(McuCoder *coder, BitWriter *writer, int restart_interval, uint32_t *segment_offsets,
+                    DCEncoder dc_encoder, ACEncoder ac_encoder) {
+    coder->writer = writer;
+    coder->restart_interval = restart_interval;
+    coder->mcus_done = 0;
+    coder->previous_dc_y = 0;
+    coder->previous_dc_cb = 0;
+    coder->previous_dc_cr = 0;
+    coder->segment_offsets = segment_offsets;
+    coder->bitstream_start = bitwriter_bytes_written(writer);
+    coder->dc_encoder = dc_encoder;
+    coder->ac_encoder = ac_encoder;
+}
+
+/**
+ * @brief Entropy codes a run of MCUs from one MCU row in interleaved order
+ *
+ * Each MCU contributes its up to four Y blocks, then one Cb and one Cr
+ * block. A restart marker goes in front of every restart_interval-th MCU,
+ * with its offset recorded and the DC predictors reset.
+ *
+ * @param coder Coder from mcu_coder_init
+ * @param y Y blocks of the MCU row: luma_rows block rows of luma_cols blocks, contiguous
+ * @param luma_rows Y block rows present, MCU_LUMA_BLOCKS except at the bottom
+ * @param luma_cols Y blocks per block row
+ * @param cb Cb blocks of the MCU row, one per MCU
+ * @param cr Cr blocks of the MCU row, one per MCU
+ * @param first_mcu Column of the first MCU in the row
+ * @param count Number of MCUs
+ */
+void mcu_coder_encode_row(McuCoder *coder, const int16_t *y, int luma_rows, int luma_cols,
+                          const int16_t *cb, const int16_t *cr, int first_mcu, int count) {
+    for (int c = first_mcu; c < first_mcu + count; c++) {
+        if (coder->restart_interval > 0 && coder->mcus_done > 0 && coder->mcus_done % coder->restart_interval == 0) {
+            int segment = coder->mcus_done / coder->restart_interval;
+            write_restart_marker(coder->writer, segment);
+            if (coder->segment_offsets != NULL) {
+                coder->segment_offsets[segment] =
+                    (uint32_t) (bitwriter_bytes_written(coder->writer) - coder->bitstream_start);
+            }
+            coder->previous_dc_y = 0;
+            coder->previous_dc_cb = 0;
+            coder->previous_dc_cr = 0;
+        }
+        for (int k = 0; k < MCU_LUMA_BLOCKS * MCU_LUMA_BLOCKS; k++) {
+            int row = k / MCU_LUMA_BLOCKS;
+            int col = c * MCU_LUMA_BLOCKS + k % MCU_LUMA_BLOCKS;
+            if (row < luma_rows && col < luma_cols) {
+                encode_coefficient_block(coder->writer, y + ((size_t) row * luma_cols + col) * BLOCK_COEFFICIENTS,
+                                         &coder->previous_dc_y, coder->dc_encoder, coder->ac_encoder);
+            }
+        }
+        encode_coefficient_block(coder->writer, cb + (size_t) c * BLOCK_COEFFICIENTS, &coder->previous_dc_cb,
+                                 coder->dc_encoder, coder->ac_encoder);
+        encode_coefficient_block(coder->writer, cr + (size_t) c * BLOCK_COEFFICIENTS, &coder->previous_dc_cr,
+                                 coder->dc_encoder, coder->ac_encoder);
+        coder->mcus_done++;
+    }
+}
+
+/**
+ * @brief Entropy codes a run of MCUs in interleaved order, DC predictors starting from 0
+ *
+ * The run may start and end anywhere in an MCU row; no restart markers are
+ * written, the caller separates intervals.
+ *
+ * @param bw Destination bit writer
+ * @param coefficients Quantized coefficients of the whole image
+ * @param first_mcu Raster index of the first MCU
+ * @param count Number of MCUs
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ */
+void encode_mcu_range(BitWriter *bw, const CoefficientBuffer *coefficients, int first_mcu, int count,
+                      DCEncoder dc_encoder, ACEncoder ac_encoder) {
+    McuCoder coder;
+    mcu_coder_init(&coder, bw, 0, NULL, dc_encoder, ac_encoder);
+    int mcu_cols = coefficients->cb.block_cols;
+
+    for (int m = first_mcu; m < first_mcu + count;) {
+        int r = m / mcu_cols;
+        int c = m % mcu_cols;
+        int run = mcu_cols - c < first_mcu + count - m ? mcu_cols - c : first_mcu + count - m;
+        int luma_rows = coefficients->y.block_rows - r * MCU_LUMA_BLOCKS;
+        if (luma_rows > MCU_LUMA_BLOCKS) {
+            luma_rows = MCU_LUMA_BLOCKS;
+        }
+        mcu_coder_encode_row(&coder, coefficient_block(&coefficients->y, r * MCU_LUMA_BLOCKS, 0), luma_rows,
+                             coefficients->y.block_cols, coefficient_block(&coefficients->cb, r, 0),
+                             coefficient_block(&coefficients->cr, r, 0), c, run);
+        m += run;
+    }
+}
+
+/**
+ * @brief Entropy decodes a run of MCUs in interleaved order, DC predictors starting from 0
+ *
+ * @param decoder Lookup-table Huffman decoder
+ * @param br Source bit reader, at the first block of the run
+ * @param coefficients Destination planes, MCU-order geometry
+ * @param first_mcu Raster index of the first MCU
+ * @param count Number of MCUs
+ */
+void decode_mcu_range(const HuffmanDecoder *decoder, BitReader *br, CoefficientBuffer *coefficients,
+                      int first_mcu, int count) {
+    int previous_dc_y = 0, previous_dc_cb = 0, previous_dc_cr = 0;
+    int mcu_cols = coefficients->cb.block_cols;
+    int block[BLOCK_COEFFICIENTS];
+    int16_t *destination[MCU_LUMA_BLOCKS * MCU_LUMA_BLOCKS + 2];
+    int *predictor[MCU_LUMA_BLOCKS * MCU_LUMA_BLOCKS + 2];
+
+    for (int m = first_mcu; m < first_mcu + count; m++) {
+        int r = m / mcu_cols;
+        int c = m % mcu_cols;
+        int blocks = 0;
+        for (int k = 0; k < MCU_LUMA_BLOCKS * MCU_LUMA_BLOCKS; k++) {
+            int row = r * MCU_LUMA_BLOCKS + k / MCU_LUMA_BLOCKS;
+            int col = c * MCU_LUMA_BLOCKS + k % MCU_LUMA_BLOCKS;
+            if (row < coefficients->y.block_rows && col < coefficients->y.block_cols) {
+                destination[blocks] = coefficient_block(&coefficients->y, row, col);
+                predictor[blocks++] = &previous_dc_y;
+            }
+        }
+        destination[blocks] = coefficient_block(&coefficients->cb, r, c);
+        predictor[blocks++] = &previous_dc_cb;
+        destination[blocks] = coefficient_block(&coefficients->cr, r, c);
+        predictor[blocks++] = &previous_dc_cr;
+
+        for (int b = 0; b < blocks; b++) {
+            decode_block(decoder, br, predictor[b], block);
+            for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+                destination[b][k] = (int16_t) block[k];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Task: codes restart interval index into its own byte-aligned buffer
+ */
+static void encode_segment_task(void *context, int index) {
+    SegmentJob *job = (SegmentJob *) context;
+    int first = index * job->restart_interval;
+    int count = mcu_total(job->coefficients) - first;
+    if (count > job->restart_interval) {
+        count = job->restart_interval;
+    }
+
+    BitWriter *segment = &job->segments[index];
+    bitwriter_init_growable(segment, (size_t) count * SEGMENT_BYTES_PER_MCU);
+    encode_mcu_range(segment, job->coefficients, first, count, job->dc_encoder, job->ac_encoder);
+    bitwriter_flush(segment);
+}
+
+/**
+ * @brief Task: decodes restart interval index from its offset in the bitstream
+ */
+static void decode_segment_task(void *context, int index) {
+    SegmentReadJob *job = (SegmentReadJob *) context;
+    int first = index * job->restart_interval;
+    int count = mcu_total(job->coefficients) - first;
+    if (count > job->restart_interval) {
+        count = job->restart_interval;
+    }
+    size_t start = job->offsets[index];
+    size_t end = index + 1 < job->segment_count ? job->offsets[index + 1] - 2 : job->size;
+
+    BitReader reader;
+    bitreader_init_memory(&reader, job->bitstream + start, end - start);
+    decode_mcu_range(job->decoder, &reader, job->coefficients, first, count);
+}
+
+/**
+ * @brief Entropy codes all MCUs as independent restart intervals across the pool
+ *
+ * Intervals share no state (DC predictors restart, each begins on a byte
+ * boundary), so each is coded into memory on whichever thread picks it up
+ * and the results are appended in order, separated by restart markers.
+ * The output is the same for any number of threads.
+ *
+ * @param pool Worker threads
+ * @param bw Destination bit writer, aligned to a byte boundary first
+ * @param coefficients Quantized coefficients of the whole image
+ * @param restart_interval MCUs per interval, at least 1
+ * @param write_table Nonzero to write the segment table in front of the bitstream
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ */
+void encode_restart_segments(ThreadPool *pool, BitWriter *bw, const CoefficientBuffer *coefficients,
+                             int restart_interval, int write_table, DCEncoder dc_encoder, ACEncoder ac_encoder) {
+    int segment_count = bin_segment_count(mcu_total(coefficients), restart_interval);
+    SegmentJob job;
+    job.coefficients = coefficients;
+    job.restart_interval = restart_interval;
+    job.dc_encoder = dc_encoder;
+    job.ac_encoder = ac_encoder;
+    job.segments = (BitWriter *)malloc((size_t) segment_count * sizeof(BitWriter));
+    if (job.segments == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    thread_pool_parallel_for(pool, segment_count, encode_segment_task, &job);
+
+    bitwriter_align(bw);
+    if (write_table) {
+        // Offsets follow from the segment sizes plus one marker in front of every segment but the first
+        uint32_t *offsets = (uint32_t *)malloc((size_t) segment_count * sizeof(uint32_t));
+        unsigned char *table = (unsigned char *)malloc(bin_segment_table_size(segment_count));
+        if (offsets == NULL || table == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t offset = 0;
+        for (int s = 0; s < segment_count; s++) {
+            offset += s > 0 ? 2 : 0;
+            offsets[s] = (uint32_t) offset;
+            offset += job.segments[s].out_position;
+        }
+        serialize_segment_table(table, offsets, segment_count);
+        bitwriter_write_bytes(bw, table, bin_segment_table_size(segment_count));
+        free(table);
+        free(offsets);
+    }
+    for (int s = 0; s < segment_count; s++) {
+        if (s > 0) {
+            write_restart_marker(bw, s);
+        }
+        bitwriter_write_bytes(bw, job.segments[s].out_buffer, job.segments[s].out_position);
+        free(job.segments[s].out_buffer);
+    }
+    free(job.segments);
+}
+
+/**
+ * @brief Entropy decodes every restart interval of an interleaved file across the pool
+ *
+ * The segment table gives the start of each interval, so they are decoded
+ * independently, each by whichever thread picks it up. The marker in front
+ * of every interval is checked first.
+ *
+ * @param pool Worker threads
+ * @param decoder Lookup-table Huffman decoder, shared read-only
+ * @param bitstream First byte after the segment table
+ * @param size Bytes of bitstream
+ * @param offsets Validated segment offsets, from parse_segment_table
+ * @param coefficients Destination planes, MCU-order geometry
+ * @param restart_interval MCUs per interval, at least 1
+ * @return 0 on success, -1 if a restart marker is missing
+ */
+int decode_restart_segments(ThreadPool *pool, const HuffmanDecoder *decoder, const uint8_t *bitstream,
+                            size_t size, const uint32_t *offsets, CoefficientBuffer *coefficients,
+                            int restart_interval) {
+    SegmentReadJob job;
+    job.decoder = decoder;
+    job.bitstream = bitstream;
+    job.size = size;
+    job.offsets = offsets;
+    job.coefficients = coefficients;
+    job.restart_interval = restart_interval;
+    job.segment_count = bin_segment_count(mcu_total(coefficients), restart_interval);
+
+    for (int s = 1; s < job.segment_count; s++) {
+        unsigned int marker = ((unsigned int) bitstream[offsets[s] - 2] << 8) | bitstream[offsets[s] - 1];
+        if (marker != bin_restart_marker(s)) {
+            return -1;
+        }
+    }
+
+    thread_pool_parallel_for(pool, job.segment_count, decode_segment_task, &job);
+    return 0;
+}
+
+/**
+ * @brief Writes a segment table: the count, then every offset, little-endian
+ *
+ * @param out Destination, bin_segment_table_size(segment_count) bytes
+ * @param offsets Byte offset of every segment from the start of the bitstream
+ * @param segment_count Number of segments
+ */
+void serialize_segment_table(unsigned char *out, const uint32_t *offsets, int segment_count) {
+    for (int s = -1; s < segment_count; s++) {
+        uint32_t value = s < 0 ? (uint32_t) segment_count : offsets[s];
+        for (int k = 0; k < BIN_SEGMENT_ENTRY_SIZE; k++) {
+            *out++ = (unsigned char) (value >> (8 * k));
+        }
+    }
+}
+
+/**
+ * @brief Fills in a segment table reserved earlier in a file, then returns to the end of the file
+ *
+ * For encoders writing front to back, which only know the offsets once the
+ * last interval is out.
+ *
+ * @param file Output file, seekable
+ * @param position File position of the reserved table
+ * @param offsets Byte offset of every segment from the start of the bitstream
+ * @param segment_count Number of segments
+ * @return 0 on success, -1 if the file cannot be repositioned or written
+ */
+int write_segment_table_at(FILE *file, long position, const uint32_t *offsets, int segment_count) {
+    size_t size = bin_segment_table_size(segment_count);
+    unsigned char *table = (unsigned char *)malloc(size);
+    if (table == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    serialize_segment_table(table, offsets, segment_count);
+    int status = 0;
+    if (fseek(file, position, SEEK_SET) != 0 || fwrite(table, 1, size, file) != size ||
+        fseek(file, 0, SEEK_END) != 0) {
+        status = -1;
+    }
+    free(table);
+    return status;
+}
+
+/**
+ * @brief Reads and validates a segment table
+ *
+ * The first offset must be 0 and each later one must leave room for the
+ * marker in front of it, stay in increasing order and inside the bitstream.
+ *
+ * @param table First byte of the table, at OffBits
+ * @param available Bytes from table to the end of the file
+ * @param segment_count Number of segments the image geometry implies
+ * @param bitstream_size Bytes of bitstream after the table
+ * @param offsets Output, segment_count entries
+ * @return 0 on success, -1 if the table is truncated or inconsistent
+ */
+int parse_segment_table(const uint8_t *table, size_t available, int segment_count, size_t bitstream_size,
+                        uint32_t *offsets) {
+    if (available < bin_segment_table_size(segment_count)) {
+        return -1;
+    }
+    for (int s = -1; s < segment_count; s++) {
+        uint32_t value = 0;
+        for (int k = 0; k < BIN_SEGMENT_ENTRY_SIZE; k++) {
+            value |= (uint32_t) table[(s + 1) * BIN_SEGMENT_ENTRY_SIZE + k] << (8 * k);
+        }
+        if (s < 0) {
+            if (value != (uint32_t) segment_count) {
+                return -1;
+            }
+            continue;
+        }
+        uint32_t minimum = s == 0 ? 0 : offsets[s - 1] + 2;
+        if ((s == 0 && value != 0) || value < minimum || value > bitstream_size) {
+            return -1;
+        }
+        offsets[s] = value;
+    }
+    return 0;
+}
+
+/**
+ * @brief Pads to a byte boundary and writes the marker in front of restart interval k
+ *
+ * @param bw Destination bit writer
+ * @param interval Index of the interval that follows, at least 1
+ */
+void write_restart_marker(BitWriter *bw, int interval) {
+    bitwriter_align(bw);
+    bitwriter_write_code(bw, bin_restart_marker(interval), 16);
+}
+
+/**
+ * @brief Skips to the next byte boundary and consumes the marker in front of restart interval k
+ *
+ * @param br Source bit reader, at the end of interval k - 1
+ * @param interval Index of the interval that follows, at least 1
+ * @return 0 if the expected marker was found, -1 otherwise
+ */
+int read_restart_marker(BitReader *br, int interval) {
+    bitreader_align(br);
+    int marker = bitreader_read_bits(br, 16);
+    return marker == (int) bin_restart_marker(interval) ? 0 : -1;
+}
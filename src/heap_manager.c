@@ -2,6 +2,138 @@
 #include <stdio.h>
 #include "heap_manager.h"
 
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t capacity; // Usable bytes after the header
+    size_t used;
+};
+
+// Header size rounded up so the payload keeps ARENA_ALIGNMENT
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static unsigned char *arena_block_data(ArenaBlock *block) {
+    return (unsigned char *)block + ARENA_HEADER_SIZE;
+}
+
+static ArenaBlock *arena_new_block(size_t capacity) {
+    ArenaBlock *block = (ArenaBlock *)malloc(ARENA_HEADER_SIZE + capacity);
+    if (block == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+/**
+ * @brief Initializes an empty arena
+ *
+ * No memory is taken until the first allocation.
+ *
+ * @param arena Arena to initialize
+ * @param block_size Capacity of each block; 0 selects ARENA_DEFAULT_BLOCK_SIZE
+ */
+void arena_init(Arena *arena, size_t block_size) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+}
+
+/**
+ * @brief Allocates memory from an arena
+ *
+ * The memory is ARENA_ALIGNMENT-aligned and uninitialized. It is never freed
+ * individually, only by arena_release, arena_reset or arena_destroy. Blocks
+ * released earlier are reused before new ones are requested from malloc.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes
+ * @return Pointer to the allocated memory
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    if (arena->current == NULL) {
+        if (arena->first == NULL) {
+            arena->first = arena_new_block(size > arena->block_size ? size : arena->block_size);
+        }
+        arena->current = arena->first;
+        arena->current->used = 0;
+    }
+
+    ArenaBlock *block = arena->current;
+    if (block->capacity - block->used < size) {
+        if (block->next != NULL && block->next->capacity >= size) {
+            block = block->next;
+        } else {
+            // Insert a fresh block after the current one, keeping the rest of the chain
+            ArenaBlock *fresh = arena_new_block(size > arena->block_size ? size : arena->block_size);
+            fresh->next = block->next;
+            block->next = fresh;
+            block = fresh;
+        }
+        block->used = 0;
+        arena->current = block;
+    }
+
+    void *memory = arena_block_data(block) + block->used;
+    block->used += size;
+    return memory;
+}
+
+/**
+ * @brief Records the current position of an arena
+ *
+ * @param arena Arena to query
+ * @return Mark to pass to arena_release
+ */
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark;
+    mark.block = arena->current;
+    mark.used = arena->current != NULL ? arena->current->used : 0;
+    return mark;
+}
+
+/**
+ * @brief Releases everything allocated after a mark
+ *
+ * @param arena Arena the mark was taken from
+ * @param mark Position returned by arena_mark
+ */
+void arena_release(Arena *arena, ArenaMark mark) {
+    arena->current = mark.block;
+    if (mark.block != NULL) {
+        mark.block->used = mark.used;
+    }
+}
+
+/**
+ * @brief Releases every allocation of an arena, keeping its blocks for reuse
+ *
+ * @param arena Arena to reset
+ */
+void arena_reset(Arena *arena) {
+    arena->current = NULL;
+}
+
+/**
+ * @brief Frees all memory owned by an arena
+ *
+ * @param arena Arena to destroy, left empty and reusable
+ */
+void arena_destroy(Arena *arena) {
+    ArenaBlock *block = arena->first;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
 /**
  * @brief Initializes a 2D array of integers
  *
@@ -33,6 +165,30 @@ int **init_int_matrix(int rows, int cols){
     return matrix;
 }
 
+/**
+ * @brief Initializes a 2D array of int values in an arena
+ *
+ * The row table and all rows come from the arena, rows contiguous in memory.
+ * Falls back to init_int_matrix when arena is NULL.
+ *
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param rows Number of rows in the matrix
+ * @param cols Number of columns in the matrix
+ * @return Pointer to the allocated 2D int array
+ */
+int **init_int_matrix_arena(Arena *arena, int rows, int cols) {
+    if (arena == NULL) {
+        return init_int_matrix(rows, cols);
+    }
+    int **matrix = (int **)arena_alloc(arena, rows * sizeof(int *));
+    int *data = (int *)arena_alloc(arena, (size_t) rows * cols * sizeof(int));
+    for (int i = 0; i < rows; i++) {
+        matrix[i] = data + (size_t) i * cols;
+    }
+
+    return matrix;
+}
+
 /**
  * @brief Frees the memory allocated for a 2D integer array
  *
@@ -49,6 +205,22 @@ void free_int_matrix(int **matrix, int rows){
     matrix = NULL;
 }
 
+/**
+ * @brief Frees a matrix from init_int_matrix_arena
+ *
+ * Arena memory is only reclaimed by releasing the arena, so this does
+ * nothing unless arena is NULL.
+ *
+ * @param arena Arena the matrix came from, or NULL for the heap
+ * @param matrix Pointer to the 2D int array to be freed
+ * @param rows Number of rows in the matrix
+ */
+void free_int_matrix_arena(Arena *arena, int **matrix, int rows) {
+    if (arena == NULL) {
+        free_int_matrix(matrix, rows);
+    }
+}
+
 /**
  * @brief Initializes a 2D array of double values
  *
@@ -80,6 +252,30 @@ double **init_double_matrix(int rows, int cols) {
     return matrix;
 }
 
+/**
+ * @brief Initializes a 2D array of double values in an arena
+ *
+ * The row table and all rows come from the arena, rows contiguous in memory.
+ * Falls back to init_double_matrix when arena is NULL.
+ *
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param rows Number of rows in the matrix
+ * @param cols Number of columns in the matrix
+ * @return Pointer to the allocated 2D double array
+ */
+double **init_double_matrix_arena(Arena *arena, int rows, int cols) {
+    if (arena == NULL) {
+        return init_double_matrix(rows, cols);
+    }
+    double **matrix = (double **)arena_alloc(arena, rows * sizeof(double *));
+    double *data = (double *)arena_alloc(arena, (size_t) rows * cols * sizeof(double));
+    for (int i = 0; i < rows; i++) {
+        matrix[i] = data + (size_t) i * cols;
+    }
+
+    return matrix;
+}
+
 /**
  * @brief Frees the memory allocated for a 2D double array
  *
@@ -96,6 +292,22 @@ void free_double_matrix(double **matrix, int rows) {
     matrix = NULL;
 }
 
+/**
+ * @brief Frees a matrix from init_double_matrix_arena
+ *
+ * Arena memory is only reclaimed by releasing the arena, so this does
+ * nothing unless arena is NULL.
+ *
+ * @param arena Arena the matrix came from, or NULL for the heap
+ * @param matrix Pointer to the 2D double array to be freed
+ * @param rows Number of rows in the matrix
+ */
+void free_double_matrix_arena(Arena *arena, double **matrix, int rows) {
+    if (arena == NULL) {
+        free_double_matrix(matrix, rows);
+    }
+}
+
 /**
  * @brief Initializes a 2D array of unsigned char values
  *
@@ -127,6 +339,30 @@ unsigned char **init_uchar_matrix(int rows, int cols) {
     return matrix;
 }
 
+/**
+ * @brief Initializes a 2D array of unsigned char values in an arena
+ *
+ * The row table and all rows come from the arena, rows contiguous in memory.
+ * Falls back to init_uchar_matrix when arena is NULL.
+ *
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param rows Number of rows in the matrix
+ * @param cols Number of columns in the matrix
+ * @return Pointer to the allocated 2D unsigned char array
+ */
+unsigned char **init_uchar_matrix_arena(Arena *arena, int rows, int cols) {
+    if (arena == NULL) {
+        return init_uchar_matrix(rows, cols);
+    }
+    unsigned char **matrix = (unsigned char **)arena_alloc(arena, rows * sizeof(unsigned char *));
+    unsigned char *data = (unsigned char *)arena_alloc(arena, (size_t) rows * cols * sizeof(unsigned char));
+    for (int i = 0; i < rows; i++) {
+        matrix[i] = data + (size_t) i * cols;
+    }
+
+    return matrix;
+}
+
 /**
  * @brief Frees the memory allocated for a 2D unsigned char array
  *
@@ -143,6 +379,22 @@ void free_uchar_matrix(unsigned char **matrix, int rows) {
     matrix = NULL;
 }
 
+/**
+ * @brief Frees a matrix from init_uchar_matrix_arena
+ *
+ * Arena memory is only reclaimed by releasing the arena, so this does
+ * nothing unless arena is NULL.
+ *
+ * @param arena Arena the matrix came from, or NULL for the heap
+ * @param matrix Pointer to the 2D unsigned char array to be freed
+ * @param rows Number of rows in the matrix
+ */
+void free_uchar_matrix_arena(Arena *arena, unsigned char **matrix, int rows) {
+    if (arena == NULL) {
+        free_uchar_matrix(matrix, rows);
+    }
+}
+
 /**
  * @brief Initializes a 1D array of int values
  *
@@ -161,6 +413,22 @@ int *init_int_array(int size) {
     return array;
 }
 
+/**
+ * @brief Initializes a 1D array of int values in an arena
+ *
+ * Falls back to init_int_array when arena is NULL.
+ *
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param size Size of the array
+ * @return Pointer to the allocated 1D int array
+ */
+int *init_int_array_arena(Arena *arena, int size) {
+    if (arena == NULL) {
+        return init_int_array(size);
+    }
+    return (int *)arena_alloc(arena, size * sizeof(int));
+}
+
 /**
  * @brief Frees the memory allocated for a matrix of double matrices
  * 
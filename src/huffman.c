@@ -28,6 +28,40 @@ const char* huffman_dc_prefix[MAX_CATEGORY] = {
     "1110", "11110", "111110", "1111110", "11111110", "111111110"
 };
 
+/**
+ * @brief Precomputed (code bits, code length) form of huffman_ac_prefix
+ *
+ * Each entry holds the same code as the string table, right-aligned in an
+ * integer, so the encoder can emit it with a single bitwriter_write_code call.
+ * Entries whose string prefix is NULL have length 0.
+ */
+const HuffmanCode huffman_ac_codes[MAX_RUN][MAX_CATEGORY] = {
+    {{0x000A, 4}, {0x0000, 2}, {0x0001, 2}, {0x0004, 3}, {0x000B, 4}, {0x001A, 5}, {0x0038, 6}, {0x0078, 7}, {0x03F6, 10}, {0xFF82, 16}, {0xFF83, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x000C, 4}, {0x0039, 6}, {0x0079, 7}, {0x01F6, 9}, {0x07F6, 11}, {0xFF84, 16}, {0xFF85, 16}, {0xFF86, 16}, {0xFF87, 16}, {0xFF88, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x001B, 5}, {0x00F8, 8}, {0x03F7, 10}, {0xFF89, 16}, {0xFF8A, 16}, {0xFF8B, 16}, {0xFF8C, 16}, {0xFF8D, 16}, {0xFF8E, 16}, {0xFF8F, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x003A, 6}, {0x01F7, 9}, {0x07F7, 11}, {0xFF90, 16}, {0xFF91, 16}, {0xFF92, 16}, {0xFF93, 16}, {0xFF94, 16}, {0xFF95, 16}, {0xFF96, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x003B, 6}, {0x03F8, 10}, {0xFF97, 16}, {0xFF98, 16}, {0xFF99, 16}, {0xFF9A, 16}, {0xFF9B, 16}, {0xFF9C, 16}, {0xFF9D, 16}, {0xFF9E, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x007A, 7}, {0x03F9, 10}, {0xFF9F, 16}, {0xFFA0, 16}, {0xFFA1, 16}, {0xFFA2, 16}, {0xFFA3, 16}, {0xFFA4, 16}, {0xFFA5, 16}, {0xFFA6, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x007B, 7}, {0x07F8, 11}, {0xFFA7, 16}, {0xFFA8, 16}, {0xFFA9, 16}, {0xFFAA, 16}, {0xFFAB, 16}, {0xFFAC, 16}, {0xFFAD, 16}, {0xFFAE, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x00F9, 8}, {0x07F9, 11}, {0xFFAF, 16}, {0xFFB0, 16}, {0xFFB1, 16}, {0xFFB2, 16}, {0xFFB3, 16}, {0xFFB4, 16}, {0xFFB5, 16}, {0xFFB6, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x00FA, 8}, {0x7FC0, 15}, {0xFFB7, 16}, {0xFFB8, 16}, {0xFFB9, 16}, {0xFFBA, 16}, {0xFFBB, 16}, {0xFFBC, 16}, {0xFFBD, 16}, {0xFFBE, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x01F8, 9}, {0xFFBF, 16}, {0xFFC0, 16}, {0xFFC1, 16}, {0xFFC2, 16}, {0xFFC3, 16}, {0xFFC4, 16}, {0xFFC5, 16}, {0xFFC6, 16}, {0xFFC7, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x01F9, 9}, {0xFFC8, 16}, {0xFFC9, 16}, {0xFFCA, 16}, {0xFFCB, 16}, {0xFFCC, 16}, {0xFFCD, 16}, {0xFFCE, 16}, {0xFFCF, 16}, {0xFFD0, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x01FA, 9}, {0xFFD1, 16}, {0xFFD2, 16}, {0xFFD3, 16}, {0xFFD4, 16}, {0xFFD5, 16}, {0xFFD6, 16}, {0xFFD7, 16}, {0xFFD8, 16}, {0xFFD9, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x03FA, 10}, {0xFFDA, 16}, {0xFFDB, 16}, {0xFFDC, 16}, {0xFFDD, 16}, {0xFFDE, 16}, {0xFFDF, 16}, {0xFFE0, 16}, {0xFFE1, 16}, {0xFFE2, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x07FA, 11}, {0xFFE3, 16}, {0xFFE4, 16}, {0xFFE5, 16}, {0xFFE6, 16}, {0xFFE7, 16}, {0xFFE8, 16}, {0xFFE9, 16}, {0xFFEA, 16}, {0xFFEB, 16}, {0x0000, 0}},
+    {{0x0000, 0}, {0x0FF6, 12}, {0xFFEC, 16}, {0xFFED, 16}, {0xFFEE, 16}, {0xFFEF, 16}, {0xFFF0, 16}, {0xFFF1, 16}, {0xFFF2, 16}, {0xFFF3, 16}, {0xFFF4, 16}, {0x0000, 0}},
+    {{0x0FF7, 12}, {0xFFF5, 16}, {0xFFF6, 16}, {0xFFF7, 16}, {0xFFF8, 16}, {0xFFF9, 16}, {0xFFFA, 16}, {0xFFFB, 16}, {0xFFFC, 16}, {0xFFFD, 16}, {0xFFFE, 16}, {0xFFFF, 16}}
+};
+
+/**
+ * @brief Precomputed (code bits, code length) form of huffman_dc_prefix
+ */
+const HuffmanCode huffman_dc_codes[MAX_CATEGORY] = {
+    {0x0002, 3}, {0x0003, 3}, {0x0004, 3}, {0x0000, 2}, {0x0005, 3}, {0x0006, 3},
+    {0x000E, 4}, {0x001E, 5}, {0x003E, 6}, {0x007E, 7}, {0x00FE, 8}, {0x01FE, 9}
+};
+
 Huffman_node *create_huffman_tree() {
     Huffman_node *root = (Huffman_node *)malloc(sizeof(Huffman_node));
     root->run = 0;
@@ -91,10 +125,11 @@ Huffman_node *read_ac_category(Huffman_node *huffman_tree, BitReader *br) {
         } else if (bit == 1) {
             current = current->right;
         }
+        if (bit == -1 || current == NULL) {
+            return NULL; // Invalid prefix or end of stream
+        }
         if (current->is_leaf) {
             return current;
-        }else if (current == NULL) {
-            return NULL; // Invalid prefix
         }
     }
 }
@@ -125,6 +160,9 @@ int read_dc_category(BitReader *br) {
 }
 
 int decode_value(int mantissa, int size) {
+    if (size <= 0) {
+        return 0;
+    }
     // Se o bit mais significativo da mantissa for 0, o valor é negativo
     if (mantissa < (1 << (size - 1))) {
         int mask = (1 << size) - 1; // Máscara para o tamanho da categoria
@@ -148,4 +186,210 @@ int get_category(int value) {
     else if (abs_value <= 1023) return 10;
     else if (abs_value <= 2047) return 11;
     else return -1;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Frees a Huffman tree created by create_huffman_tree
+ *
+ * @param node Root of the (sub)tree to free
+ */
+void free_huffman_tree(Huffman_node *node) {
+    if (node == NULL) {
+        return;
+    }
+    if (!node->is_leaf) {
+        free_huffman_tree(node->left);
+        free_huffman_tree(node->right);
+    }
+    free(node);
+}
+
+/**
+ * @brief Fills every lookup entry whose first bits match the given code
+ *
+ * Entries for which the mantissa also fits in HUFFMAN_LOOKUP_BITS get the
+ * decoded value and the total length, so the decoder can consume the whole
+ * symbol with a single lookup.
+ */
+static void fill_lookup_entries(HuffmanLookupEntry *table, HuffmanCode code, int run, int category) {
+    int free_bits = HUFFMAN_LOOKUP_BITS - code.length;
+    int base = code.code << free_bits;
+
+    for (int k = 0; k < (1 << free_bits); k++) {
+        HuffmanLookupEntry *entry = &table[base + k];
+        entry->run = (uint8_t)run;
+        entry->category = (uint8_t)category;
+        entry->code_length = code.length;
+        entry->value = 0;
+        entry->total_length = 0;
+        if (category <= free_bits) {
+            int mantissa = (k >> (free_bits - category)) & ((1 << category) - 1);
+            entry->value = (int16_t)decode_value(mantissa, category);
+            entry->total_length = (uint8_t)(code.length + category);
+        }
+    }
+}
+
+/**
+ * @brief Creates the lookup-table Huffman decoder
+ *
+ * Builds HUFFMAN_LOOKUP_BITS-wide lookup tables for the AC and DC codes from
+ * huffman_ac_codes and huffman_dc_codes. Longer AC codes are left unresolved
+ * in the table and decoded through the Huffman tree instead.
+ *
+ * @return Pointer to the allocated decoder, to be released with free_huffman_decoder
+ */
+HuffmanDecoder *create_huffman_decoder() {
+    HuffmanDecoder *decoder = (HuffmanDecoder *)calloc(1, sizeof(HuffmanDecoder));
+    if (decoder == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < MAX_RUN; i++) {
+        for (int j = 0; j < MAX_CATEGORY; j++) {
+            HuffmanCode code = huffman_ac_codes[i][j];
+            if (code.length > 0 && code.length <= HUFFMAN_LOOKUP_BITS) {
+                fill_lookup_entries(decoder->ac_lookup, code, i, j);
+            }
+        }
+    }
+
+    for (int j = 0; j < MAX_CATEGORY; j++) {
+        fill_lookup_entries(decoder->dc_lookup, huffman_dc_codes[j], 0, j);
+    }
+
+    decoder->ac_tree = create_huffman_tree();
+
+    return decoder;
+}
+
+/**
+ * @brief Frees a decoder created by create_huffman_decoder
+ *
+ * @param decoder Decoder to free
+ */
+void free_huffman_decoder(HuffmanDecoder *decoder) {
+    if (decoder == NULL) {
+        return;
+    }
+    free_huffman_tree(decoder->ac_tree);
+    free(decoder);
+}
+
+/**
+ * @brief Decodes a DC difference (category code + mantissa)
+ *
+ * @param decoder Lookup-table decoder
+ * @param br BitReader positioned at the DC code
+ * @param diff Output DC difference
+ * @return 0 on success, -1 on invalid code or end of stream
+ */
+int decode_dc_difference(const HuffmanDecoder *decoder, BitReader *br, int *diff) {
+    const HuffmanLookupEntry *entry = &decoder->dc_lookup[bitreader_peek_bits(br, HUFFMAN_LOOKUP_BITS)];
+
+    if (entry->total_length > 0) {
+        bitreader_skip_bits(br, entry->total_length);
+        *diff = entry->value;
+        return 0;
+    }
+    if (entry->code_length == 0) {
+        return -1;
+    }
+
+    bitreader_skip_bits(br, entry->code_length);
+    int mantissa = bitreader_read_bits(br, entry->category);
+    if (mantissa < 0) {
+        return -1;
+    }
+    *diff = decode_value(mantissa, entry->category);
+    return 0;
+}
+
+/**
+ * @brief Decodes one AC symbol (run/category code + mantissa)
+ *
+ * EOB is returned as run 0 with category 0 and ZRL as run 15 with category 0.
+ *
+ * @param decoder Lookup-table decoder
+ * @param br BitReader positioned at the AC code
+ * @param run Output zero run preceding the coefficient
+ * @param value Output coefficient value
+ * @return Category of the symbol, or -1 on invalid code or end of stream
+ */
+int decode_ac_symbol(const HuffmanDecoder *decoder, BitReader *br, int *run, int *value) {
+    const HuffmanLookupEntry *entry = &decoder->ac_lookup[bitreader_peek_bits(br, HUFFMAN_LOOKUP_BITS)];
+
+    if (entry->total_length > 0) {
+        bitreader_skip_bits(br, entry->total_length);
+        *run = entry->run;
+        *value = entry->value;
+        return entry->category;
+    }
+
+    int category;
+    if (entry->code_length > 0) {
+        bitreader_skip_bits(br, entry->code_length);
+        *run = entry->run;
+        category = entry->category;
+    } else {
+        // Slow path: code longer than the lookup, walk the tree
+        Huffman_node *node = read_ac_category(decoder->ac_tree, br);
+        if (node == NULL) {
+            return -1;
+        }
+        *run = node->run;
+        category = node->category;
+    }
+
+    int mantissa = bitreader_read_bits(br, category);
+    if (mantissa < 0) {
+        return -1;
+    }
+    *value = decode_value(mantissa, category);
+    return category;
+}
+
+/**
+ * @brief Decodes a whole zigzag-ordered block with the lookup-table decoder
+ *
+ * The block is zero filled, the DC coefficient is reconstructed from the
+ * difference and *previous_dc is updated.
+ *
+ * @param decoder Lookup-table decoder
+ * @param br BitReader positioned at the start of the block
+ * @param previous_dc DC predictor of the component, updated in place
+ * @param block Output array of 64 zigzag-ordered coefficients
+ * @return 0 on success, -1 on invalid code or end of stream
+ */
+int decode_block(const HuffmanDecoder *decoder, BitReader *br, int *previous_dc, int block[64]) {
+    int diff;
+
+    for (int i = 0; i < 64; i++) {
+        block[i] = 0;
+    }
+
+    if (decode_dc_difference(decoder, br, &diff) != 0) {
+        return -1;
+    }
+    *previous_dc += diff;
+    block[0] = *previous_dc;
+
+    int pos = 1;
+    while (pos < 64) {
+        int run, value;
+        int category = decode_ac_symbol(decoder, br, &run, &value);
+        if (category < 0) {
+            return -1;
+        }
+        if (run == 0 && category == 0) {
+            break; // EOB
+        }
+        pos += run;
+        if (pos < 64) {
+            block[pos++] = value;
+        }
+    }
+
+    return 0;
+}
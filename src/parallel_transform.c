@@ -0,0 +1,110 @@
+#include "parallel_transform.h"
+#include "bin_format.h"
+
+// Shared, read-only state of one transform loop; tasks write disjoint block rows
+typedef struct {
+    PlanarImage *image;
+    CoefficientBuffer *coefficients;
+    const BlockKernel *kernels;
+} TransformJob;
+
+/**
+ * @brief Forward transforms block rows [first, last) of one component
+ */
+static void forward_block_rows(const ImagePlane *image, CoefficientPlane *plane, const BlockKernel *kernel,
+                               int first, int last) {
+    if (last > plane->block_rows) {
+        last = plane->block_rows;
+    }
+    for (int i = first; i < last; i++) {
+        const unsigned char *row = image_plane_row(image, i * DCT_BLOCK_SIZE);
+        for (int j = 0; j < plane->block_cols; j++) {
+            forward_block_kernel(kernel, row + j * DCT_BLOCK_SIZE, image->stride, coefficient_block(plane, i, j));
+        }
+    }
+}
+
+/**
+ * @brief Inverse transforms block rows [first, last) of one component
+ */
+static void inverse_block_rows(const CoefficientPlane *plane, ImagePlane *image, const BlockKernel *kernel,
+                               int first, int last) {
+    if (last > plane->block_rows) {
+        last = plane->block_rows;
+    }
+    for (int i = first; i < last; i++) {
+        unsigned char *row = image_plane_row(image, i * DCT_BLOCK_SIZE);
+        for (int j = 0; j < plane->block_cols; j++) {
+            inverse_block_kernel(kernel, coefficient_block(plane, i, j), row + j * DCT_BLOCK_SIZE, image->stride);
+        }
+    }
+}
+
+/**
+ * @brief Task: forward transform of MCU row index, two Y block rows and one of Cb and Cr
+ */
+static void forward_mcu_row(void *context, int index) {
+    TransformJob *job = (TransformJob *) context;
+    int first_luma = index * MCU_LUMA_BLOCKS;
+
+    forward_block_rows(&job->image->planes[0], &job->coefficients->y, &job->kernels[LUMINANCE],
+                       first_luma, first_luma + MCU_LUMA_BLOCKS);
+    forward_block_rows(&job->image->planes[1], &job->coefficients->cb, &job->kernels[CHROMINANCE], index, index + 1);
+    forward_block_rows(&job->image->planes[2], &job->coefficients->cr, &job->kernels[CHROMINANCE], index, index + 1);
+}
+
+/**
+ * @brief Task: inverse transform of MCU row index
+ */
+static void inverse_mcu_row(void *context, int index) {
+    TransformJob *job = (TransformJob *) context;
+    int first_luma = index * MCU_LUMA_BLOCKS;
+
+    inverse_block_rows(&job->coefficients->y, &job->image->planes[0], &job->kernels[LUMINANCE],
+                       first_luma, first_luma + MCU_LUMA_BLOCKS);
+    inverse_block_rows(&job->coefficients->cb, &job->image->planes[1], &job->kernels[CHROMINANCE], index, index + 1);
+    inverse_block_rows(&job->coefficients->cr, &job->image->planes[2], &job->kernels[CHROMINANCE], index, index + 1);
+}
+
+/**
+ * @brief DCT, quantization and zigzag scan of a 4:2:0 image, MCU rows spread across the pool
+ *
+ * Every block is transformed by the same kernel as the single-threaded
+ * path and lands in its own slot, so the result does not depend on the
+ * number of threads.
+ *
+ * @param pool Worker threads
+ * @param image Y, Cb and Cr planes
+ * @param coefficients Destination, sized to the planes in whole blocks
+ * @param kernels Forward kernels, indexed by QuantizationType
+ */
+void parallel_forward_transform(ThreadPool *pool, const PlanarImage *image, CoefficientBuffer *coefficients,
+                                const BlockKernel kernels[2]) {
+    TransformJob job;
+    job.image = (PlanarImage *) image;
+    job.coefficients = coefficients;
+    job.kernels = kernels;
+
+    // Resolve the SIMD dispatch before the workers race to do it
+    dct_simd_init();
+    thread_pool_parallel_for(pool, mcu_count(coefficients->y.block_rows), forward_mcu_row, &job);
+}
+
+/**
+ * @brief Dequantization and IDCT of all blocks into 4:2:0 planes, MCU rows spread across the pool
+ *
+ * @param pool Worker threads
+ * @param coefficients Zigzag-ordered quantized blocks
+ * @param image Destination planes, at least the size of the buffer in whole blocks
+ * @param kernels Inverse kernels, indexed by QuantizationType
+ */
+void parallel_inverse_transform(ThreadPool *pool, const CoefficientBuffer *coefficients, PlanarImage *image,
+                                const BlockKernel kernels[2]) {
+    TransformJob job;
+    job.image = image;
+    job.coefficients = (CoefficientBuffer *) coefficients;
+    job.kernels = kernels;
+
+    dct_simd_init();
+    thread_pool_parallel_for(pool, mcu_count(coefficients->y.block_rows), inverse_mcu_row, &job);
+}
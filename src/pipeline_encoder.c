@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "pipeline_encoder.h"
+#include "block_kernel.h"
+#include "bounded_queue.h"
+#include "coefficients.h"
+#include "color_convert.h"
+#include "entropy_segments.h"
+#include "planar_image.h"
+#include "stream_encoder.h"
+
+// One MCU row on its way through the pipeline: source rows in, coefficients out
+typedef struct {
+    int index;        // MCU row, also the strip of STREAM_MCU_ROWS source rows it is built from
+    int rows;         // Source rows present, fewer than STREAM_MCU_ROWS at the bottom
+    unsigned char *bgr;
+    int16_t *y;       // MCU_LUMA_BLOCKS block rows of luma_block_cols blocks
+    int16_t *cb, *cr; // One block row of chroma_block_cols blocks
+} PipelineStrip;
+
+// State shared by the reader, the transform workers and the writer
+typedef struct {
+    int height, width, row_stride;
+    int chroma_height, chroma_width;     // Padded 4:2:0 geometry, as StreamEncoder
+    int luma_block_rows, luma_block_cols;
+    int chroma_block_rows, chroma_block_cols;
+    int fixed_point;
+    BlockKernel kernels[2];              // Indexed by QuantizationType, read-only once the threads start
+
+    FILE *input;
+    unsigned char *cb_edge, *cr_edge;    // Right padding of each chroma row, written by the reader ahead of use
+    int truncated;                       // Set by the reader, read after it is joined
+
+    BoundedQueue free_strips;            // Writer -> reader
+    BoundedQueue work;                   // Reader -> workers, a NULL per worker ends the stream
+    BoundedQueue done;                   // Workers -> writer, in any order
+} Pipeline;
+
+/**
+ * @brief Converts one BGR row with the color conversion the pipeline was set up with
+ */
+static void pipeline_convert_row(const Pipeline *pipeline, const unsigned char *bgr, unsigned char *y,
+                                 unsigned char *cb, unsigned char *cr, int width) {
+    if (pipeline->fixed_point) {
+        bgr_row_to_ycbcr_fixed(bgr, y, cb, cr, width);
+    } else {
+        bgr_row_to_ycbcr(bgr, y, cb, cr, width);
+    }
+}
+
+/**
+ * @brief Reader thread: fills free strips with source rows in stored order
+ *
+ * Also records the right padding of the chroma rows, which can come from a
+ * source row in an earlier strip than the one that needs it.
+ */
+static void *pipeline_reader(void *argument) {
+    Pipeline *pipeline = (Pipeline *) argument;
+    unsigned char edge_y, edge_cb, edge_cr;
+
+    for (int s = 0; s < pipeline->chroma_block_rows; s++) {
+        PipelineStrip *strip = (PipelineStrip *) bounded_queue_pop(&pipeline->free_strips);
+        int first = s * STREAM_MCU_ROWS;
+        int rows = pipeline->height - first < STREAM_MCU_ROWS ? pipeline->height - first : STREAM_MCU_ROWS;
+        if (read_bmp_rows(pipeline->input, strip->bgr, pipeline->row_stride, rows)) {
+            pipeline->truncated = 1;
+        }
+
+        if (pipeline->cb_edge != NULL) {
+            for (int k = 0; k < rows && first + k < pipeline->height / 2; k++) {
+                const unsigned char *last = strip->bgr + (size_t) k * pipeline->row_stride + 3 * (pipeline->width - 1);
+                pipeline_convert_row(pipeline, last, &edge_y, &edge_cb, &edge_cr, 1);
+                pipeline->cb_edge[first + k] = edge_cb;
+                pipeline->cr_edge[first + k] = edge_cr;
+            }
+        }
+
+        strip->index = s;
+        strip->rows = rows;
+        bounded_queue_push(&pipeline->work, strip);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Subsamples the eight chroma rows of MCU row s from its converted source rows
+ */
+static void pipeline_subsample(const Pipeline *pipeline, int s, const ImagePlane *full, const unsigned char *edges,
+                               ImagePlane *out) {
+    for (int p = 0; p < DCT_BLOCK_SIZE; p++) {
+        int c = s * DCT_BLOCK_SIZE + p;
+        // Bottom padding rows come from the last source row, which is in this strip
+        int first = c < pipeline->height / 2 ? 2 * p : pipeline->height - 1 - s * STREAM_MCU_ROWS;
+        const unsigned char *row1 = c < pipeline->height / 2 ? image_plane_row(full, 2 * p + 1) : NULL;
+        subsample_chroma_row(image_plane_row(full, first), row1, c, pipeline->height, pipeline->width, edges,
+                             image_plane_row(out, p), pipeline->chroma_width);
+    }
+}
+
+/**
+ * @brief Transform worker: color conversion, subsampling and DCT of whole strips
+ */
+static void *pipeline_worker(void *argument) {
+    Pipeline *pipeline = (Pipeline *) argument;
+    ImagePlane y = init_image_plane(STREAM_MCU_ROWS, pipeline->width);
+    ImagePlane cb = init_image_plane(STREAM_MCU_ROWS, pipeline->width);
+    ImagePlane cr = init_image_plane(STREAM_MCU_ROWS, pipeline->width);
+    ImagePlane cb_sub = init_image_plane(DCT_BLOCK_SIZE, pipeline->chroma_width);
+    ImagePlane cr_sub = init_image_plane(DCT_BLOCK_SIZE, pipeline->chroma_width);
+    PipelineStrip *strip;
+
+    while ((strip = (PipelineStrip *) bounded_queue_pop(&pipeline->work)) != NULL) {
+        int s = strip->index;
+        for (int k = 0; k < strip->rows; k++) {
+            pipeline_convert_row(pipeline, strip->bgr + (size_t) k * pipeline->row_stride,
+                                 image_plane_row(&y, k), image_plane_row(&cb, k), image_plane_row(&cr, k),
+                                 pipeline->width);
+        }
+        pipeline_subsample(pipeline, s, &cb, pipeline->cb_edge, &cb_sub);
+        pipeline_subsample(pipeline, s, &cr, pipeline->cr_edge, &cr_sub);
+
+        for (int b = 0; b < MCU_LUMA_BLOCKS; b++) {
+            if (s * MCU_LUMA_BLOCKS + b >= pipeline->luma_block_rows) {
+                break;
+            }
+            const unsigned char *row = image_plane_row(&y, b * DCT_BLOCK_SIZE);
+            for (int j = 0; j < pipeline->luma_block_cols; j++) {
+                forward_block_kernel(&pipeline->kernels[LUMINANCE], row + j * DCT_BLOCK_SIZE, y.stride,
+                                     strip->y + ((size_t) b * pipeline->luma_block_cols + j) * BLOCK_COEFFICIENTS);
+            }
+        }
+        for (int j = 0; j < pipeline->chroma_block_cols; j++) {
+            forward_block_kernel(&pipeline->kernels[CHROMINANCE], cb_sub.data + j * DCT_BLOCK_SIZE, cb_sub.stride,
+                                 strip->cb + (size_t) j * BLOCK_COEFFICIENTS);
+            forward_block_kernel(&pipeline->kernels[CHROMINANCE], cr_sub.data + j * DCT_BLOCK_SIZE, cr_sub.stride,
+                                 strip->cr + (size_t) j * BLOCK_COEFFICIENTS);
+        }
+        bounded_queue_push(&pipeline->done, strip);
+    }
+
+    free_image_plane(&y);
+    free_image_plane(&cb);
+    free_image_plane(&cr);
+    free_image_plane(&cb_sub);
+    free_image_plane(&cr_sub);
+    return NULL;
+}
+
+/**
+ * @brief Codes the MCUs of one strip in interleaved order, with restart markers
+ */
+static void pipeline_encode_strip(const Pipeline *pipeline, McuCoder *coder, const PipelineStrip *strip) {
+    int luma_rows = pipeline->luma_block_rows - strip->index * MCU_LUMA_BLOCKS;
+    if (luma_rows > MCU_LUMA_BLOCKS) {
+        luma_rows = MCU_LUMA_BLOCKS;
+    }
+    mcu_coder_encode_row(coder, strip->y, luma_rows, pipeline->luma_block_cols, strip->cb, strip->cr, 0,
+                         pipeline->chroma_block_cols);
+}
+
+/**
+ * @brief Allocates one strip buffer sized for the pipeline's geometry
+ */
+static PipelineStrip *pipeline_strip_create(const Pipeline *pipeline) {
+    PipelineStrip *strip = (PipelineStrip *)malloc(sizeof(PipelineStrip));
+    size_t luma_blocks = (size_t) MCU_LUMA_BLOCKS * pipeline->luma_block_cols;
+    size_t chroma_blocks = (size_t) pipeline->chroma_block_cols;
+    if (strip != NULL) {
+        strip->bgr = (unsigned char *)malloc((size_t) pipeline->row_stride * STREAM_MCU_ROWS + 1);
+        strip->y = (int16_t *)malloc((luma_blocks * BLOCK_COEFFICIENTS + 1) * sizeof(int16_t));
+        strip->cb = (int16_t *)malloc((chroma_blocks * BLOCK_COEFFICIENTS + 1) * sizeof(int16_t));
+        strip->cr = (int16_t *)malloc((chroma_blocks * BLOCK_COEFFICIENTS + 1) * sizeof(int16_t));
+    }
+    if (strip == NULL || strip->bgr == NULL || strip->y == NULL || strip->cb == NULL || strip->cr == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return strip;
+}
+
+/**
+ * @brief Frees a strip from pipeline_strip_create
+ */
+static void pipeline_strip_free(PipelineStrip *strip) {
+    free(strip->bgr);
+    free(strip->y);
+    free(strip->cb);
+    free(strip->cr);
+    free(strip);
+}
+
+/**
+ * @brief Writes the bitmap headers padded to OffBits and reserves the segment table, as stream_encoder_init
+ */
+static void pipeline_write_headers(BitWriter *writer, const BITMAPFILEHEADER *stored_header,
+                                   const BITMAPINFOHEADER *info_header, int segment_count) {
+    unsigned char headers[BMP_HEADERS_SIZE];
+    serialize_bmp_headers(headers, stored_header, info_header);
+    bitwriter_write_bytes(writer, headers, BMP_HEADERS_SIZE);
+    for (int i = BMP_HEADERS_SIZE; i < (int) stored_header->OffBits; i++) {
+        bitwriter_write_code(writer, 0, 8);
+    }
+    if (bin_has_segment_table(stored_header)) {
+        for (size_t i = 0; i < bin_segment_table_size(segment_count); i++) {
+            bitwriter_write_code(writer, 0, 8);
+        }
+    }
+}
+
+/**
+ * @brief Encodes a bitmap with reading, transform and entropy coding overlapped
+ *
+ * A reader thread pulls STREAM_MCU_ROWS source rows at a time into a free
+ * strip, worker_count transform threads convert, subsample and DCT whole
+ * strips, and the calling thread entropy codes them in order and writes the
+ * output. The stages hand strips to each other through bounded queues
+ * that put a waiting thread to sleep, so a slow stage stalls the ones
+ * before it instead of buffering the image; at most
+ * PIPELINE_SLOTS_PER_WORKER strips per worker plus PIPELINE_EXTRA_SLOTS
+ * are in flight.
+ *
+ * The blocks are always written in interleaved order, since the sequential
+ * order would hold back every chroma block until the last luminance block.
+ * The output is identical to the streaming encoder's with the same layout.
+ *
+ * @param input Source bitmap, positioned at the first pixel row
+ * @param file_header Bitmap file header of the source
+ * @param info_header Bitmap info header of the source, gives the image size
+ * @param output Destination file, seekable when the layout has a segment table
+ * @param method DCT implementation to use
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ * @param fixed_point Nonzero to use the fixed-point color conversion
+ * @param layout Restart interval and segment table; the order is forced to interleaved
+ * @param worker_count Transform threads, at least 1
+ * @param result Filled with the compressed size and whether the source was truncated
+ * @return 0 on success, -1 if the threads cannot be started (nothing is written)
+ * or the segment table could not be written
+ */
+int pipeline_encode_file(FILE *input, const BITMAPFILEHEADER *file_header, const BITMAPINFOHEADER *info_header,
+                         FILE *output, DCTMethod method, DCEncoder dc_encoder, ACEncoder ac_encoder,
+                         int fixed_point, const BinLayout *layout, int worker_count, PipelineResult *result) {
+    Pipeline pipeline;
+    int height = info_header->Height;
+    int width = info_header->Width;
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+
+    BinLayout interleaved_layout = *layout;
+    interleaved_layout.interleaved = 1;
+    BITMAPFILEHEADER stored_header = *file_header;
+    bin_store_layout(&stored_header, &interleaved_layout, width);
+
+    pipeline.height = height;
+    pipeline.width = width;
+    pipeline.row_stride = bmp_row_stride(width);
+    pipeline.chroma_height = (height / 2) + (height / 2) % 8;
+    pipeline.chroma_width = (width / 2) + (width / 2) % 8;
+    pipeline.luma_block_rows = height / DCT_BLOCK_SIZE;
+    pipeline.luma_block_cols = width / DCT_BLOCK_SIZE;
+    pipeline.chroma_block_rows = mcu_count(pipeline.luma_block_rows);
+    pipeline.chroma_block_cols = mcu_count(pipeline.luma_block_cols);
+    pipeline.fixed_point = fixed_point;
+    init_block_kernel(&pipeline.kernels[LUMINANCE], method, 1.0, LUMINANCE);
+    init_block_kernel(&pipeline.kernels[CHROMINANCE], method, 1.0, CHROMINANCE);
+    pipeline.input = input;
+    pipeline.truncated = 0;
+
+    // Right padding of chroma row i repeats the last Cb/Cr of full-resolution row i
+    pipeline.cb_edge = NULL;
+    pipeline.cr_edge = NULL;
+    if (pipeline.chroma_width > width / 2 && height / 2 > 0) {
+        pipeline.cb_edge = (unsigned char *)malloc((size_t) (height / 2));
+        pipeline.cr_edge = (unsigned char *)malloc((size_t) (height / 2));
+        if (pipeline.cb_edge == NULL || pipeline.cr_edge == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int slot_count = PIPELINE_SLOTS_PER_WORKER * worker_count + PIPELINE_EXTRA_SLOTS;
+    PipelineStrip **strips = (PipelineStrip **)malloc((size_t) slot_count * sizeof(PipelineStrip *));
+    PipelineStrip **pending = (PipelineStrip **)calloc((size_t) slot_count, sizeof(PipelineStrip *));
+    pthread_t *workers = (pthread_t *)malloc((size_t) worker_count * sizeof(pthread_t));
+    if (strips == NULL || pending == NULL || workers == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    bounded_queue_init(&pipeline.free_strips, (size_t) slot_count);
+    bounded_queue_init(&pipeline.work, (size_t) (slot_count + worker_count));
+    bounded_queue_init(&pipeline.done, (size_t) slot_count);
+    for (int i = 0; i < slot_count; i++) {
+        strips[i] = pipeline_strip_create(&pipeline);
+        bounded_queue_push(&pipeline.free_strips, strips[i]);
+    }
+
+    // Runtime dispatch is resolved once, before any thread uses the kernels
+    dct_simd_init();
+    color_simd_init();
+
+    int started = 0;
+    while (started < worker_count &&
+           pthread_create(&workers[started], NULL, pipeline_worker, &pipeline) == 0) {
+        started++;
+    }
+    pthread_t reader;
+    int status = 0;
+    if (started == 0 || pthread_create(&reader, NULL, pipeline_reader, &pipeline) != 0) {
+        status = -1;
+    }
+
+    size_t compressed_size = 0;
+    if (status == 0) {
+        int restart_interval = bin_restart_interval(&stored_header);
+        int segment_count = bin_segment_count(pipeline.chroma_block_rows * pipeline.chroma_block_cols,
+                                              restart_interval);
+        uint32_t *segment_offsets = NULL;
+        if (bin_has_segment_table(&stored_header)) {
+            segment_offsets = (uint32_t *)calloc((size_t) segment_count, sizeof(uint32_t));
+            if (segment_offsets == NULL) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        long table_position = ftell(output) + (long) file_header->OffBits;
+        BitWriter writer;
+        bitwriter_init_file(&writer, output, BITWRITER_DEFAULT_BUFFER_SIZE);
+        pipeline_write_headers(&writer, &stored_header, info_header, segment_count);
+        McuCoder coder;
+        mcu_coder_init(&coder, &writer, restart_interval, segment_offsets, dc_encoder, ac_encoder);
+
+        // Strips finish out of order; hold each until every earlier MCU row is coded
+        for (int next = 0; next < pipeline.chroma_block_rows;) {
+            PipelineStrip *strip = (PipelineStrip *) bounded_queue_pop(&pipeline.done);
+            pending[strip->index % slot_count] = strip;
+            while (next < pipeline.chroma_block_rows && pending[next % slot_count] != NULL) {
+                strip = pending[next % slot_count];
+                pending[next % slot_count] = NULL;
+                pipeline_encode_strip(&pipeline, &coder, strip);
+                bounded_queue_push(&pipeline.free_strips, strip);
+                next++;
+            }
+        }
+
+        bitwriter_flush(&writer);
+        compressed_size = writer.bytes_flushed;
+        if (segment_offsets != NULL &&
+            write_segment_table_at(output, table_position, segment_offsets, segment_count) != 0) {
+            status = -1;
+        }
+        free(segment_offsets);
+        pthread_join(reader, NULL);
+    }
+
+    // Every strip is back (or was never read), so the NULLs are the last thing the workers see
+    for (int i = 0; i < started; i++) {
+        bounded_queue_push(&pipeline.work, NULL);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    for (int i = 0; i < slot_count; i++) {
+        pipeline_strip_free(strips[i]);
+    }
+    bounded_queue_destroy(&pipeline.free_strips);
+    bounded_queue_destroy(&pipeline.work);
+    bounded_queue_destroy(&pipeline.done);
+    free(strips);
+    free(pending);
+    free(workers);
+    free(pipeline.cb_edge);
+    free(pipeline.cr_edge);
+
+    if (result != NULL) {
+        result->compressed_size = compressed_size;
+        result->truncated = pipeline.truncated;
+    }
+    return status;
+}
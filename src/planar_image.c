@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "planar_image.h"
+#include "heap_manager.h"
+
+/**
+ * @brief Allocates a zeroed plane with aligned, padded rows
+ *
+ * The stride is the width rounded up to PLANE_ALIGNMENT, so every row starts
+ * on an aligned address and a full vector load never crosses into the next row.
+ *
+ * @param height Number of rows
+ * @param width Number of samples per row
+ * @return Initialized ImagePlane
+ */
+ImagePlane init_image_plane(int height, int width) {
+    ImagePlane plane;
+    plane.height = height;
+    plane.width = width;
+    plane.stride = ((width + PLANE_ALIGNMENT - 1) / PLANE_ALIGNMENT) * PLANE_ALIGNMENT;
+    if (plane.stride == 0) {
+        plane.stride = PLANE_ALIGNMENT;
+    }
+
+    // Over-allocate by one alignment unit and round the start up
+    size_t size = (size_t) plane.stride * (height > 0 ? height : 1) + PLANE_ALIGNMENT;
+    plane.allocation = (unsigned char *)calloc(size, 1);
+    if (plane.allocation == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    uintptr_t address = (uintptr_t) plane.allocation;
+    plane.data = plane.allocation + ((PLANE_ALIGNMENT - address % PLANE_ALIGNMENT) % PLANE_ALIGNMENT);
+
+    return plane;
+}
+
+/**
+ * @brief Frees the memory of an image plane
+ *
+ * @param plane Pointer to the plane to free
+ */
+void free_image_plane(ImagePlane *plane) {
+    free(plane->allocation);
+    plane->allocation = NULL;
+    plane->data = NULL;
+    plane->height = 0;
+    plane->width = 0;
+    plane->stride = 0;
+}
+
+/**
+ * @brief Frees the three planes of a PlanarImage
+ *
+ * @param image Pointer to the image to free
+ */
+void free_planar_image(PlanarImage *image) {
+    for (int c = 0; c < 3; c++) {
+        free_image_plane(&image->planes[c]);
+    }
+}
+
+/**
+ * @brief Copies a row-allocated matrix into a new plane
+ *
+ * @param matrix Source matrix, height rows of width samples
+ * @param height Number of rows
+ * @param width Number of samples per row
+ * @return New ImagePlane holding a copy of the samples
+ */
+ImagePlane uchar_matrix_to_plane(unsigned char **matrix, int height, int width) {
+    ImagePlane plane = init_image_plane(height, width);
+    for (int i = 0; i < height; i++) {
+        memcpy(image_plane_row(&plane, i), matrix[i], (size_t) width);
+    }
+
+    return plane;
+}
+
+/**
+ * @brief Copies a plane into a new row-allocated matrix
+ *
+ * @param plane Source plane
+ * @return New matrix from init_uchar_matrix, freed with free_uchar_matrix
+ */
+unsigned char **plane_to_uchar_matrix(const ImagePlane *plane) {
+    unsigned char **matrix = init_uchar_matrix(plane->height, plane->width);
+    for (int i = 0; i < plane->height; i++) {
+        memcpy(matrix[i], image_plane_row(plane, i), (size_t) plane->width);
+    }
+
+    return matrix;
+}
+
+/**
+ * @brief Copies an RGB_Image into planes R, G, B
+ *
+ * @param rgb_image Source image, left untouched
+ * @return New PlanarImage
+ */
+PlanarImage rgb_image_to_planar(RGB_Image rgb_image) {
+    PlanarImage image;
+    image.planes[0] = uchar_matrix_to_plane(rgb_image.r, rgb_image.height, rgb_image.width);
+    image.planes[1] = uchar_matrix_to_plane(rgb_image.g, rgb_image.height, rgb_image.width);
+    image.planes[2] = uchar_matrix_to_plane(rgb_image.b, rgb_image.height, rgb_image.width);
+
+    return image;
+}
+
+/**
+ * @brief Copies planes R, G, B into a new RGB_Image
+ *
+ * @param image Source image, left untouched
+ * @return New RGB_Image, freed with free_rgb_image
+ */
+RGB_Image planar_to_rgb_image(const PlanarImage *image) {
+    RGB_Image rgb_image;
+    rgb_image.height = image->planes[0].height;
+    rgb_image.width = image->planes[0].width;
+    rgb_image.r = plane_to_uchar_matrix(&image->planes[0]);
+    rgb_image.g = plane_to_uchar_matrix(&image->planes[1]);
+    rgb_image.b = plane_to_uchar_matrix(&image->planes[2]);
+
+    return rgb_image;
+}
+
+/**
+ * @brief Copies a YCbCr_Image into planes Y, Cb, Cr
+ *
+ * @param ycbcr_image Source image, left untouched
+ * @return New PlanarImage
+ */
+PlanarImage ycbcr_image_to_planar(YCbCr_Image ycbcr_image) {
+    PlanarImage image;
+    image.planes[0] = uchar_matrix_to_plane(ycbcr_image.y, ycbcr_image.height, ycbcr_image.width);
+    image.planes[1] = uchar_matrix_to_plane(ycbcr_image.cb, ycbcr_image.height, ycbcr_image.width);
+    image.planes[2] = uchar_matrix_to_plane(ycbcr_image.cr, ycbcr_image.height, ycbcr_image.width);
+
+    return image;
+}
+
+/**
+ * @brief Copies planes Y, Cb, Cr into a new YCbCr_Image
+ *
+ * @param image Source image, left untouched
+ * @return New YCbCr_Image, freed with free_ycbcr_image
+ */
+YCbCr_Image planar_to_ycbcr_image(const PlanarImage *image) {
+    YCbCr_Image ycbcr_image;
+    ycbcr_image.height = image->planes[0].height;
+    ycbcr_image.width = image->planes[0].width;
+    ycbcr_image.y = plane_to_uchar_matrix(&image->planes[0]);
+    ycbcr_image.cb = plane_to_uchar_matrix(&image->planes[1]);
+    ycbcr_image.cr = plane_to_uchar_matrix(&image->planes[2]);
+
+    return ycbcr_image;
+}
+
+/**
+ * @brief Copies a YCbCr_Image_420 into a full-size Y plane and two chroma planes
+ *
+ * @param ycbcr_image_420 Source image, left untouched
+ * @return New PlanarImage
+ */
+PlanarImage ycbcr_image_420_to_planar(YCbCr_Image_420 ycbcr_image_420) {
+    PlanarImage image;
+    image.planes[0] = uchar_matrix_to_plane(ycbcr_image_420.y, ycbcr_image_420.luminance_height,
+                                            ycbcr_image_420.luminance_width);
+    image.planes[1] = uchar_matrix_to_plane(ycbcr_image_420.cb, ycbcr_image_420.chrominance_height,
+                                            ycbcr_image_420.chrominance_width);
+    image.planes[2] = uchar_matrix_to_plane(ycbcr_image_420.cr, ycbcr_image_420.chrominance_height,
+                                            ycbcr_image_420.chrominance_width);
+
+    return image;
+}
+
+/**
+ * @brief Copies Y, Cb, Cr planes into a new YCbCr_Image_420
+ *
+ * @param image Source image, left untouched
+ * @return New YCbCr_Image_420, freed with free_ycbcr_image_420
+ */
+YCbCr_Image_420 planar_to_ycbcr_image_420(const PlanarImage *image) {
+    YCbCr_Image_420 ycbcr_image_420;
+    ycbcr_image_420.luminance_height = image->planes[0].height;
+    ycbcr_image_420.luminance_width = image->planes[0].width;
+    ycbcr_image_420.chrominance_height = image->planes[1].height;
+    ycbcr_image_420.chrominance_width = image->planes[1].width;
+    ycbcr_image_420.y = plane_to_uchar_matrix(&image->planes[0]);
+    ycbcr_image_420.cb = plane_to_uchar_matrix(&image->planes[1]);
+    ycbcr_image_420.cr = plane_to_uchar_matrix(&image->planes[2]);
+
+    return ycbcr_image_420;
+}
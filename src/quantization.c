@@ -4,6 +4,8 @@
 #include "quantization.h"
 #include "heap_manager.h"
 
+#define ISLOW_MAX_DIVISOR 32767 // Largest divisor applied to fdct_islow output, keeps the quotients exact
+
 /**
  * @brief Standard JPEG luminance quantization table
  *
@@ -74,7 +76,16 @@ int zigzag_table[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE][2] = {
  * @return Pointer to a new 8x8 matrix with quantized coefficients
  */
 double **quantize_block(double **block, double factor, QuantizationType type) {
-    double **quantized_block = init_double_matrix(DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+    return quantize_block_arena(NULL, block, factor, type);
+}
+
+/**
+ * @brief Same as quantize_block, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **quantize_block_arena(Arena *arena, double **block, double factor, QuantizationType type) {
+    double **quantized_block = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
 
     if(type == LUMINANCE) {
         for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
@@ -105,7 +116,16 @@ double **quantize_block(double **block, double factor, QuantizationType type) {
  * @return Pointer to a new 8x8 matrix with dequantized DCT coefficients
  */
 double **dequantize_block(double **block, double factor, QuantizationType type) {
-    double **dequantized_block = init_double_matrix(DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+    return dequantize_block_arena(NULL, block, factor, type);
+}
+
+/**
+ * @brief Same as dequantize_block, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **dequantize_block_arena(Arena *arena, double **block, double factor, QuantizationType type) {
+    double **dequantized_block = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
 
     if(type == LUMINANCE) {
         for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
@@ -124,6 +144,262 @@ double **dequantize_block(double **block, double factor, QuantizationType type)
     return dequantized_block;
 }
 
+/**
+ * @brief Returns the standard quantization table for the given component type
+ */
+static int (*quantization_table_for(QuantizationType type))[DCT_BLOCK_SIZE] {
+    return type == LUMINANCE ? luminance_quantization_table : chrominance_quantization_table;
+}
+
+/**
+ * @brief Builds quantization divisors with the AAN forward scaling folded in
+ *
+ * Each divisor is table[i][j] * factor * 8 * aan_scale_factors[i] * aan_scale_factors[j],
+ * so dividing the raw output of dct_2d_aan(block, 0) by it gives the same
+ * result as quantize_block applied to dct_2d. Compute once per (factor, type).
+ *
+ * @param divisors Output 8x8 table of divisors
+ * @param factor Quality factor to scale the quantization (higher value = more compression)
+ * @param type LUMINANCE or CHROMINANCE to determine which quantization table to use
+ */
+void compute_aan_quantization_table(double divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE], double factor, QuantizationType type) {
+    int (*table)[DCT_BLOCK_SIZE] = quantization_table_for(type);
+
+    for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for(int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            divisors[i][j] = table[i][j] * factor * 8.0 * aan_scale_factors[i] * aan_scale_factors[j];
+        }
+    }
+}
+
+/**
+ * @brief Builds dequantization multipliers with the AAN inverse prescaling folded in
+ *
+ * Each multiplier is table[i][j] * factor * aan_scale_factors[i] * aan_scale_factors[j] / 8,
+ * which is what idct_2d_aan(block, 1) expects as input.
+ *
+ * @param multipliers Output 8x8 table of multipliers
+ * @param factor Quality factor used during quantization
+ * @param type LUMINANCE or CHROMINANCE to determine which quantization table to use
+ */
+void compute_aan_dequantization_table(double multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE], double factor, QuantizationType type) {
+    int (*table)[DCT_BLOCK_SIZE] = quantization_table_for(type);
+
+    for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for(int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            multipliers[i][j] = table[i][j] * factor * aan_scale_factors[i] * aan_scale_factors[j] / 8.0;
+        }
+    }
+}
+
+/**
+ * @brief Quantizes raw AAN DCT output with a folded divisor table
+ *
+ * @param block Input 8x8 block produced by dct_2d_aan(block, 0)
+ * @param divisors Table built by compute_aan_quantization_table
+ * @return Pointer to a new 8x8 matrix with quantized coefficients
+ */
+double **quantize_block_aan(double **block, double divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
+    return quantize_block_aan_arena(NULL, block, divisors);
+}
+
+/**
+ * @brief Same as quantize_block_aan, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **quantize_block_aan_arena(Arena *arena, double **block, double divisors[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
+    double **quantized_block = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+
+    for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for(int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            quantized_block[i][j] = round(block[i][j] / divisors[i][j]);
+        }
+    }
+
+    return quantized_block;
+}
+
+/**
+ * @brief Dequantizes coefficients straight into AAN-prescaled form
+ *
+ * @param block Input 8x8 block of quantized DCT coefficients
+ * @param multipliers Table built by compute_aan_dequantization_table
+ * @return Pointer to a new 8x8 matrix ready for idct_2d_aan(block, 1)
+ */
+double **dequantize_block_aan(double **block, double multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
+    return dequantize_block_aan_arena(NULL, block, multipliers);
+}
+
+/**
+ * @brief Same as dequantize_block_aan, with the result allocated from an arena
+ *
+ * @param arena Arena for the result, or NULL for the heap
+ */
+double **dequantize_block_aan_arena(Arena *arena, double **block, double multipliers[DCT_BLOCK_SIZE][DCT_BLOCK_SIZE]) {
+    double **dequantized_block = init_double_matrix_arena(arena, DCT_BLOCK_SIZE, DCT_BLOCK_SIZE);
+
+    for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for(int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            dequantized_block[i][j] = block[i][j] * multipliers[i][j];
+        }
+    }
+
+    return dequantized_block;
+}
+
+/**
+ * @brief Builds the integer quantization table used with the fixed-point DCT
+ *
+ * Each entry is round(table[i][j] * factor), at least 1, in row-major order.
+ *
+ * @param divisors Output table of 64 divisors
+ * @param factor Quality factor to scale the quantization (higher value = more compression)
+ * @param type LUMINANCE or CHROMINANCE to determine which quantization table to use
+ */
+void compute_int_quantization_table(uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], double factor, QuantizationType type) {
+    int (*table)[DCT_BLOCK_SIZE] = quantization_table_for(type);
+
+    for(int i = 0; i < DCT_BLOCK_SIZE; i++) {
+        for(int j = 0; j < DCT_BLOCK_SIZE; j++) {
+            long divisor = lround(table[i][j] * factor);
+            divisors[i * DCT_BLOCK_SIZE + j] = (uint16_t)(divisor < 1 ? 1 : (divisor > 65535 ? 65535 : divisor));
+        }
+    }
+}
+
+/**
+ * @brief Divisor for a coefficient still scaled by fdct_islow
+ *
+ * Capped at ISLOW_MAX_DIVISOR: fdct_islow output stays within 8 * 1024, so
+ * anything above twice that quantizes every coefficient to 0 either way.
+ */
+static int32_t islow_divisor(uint16_t divisor) {
+    int32_t scaled = (int32_t) divisor << DCT_ISLOW_OUTPUT_BITS;
+    return scaled > ISLOW_MAX_DIVISOR ? ISLOW_MAX_DIVISOR : scaled;
+}
+
+/**
+ * @brief In-place integer quantization of a row-major int16 coefficient block
+ *
+ * Rounds half away from zero, like quantize_block. The fdct_islow output is
+ * still scaled by 2^DCT_ISLOW_OUTPUT_BITS, so the divisors are scaled to
+ * match and the descale happens in the same rounding as the quantization.
+ *
+ * @param block Row-major block from fdct_islow, replaced by the quantized values
+ * @param divisors Table built by compute_int_quantization_table
+ */
+void quantize_block_int(int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    for(int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        int32_t value = block[i];
+        int32_t divisor = islow_divisor(divisors[i]);
+        if (value < 0) {
+            block[i] = (int16_t) -((-value + divisor / 2) / divisor);
+        } else {
+            block[i] = (int16_t) ((value + divisor / 2) / divisor);
+        }
+    }
+}
+
+/**
+ * @brief In-place integer dequantization of a row-major int16 block
+ *
+ * The products are saturated to the int16 range.
+ *
+ * @param block Row-major block of quantized values, replaced by the coefficients
+ * @param divisors Table built by compute_int_quantization_table
+ */
+void dequantize_block_int(int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const uint16_t divisors[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    for(int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        int32_t value = (int32_t) block[i] * divisors[i];
+        block[i] = (int16_t)(value < INT16_MIN ? INT16_MIN : (value > INT16_MAX ? INT16_MAX : value));
+    }
+}
+
+/**
+ * @brief Builds a quantizer for one quantization table and quality factor
+ *
+ * The integer divisors match compute_int_quantization_table; the reciprocals
+ * are those of the divisors scaled for fdct_islow output, as in
+ * quantize_block_int. Since |coefficient| + bias < 2^16 and the scaled
+ * divisor < 2^16, multiplying by ceil(2^32 / divisor) and keeping the high
+ * 32 bits gives exactly the integer quotient, so quantize_block_reciprocal
+ * matches quantize_block_int.
+ *
+ * @param quantizer Quantizer to fill
+ * @param factor Quality factor to scale the quantization (higher value = more compression)
+ * @param type LUMINANCE or CHROMINANCE to determine which quantization table to use
+ * @param aan_scaled Non-zero to fold the AAN output scaling into the float scales
+ */
+void init_quantizer(Quantizer *quantizer, double factor, QuantizationType type, int aan_scaled) {
+    int (*table)[DCT_BLOCK_SIZE] = quantization_table_for(type);
+
+    for (int k = 0; k < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; k++) {
+        int row = zigzag_table[k][0];
+        int col = zigzag_table[k][1];
+
+        long divisor = lround(table[row][col] * factor);
+        divisor = divisor < 1 ? 1 : (divisor > 65535 ? 65535 : divisor);
+        quantizer->divisors[k] = (uint16_t) divisor;
+        // At least 2^DCT_ISLOW_OUTPUT_BITS, so 2^32 / divisor always fits
+        int32_t scaled = islow_divisor((uint16_t) divisor);
+        quantizer->reciprocals[k] = (uint32_t) ((((uint64_t) 1 << 32) + scaled - 1) / (uint64_t) scaled);
+        quantizer->biases[k] = (uint16_t) (scaled / 2);
+
+        double scale = table[row][col] * factor;
+        if (aan_scaled) {
+            scale *= 8.0 * aan_scale_factors[row] * aan_scale_factors[col];
+        }
+        quantizer->scales[k] = (float) (1.0 / scale);
+    }
+}
+
+/**
+ * @brief Quantizes a row-major int16 block with multiply-shift, emitting zigzag order
+ *
+ * Same result as quantize_block_int followed by a zigzag scan. After the
+ * reorder every step is element-wise over contiguous arrays.
+ *
+ * @param block Row-major block from fdct_islow, still scaled by 2^DCT_ISLOW_OUTPUT_BITS
+ * @param quantizer Quantizer from init_quantizer
+ * @param zigzag Output zigzag-ordered quantized coefficients
+ */
+void quantize_block_reciprocal(const int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const Quantizer *quantizer,
+                               int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    int16_t ordered[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+    zigzag_scan_int16(block, ordered);
+
+    for (int k = 0; k < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; k++) {
+        int32_t value = ordered[k];
+        uint32_t magnitude = (uint32_t) (value < 0 ? -value : value) + quantizer->biases[k];
+        int32_t quotient = (int32_t) (((uint64_t) magnitude * quantizer->reciprocals[k]) >> 32);
+        zigzag[k] = (int16_t) (value < 0 ? -quotient : quotient);
+    }
+}
+
+/**
+ * @brief Quantizes a row-major float block by multiplying with the reciprocals, emitting zigzag order
+ *
+ * Rounds to nearest like quantize_block; results can differ from the
+ * division by one only when the quotient lands within float precision of .5.
+ *
+ * @param block Row-major block of DCT coefficients (raw AAN output if the quantizer is aan_scaled)
+ * @param quantizer Quantizer from init_quantizer
+ * @param zigzag Output zigzag-ordered quantized coefficients
+ */
+void quantize_float_block_reciprocal(const float block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], const Quantizer *quantizer,
+                                     int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    float ordered[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE];
+    for (int k = 0; k < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; k++) {
+        ordered[k] = block[zigzag_table[k][0] * DCT_BLOCK_SIZE + zigzag_table[k][1]];
+    }
+
+    for (int k = 0; k < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; k++) {
+        float value = ordered[k] * quantizer->scales[k];
+        zigzag[k] = (int16_t) (value < 0.0f ? value - 0.5f : value + 0.5f);
+    }
+}
+
 /**
  * @brief Zigzag scan of a block of DCT coefficients
  *
@@ -146,6 +422,30 @@ int *zigzag_scan(double **block) {
     return zigzag_array;
 }
 
+/**
+ * @brief Zigzag scan of a row-major int16 block, without allocating
+ *
+ * @param block Input row-major block of coefficients
+ * @param zigzag Output array of zigzag-ordered coefficients
+ */
+void zigzag_scan_int16(const int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    for (int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        zigzag[i] = block[zigzag_table[i][0] * DCT_BLOCK_SIZE + zigzag_table[i][1]];
+    }
+}
+
+/**
+ * @brief Inverse of zigzag_scan_int16
+ *
+ * @param zigzag Input array of zigzag-ordered coefficients
+ * @param block Output row-major block of coefficients
+ */
+void inverse_zigzag_scan_int16(const int16_t zigzag[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE], int16_t block[DCT_BLOCK_SIZE * DCT_BLOCK_SIZE]) {
+    for (int i = 0; i < DCT_BLOCK_SIZE * DCT_BLOCK_SIZE; i++) {
+        block[zigzag_table[i][0] * DCT_BLOCK_SIZE + zigzag_table[i][1]] = zigzag[i];
+    }
+}
+
 /**
  * @brief Inverse zigzag scan of a zigzag-ordered array
  *
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "stream_decoder.h"
+#include "coefficients.h"
+#include "color_convert.h"
+#include "bin_format.h"
+#include "entropy_segments.h"
+
+/**
+ * @brief Entropy decodes one block and reconstructs it into a plane
+ */
+static void decode_block_into(StreamDecoder *decoder, BitReader *br, int *previous_dc,
+                              const BlockKernel *kernel, unsigned char *pixels, int stride) {
+    int block[BLOCK_COEFFICIENTS];
+    int16_t coefficients[BLOCK_COEFFICIENTS];
+
+    decode_block(decoder->huffman, br, previous_dc, block);
+    for (int k = 0; k < BLOCK_COEFFICIENTS; k++) {
+        coefficients[k] = (int16_t) block[k];
+    }
+    inverse_block_kernel(kernel, coefficients, pixels, stride);
+}
+
+/**
+ * @brief Initializes a streaming decoder over a compressed file held in memory
+ *
+ * Every Y block precedes the chroma blocks in the file, so the Y blocks are
+ * entropy decoded once up front, without being stored, just to find where
+ * the chroma bits start. After that Y and chroma are read side by side, one
+ * MCU row at a time. Files in MCU order (BIN_FLAG_INTERLEAVED) need no
+ * prescan: they are read front to back with a single reader.
+ *
+ * Only the decoded pixels are bounded. The compressed file must be in
+ * memory as a whole, since sequential files are read at two positions at
+ * once, and for those every Y block is Huffman decoded twice. One pass over
+ * the bits and the smallest working set need interleaved input
+ * (encode --order=interleaved).
+ *
+ * The layout flags and restart interval are cleared from
+ * decoder->file_header, which then describes the decoded bitmap. A missing
+ * restart marker is counted in decoder->restart_errors; decoding carries on
+ * with reset predictors.
+ *
+ * @param decoder Decoder to initialize
+ * @param data Whole compressed file, must stay valid until stream_decoder_close
+ * @param size Size of data in bytes
+ * @param method DCT implementation used for the inverse transform
+ * @param fancy_upsampling Nonzero for triangle-filter chroma upsampling
+ * @return 0 on success, -1 if the headers are invalid, the segment table is
+ * truncated or the image is smaller than one block
+ */
+int stream_decoder_init(StreamDecoder *decoder, const uint8_t *data, size_t size, DCTMethod method, int fancy_upsampling) {
+    if (parse_bmp_headers(data, size, &decoder->file_header, &decoder->info_header) != 0 ||
+        decoder->file_header.OffBits > size) {
+        return -1;
+    }
+    decoder->interleaved = bin_is_interleaved(&decoder->file_header);
+    decoder->restart_interval = bin_restart_interval(&decoder->file_header);
+    decoder->mcus_decoded = 0;
+    decoder->restart_errors = 0;
+    int has_segment_table = bin_has_segment_table(&decoder->file_header);
+    decoder->file_header.Reserved1 = 0;
+    decoder->file_header.Reserved2 = 0;
+
+    decoder->luma_block_rows = decoder->info_header.Height / DCT_BLOCK_SIZE;
+    decoder->luma_block_cols = decoder->info_header.Width / DCT_BLOCK_SIZE;
+    // One Cb and one Cr block per MCU, partial MCUs included, in either order
+    decoder->chroma_block_rows = mcu_count(decoder->luma_block_rows);
+    decoder->chroma_block_cols = mcu_count(decoder->luma_block_cols);
+    if (decoder->chroma_block_rows <= 0 || decoder->chroma_block_cols <= 0) {
+        return -1;
+    }
+
+    decoder->height = decoder->luma_block_rows * DCT_BLOCK_SIZE;
+    decoder->width = decoder->luma_block_cols * DCT_BLOCK_SIZE;
+    // The headers describe the scanlines produced, not the original size
+    set_bmp_dimensions(&decoder->file_header, &decoder->info_header, decoder->width, decoder->height);
+    decoder->chroma_rows = (decoder->height + 1) / 2;
+    if (decoder->chroma_rows > decoder->chroma_block_rows * DCT_BLOCK_SIZE) {
+        decoder->chroma_rows = decoder->chroma_block_rows * DCT_BLOCK_SIZE;
+    }
+    decoder->chroma_cols = (decoder->width + 1) / 2;
+    if (decoder->chroma_cols > decoder->chroma_block_cols * DCT_BLOCK_SIZE) {
+        decoder->chroma_cols = decoder->chroma_block_cols * DCT_BLOCK_SIZE;
+    }
+    decoder->fancy_upsampling = fancy_upsampling;
+
+    init_block_kernel(&decoder->kernels[LUMINANCE], method, 1.0, LUMINANCE);
+    init_block_kernel(&decoder->kernels[CHROMINANCE], method, 1.0, CHROMINANCE);
+    decoder->huffman = create_huffman_decoder();
+
+    const uint8_t *bitstream = data + decoder->file_header.OffBits;
+    size_t bitstream_size = size - decoder->file_header.OffBits;
+    if (has_segment_table) {
+        // Reading front to back, the segment table is only skipped
+        int segment_count = bin_segment_count(decoder->chroma_block_rows * decoder->chroma_block_cols,
+                                              decoder->restart_interval);
+        size_t table_size = bin_segment_table_size(segment_count);
+        if (table_size > bitstream_size) {
+            free_huffman_decoder(decoder->huffman);
+            return -1;
+        }
+        bitstream += table_size;
+        bitstream_size -= table_size;
+    }
+    bitreader_init_memory(&decoder->luma_reader, bitstream, bitstream_size);
+
+    if (!decoder->interleaved) {
+        // Skip over the Y blocks to find the first Cb block
+        BitReader scan;
+        int block[BLOCK_COEFFICIENTS];
+        int previous_dc = 0;
+        bitreader_init_memory(&scan, bitstream, bitstream_size);
+        for (int b = 0; b < decoder->luma_block_rows * decoder->luma_block_cols; b++) {
+            decode_block(decoder->huffman, &scan, &previous_dc, block);
+        }
+        size_t chroma_bit = bitreader_bits_consumed(&scan);
+        size_t chroma_byte = chroma_bit / 8 < bitstream_size ? chroma_bit / 8 : bitstream_size;
+        bitreader_init_memory(&decoder->chroma_reader, bitstream + chroma_byte, bitstream_size - chroma_byte);
+        bitreader_read_bits(&decoder->chroma_reader, (int) (chroma_bit % 8));
+    }
+
+    decoder->previous_dc_y = 0;
+    decoder->previous_dc_cb = 0;
+    decoder->previous_dc_cr = 0;
+
+    // Interleaved files hold the next MCU row's Y in front of the chroma needed for the filter
+    decoder->y_strip = init_image_plane(STREAM_DECODER_MCU_ROWS * (decoder->interleaved ? 2 : 1), decoder->width);
+    decoder->cb_window = init_image_plane(STREAM_CHROMA_WINDOW * DCT_BLOCK_SIZE, decoder->chroma_block_cols * DCT_BLOCK_SIZE);
+    decoder->cr_window = init_image_plane(STREAM_CHROMA_WINDOW * DCT_BLOCK_SIZE, decoder->chroma_block_cols * DCT_BLOCK_SIZE);
+    decoder->scratch = init_image_plane(5, decoder->width);
+    decoder->luma_mcu_row = -1;
+    decoder->chroma_block_rows_decoded = 0;
+    decoder->next_row = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Decodes the Y blocks of one MCU row into the luminance strip
+ */
+static void decode_luma_mcu_row(StreamDecoder *decoder, int mcu_row) {
+    for (int r = 0; r < STREAM_DECODER_MCU_ROWS / DCT_BLOCK_SIZE; r++) {
+        int block_row = mcu_row * (STREAM_DECODER_MCU_ROWS / DCT_BLOCK_SIZE) + r;
+        if (block_row >= decoder->luma_block_rows) {
+            break;
+        }
+        unsigned char *row = image_plane_row(&decoder->y_strip, r * DCT_BLOCK_SIZE);
+        for (int c = 0; c < decoder->luma_block_cols; c++) {
+            decode_block_into(decoder, &decoder->luma_reader, &decoder->previous_dc_y, &decoder->kernels[LUMINANCE],
+                              row + c * DCT_BLOCK_SIZE, decoder->y_strip.stride);
+        }
+    }
+    decoder->luma_mcu_row = mcu_row;
+}
+
+/**
+ * @brief Decodes the next chroma block row into its slot of the window
+ */
+static void decode_chroma_block_row(StreamDecoder *decoder) {
+    int slot = decoder->chroma_block_rows_decoded % STREAM_CHROMA_WINDOW;
+    unsigned char *cb_row = image_plane_row(&decoder->cb_window, slot * DCT_BLOCK_SIZE);
+    unsigned char *cr_row = image_plane_row(&decoder->cr_window, slot * DCT_BLOCK_SIZE);
+
+    // Cb and Cr blocks alternate in the file
+    for (int c = 0; c < decoder->chroma_block_cols; c++) {
+        decode_block_into(decoder, &decoder->chroma_reader, &decoder->previous_dc_cb, &decoder->kernels[CHROMINANCE],
+                          cb_row + c * DCT_BLOCK_SIZE, decoder->cb_window.stride);
+        decode_block_into(decoder, &decoder->chroma_reader, &decoder->previous_dc_cr, &decoder->kernels[CHROMINANCE],
+                          cr_row + c * DCT_BLOCK_SIZE, decoder->cr_window.stride);
+    }
+    decoder->chroma_block_rows_decoded++;
+}
+
+/**
+ * @brief Decodes the next MCU row of an interleaved file: Y into its half of
+ * the strip, Cb and Cr into their slot of the window
+ */
+static void decode_interleaved_mcu_row(StreamDecoder *decoder) {
+    int mcu_row = decoder->chroma_block_rows_decoded;
+    int slot = mcu_row % STREAM_CHROMA_WINDOW;
+    unsigned char *cb_row = image_plane_row(&decoder->cb_window, slot * DCT_BLOCK_SIZE);
+    unsigned char *cr_row = image_plane_row(&decoder->cr_window, slot * DCT_BLOCK_SIZE);
+    BitReader *br = &decoder->luma_reader;
+
+    for (int c = 0; c < decoder->chroma_block_cols; c++) {
+        int mcu = decoder->mcus_decoded++;
+        if (decoder->restart_interval > 0 && mcu > 0 && mcu % decoder->restart_interval == 0) {
+            if (read_restart_marker(br, mcu / decoder->restart_interval) != 0) {
+                decoder->restart_errors++;
+            }
+            decoder->previous_dc_y = 0;
+            decoder->previous_dc_cb = 0;
+            decoder->previous_dc_cr = 0;
+        }
+        for (int k = 0; k < MCU_LUMA_BLOCKS * MCU_LUMA_BLOCKS; k++) {
+            int row = mcu_row * MCU_LUMA_BLOCKS + k / MCU_LUMA_BLOCKS;
+            int col = c * MCU_LUMA_BLOCKS + k % MCU_LUMA_BLOCKS;
+            if (row >= decoder->luma_block_rows || col >= decoder->luma_block_cols) {
+                continue;
+            }
+            unsigned char *y = image_plane_row(&decoder->y_strip, (row * DCT_BLOCK_SIZE) % decoder->y_strip.height);
+            decode_block_into(decoder, br, &decoder->previous_dc_y, &decoder->kernels[LUMINANCE],
+                              y + col * DCT_BLOCK_SIZE, decoder->y_strip.stride);
+        }
+        decode_block_into(decoder, br, &decoder->previous_dc_cb, &decoder->kernels[CHROMINANCE],
+                          cb_row + c * DCT_BLOCK_SIZE, decoder->cb_window.stride);
+        decode_block_into(decoder, br, &decoder->previous_dc_cr, &decoder->kernels[CHROMINANCE],
+                          cr_row + c * DCT_BLOCK_SIZE, decoder->cr_window.stride);
+    }
+    decoder->chroma_block_rows_decoded++;
+}
+
+/**
+ * @brief Row of the chroma window holding chroma row k
+ */
+static const unsigned char *chroma_window_row(const ImagePlane *window, int k) {
+    int slot = (k / DCT_BLOCK_SIZE) % STREAM_CHROMA_WINDOW;
+    return image_plane_row(window, slot * DCT_BLOCK_SIZE + k % DCT_BLOCK_SIZE);
+}
+
+/**
+ * @brief Produces up to max_rows decoded scanlines
+ *
+ * Scanlines come out in stored order, each as 3 * width bytes of B, G, R.
+ * Blocks are decoded lazily: one MCU row of Y and one chroma block row
+ * ahead (for the upsampling filter) are all that is held at any time. The
+ * result matches save_ycbcr_image_420 on the fully decoded image.
+ *
+ * @param decoder Decoder initialized with stream_decoder_init
+ * @param rows Destination rows, at least 3 * width bytes each
+ * @param max_rows Number of entries in rows
+ * @return Number of scanlines written, 0 once the image is complete
+ */
+int stream_decoder_read_scanlines(StreamDecoder *decoder, unsigned char **rows, int max_rows) {
+    int width = decoder->width;
+    unsigned char *cb = image_plane_row(&decoder->scratch, 0);
+    unsigned char *cr = image_plane_row(&decoder->scratch, 1);
+    unsigned char *r = image_plane_row(&decoder->scratch, 2);
+    unsigned char *g = image_plane_row(&decoder->scratch, 3);
+    unsigned char *b = image_plane_row(&decoder->scratch, 4);
+
+    int count = 0;
+    while (count < max_rows && decoder->next_row < decoder->height) {
+        int i = decoder->next_row;
+        int mcu_row = i / STREAM_DECODER_MCU_ROWS;
+        if (!decoder->interleaved && decoder->luma_mcu_row != mcu_row) {
+            decode_luma_mcu_row(decoder, mcu_row);
+        }
+        // Keep the chroma block row after this one for the filter's lower neighbour
+        int needed = mcu_row + 1 < decoder->chroma_block_rows ? mcu_row + 1 : decoder->chroma_block_rows - 1;
+        while (decoder->chroma_block_rows_decoded <= needed) {
+            if (decoder->interleaved) {
+                decode_interleaved_mcu_row(decoder);
+            } else {
+                decode_chroma_block_row(decoder);
+            }
+        }
+
+        int near_row = i / 2 < decoder->chroma_rows - 1 ? i / 2 : decoder->chroma_rows - 1;
+        int far_row = (i % 2) ? i / 2 + 1 : i / 2 - 1;
+        if (far_row < 0) far_row = 0;
+        if (far_row > decoder->chroma_rows - 1) far_row = decoder->chroma_rows - 1;
+        upsample_chroma_row(chroma_window_row(&decoder->cb_window, near_row), chroma_window_row(&decoder->cb_window, far_row),
+                            decoder->chroma_cols, cb, width, decoder->fancy_upsampling);
+        upsample_chroma_row(chroma_window_row(&decoder->cr_window, near_row), chroma_window_row(&decoder->cr_window, far_row),
+                            decoder->chroma_cols, cr, width, decoder->fancy_upsampling);
+
+        ycbcr_row_to_rgb(image_plane_row(&decoder->y_strip, i % decoder->y_strip.height), cb, cr, r, g, b, width);
+        interleave_bgr_row(r, g, b, rows[count], width);
+
+        decoder->next_row++;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Decodes the whole image, handing each MCU row of scanlines to a callback
+ *
+ * The rows passed to the callback are padded to bmp_row_stride(width) with
+ * zero bytes, so they can be written to a bitmap as they are. They are
+ * reused for the next call.
+ *
+ * @param decoder Decoder initialized with stream_decoder_init
+ * @param callback Receives STREAM_DECODER_MCU_ROWS scanlines at a time (fewer at the end)
+ * @param context Passed through to callback
+ */
+void stream_decoder_run(StreamDecoder *decoder, ScanlineCallback callback, void *context) {
+    int row_stride = bmp_row_stride(decoder->width);
+    unsigned char *storage = (unsigned char *)calloc((size_t) row_stride * STREAM_DECODER_MCU_ROWS, 1);
+    if (storage == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned char *rows[STREAM_DECODER_MCU_ROWS];
+    for (int k = 0; k < STREAM_DECODER_MCU_ROWS; k++) {
+        rows[k] = storage + (size_t) k * row_stride;
+    }
+
+    int first_row = decoder->next_row;
+    int count;
+    while ((count = stream_decoder_read_scanlines(decoder, rows, STREAM_DECODER_MCU_ROWS)) > 0) {
+        callback(context, rows, first_row, count);
+        first_row += count;
+    }
+
+    free(storage);
+}
+
+/**
+ * @brief Releases everything owned by a streaming decoder
+ *
+ * @param decoder Decoder initialized with stream_decoder_init
+ */
+void stream_decoder_close(StreamDecoder *decoder) {
+    free_huffman_decoder(decoder->huffman);
+    free_image_plane(&decoder->y_strip);
+    free_image_plane(&decoder->cb_window);
+    free_image_plane(&decoder->cr_window);
+    free_image_plane(&decoder->scratch);
+}
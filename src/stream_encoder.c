@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream_encoder.h"
+#include "coefficients.h"
+#include "color_convert.h"
+#include "bin_format.h"
+#include "entropy_segments.h"
+
+#define STREAM_COPY_SIZE (64 * 1024) // Chunk used to append the chroma spill
+
+/**
+ * @brief Initializes a streaming encoder and writes the file headers
+ *
+ * The output has the same layout as the batch encoder: the bitmap headers
+ * padded to OffBits, every Y block in raster order, then Cb and Cr blocks
+ * alternating. Luminance is written to output as soon as each MCU row is
+ * complete; chrominance goes to a temporary file and is appended by
+ * stream_encoder_finish. In interleaved mode every MCU row is written whole,
+ * in the order of the batch encoder's --order=interleaved, with no spill,
+ * and may be split into restart intervals exactly as encode_restart_segments
+ * does. The segment table is reserved up front and filled in by
+ * stream_encoder_finish, so output must then be seekable.
+ *
+ * @param encoder Encoder to initialize
+ * @param output Destination file, opened for writing by the caller and left open
+ * @param file_header Bitmap file header of the source
+ * @param info_header Bitmap info header of the source, gives the image size
+ * @param method DCT implementation to use
+ * @param dc_encoder DC entropy encoder backend
+ * @param ac_encoder AC entropy encoder backend
+ * @param fixed_point Nonzero to use the fixed-point color conversion
+ * @param layout Block order, restart interval and segment table
+ * @return 0 on success, -1 if the temporary file cannot be created
+ */
+int stream_encoder_init(StreamEncoder *encoder, FILE *output, const BITMAPFILEHEADER *file_header,
+                        const BITMAPINFOHEADER *info_header, DCTMethod method,
+                        DCEncoder dc_encoder, ACEncoder ac_encoder, int fixed_point, const BinLayout *layout) {
+    BlockKernel kernels[2];
+    init_block_kernel(&kernels[LUMINANCE], method, 1.0, LUMINANCE);
+    init_block_kernel(&kernels[CHROMINANCE], method, 1.0, CHROMINANCE);
+    return stream_encoder_init_kernels(encoder, output, file_header, info_header, kernels,
+                                       dc_encoder, ac_encoder, fixed_point, layout, NULL);
+}
+
+/**
+ * @brief A zeroed plane of the given size, carved out of a workspace plane when there is one
+ *
+ * The workspace plane is only reallocated when it is too small, so it grows
+ * to the largest size asked for and is then reused as is.
+ */
+static ImagePlane stream_encoder_plane(ImagePlane *kept, int height, int width) {
+    if (kept == NULL) {
+        return init_image_plane(height, width);
+    }
+    if (kept->allocation == NULL || kept->height < height || kept->width < width) {
+        free_image_plane(kept);
+        *kept = init_image_plane(height, width);
+    }
+    ImagePlane plane = *kept;
+    plane.height = height;
+    plane.width = width;
+    memset(plane.data, 0, (size_t) plane.stride * (size_t) height);
+    return plane;
+}
+
+/**
+ * @brief Coefficient storage for count blocks, taken from a workspace when there is one
+ */
+static int16_t *stream_encoder_blocks(StreamWorkspace *workspace, int count) {
+    size_t size = ((size_t) count * BLOCK_COEFFICIENTS + 1) * sizeof(int16_t);
+    int16_t *blocks;
+    if (workspace == NULL) {
+        blocks = (int16_t *)malloc(size);
+    } else {
+        if (workspace->mcu_blocks == NULL || workspace->mcu_block_capacity < count) {
+            workspace->mcu_blocks = (int16_t *)realloc(workspace->mcu_blocks, size);
+            workspace->mcu_block_capacity = count;
+        }
+        blocks = workspace->mcu_blocks;
+    }
+    if (blocks == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return blocks;
+}
+
+/**
+ * @brief Initializes a streaming encoder with block kernels built by the caller
+ *
+ * Same as stream_encoder_init, but copies kernels instead of computing the
+ * cosine matrix and quantization tables again, so a caller encoding many
+ * files can build them once and reuse them for every file. With a workspace
+ * the chroma spill file and the row buffers are also taken from it and left
+ * there by stream_encoder_finish, instead of being created for every file.
+ *
+ * @param kernels Luminance and chrominance kernels, indexed by QuantizationType
+ * @param workspace Spill file and buffers to reuse, or NULL for the encoder's own
+ * @return 0 on success, -1 if the temporary file cannot be created
+ */
+int stream_encoder_init_kernels(StreamEncoder *encoder, FILE *output, const BITMAPFILEHEADER *file_header,
+                                const BITMAPINFOHEADER *info_header, const BlockKernel kernels[2],
+                                DCEncoder dc_encoder, ACEncoder ac_encoder, int fixed_point, const BinLayout *layout,
+                                StreamWorkspace *workspace) {
+    int height = info_header->Height;
+    int width = info_header->Width;
+
+    // The original bitmap headers go first, padded up to OffBits; Reserved1/Reserved2 hold the layout
+    BITMAPFILEHEADER stored_header = *file_header;
+    bin_store_layout(&stored_header, layout, width);
+    int interleaved = bin_is_interleaved(&stored_header);
+
+    encoder->workspace = workspace;
+    encoder->chroma_spill = NULL;
+    if (!interleaved) {
+        if (workspace != NULL && workspace->chroma_spill != NULL) {
+            // Only the bytes written for this file are read back, so the old contents can stay
+            rewind(workspace->chroma_spill);
+            encoder->chroma_spill = workspace->chroma_spill;
+        } else {
+            encoder->chroma_spill = tmpfile();
+            if (encoder->chroma_spill == NULL) {
+                return -1;
+            }
+            if (workspace != NULL) {
+                workspace->chroma_spill = encoder->chroma_spill;
+            }
+        }
+    }
+
+    encoder->height = height;
+    encoder->width = width;
+    encoder->chroma_height = (height / 2) + (height / 2) % 8;
+    encoder->chroma_width = (width / 2) + (width / 2) % 8;
+    encoder->luma_block_rows = height / DCT_BLOCK_SIZE;
+    encoder->luma_block_cols = width / DCT_BLOCK_SIZE;
+    encoder->chroma_block_rows = mcu_count(encoder->luma_block_rows);
+    encoder->chroma_block_cols = mcu_count(encoder->luma_block_cols);
+    encoder->fixed_point = fixed_point;
+    encoder->interleaved = interleaved;
+    int restart_interval = bin_restart_interval(&stored_header);
+    encoder->segment_count = bin_segment_count(encoder->chroma_block_rows * encoder->chroma_block_cols,
+                                               restart_interval);
+
+    encoder->kernels[LUMINANCE] = kernels[LUMINANCE];
+    encoder->kernels[CHROMINANCE] = kernels[CHROMINANCE];
+    encoder->dc_encoder = dc_encoder;
+    encoder->ac_encoder = ac_encoder;
+
+    bitwriter_init_file(&encoder->writer, output, BITWRITER_DEFAULT_BUFFER_SIZE);
+    if (!interleaved) {
+        bitwriter_init_file(&encoder->chroma_writer, encoder->chroma_spill, BITWRITER_DEFAULT_BUFFER_SIZE);
+    }
+    encoder->previous_dc_y = 0;
+    encoder->previous_dc_cb = 0;
+    encoder->previous_dc_cr = 0;
+
+    encoder->rows_received = 0;
+    encoder->chroma_rows_ready = 0;
+    encoder->luma_block_rows_done = 0;
+    encoder->chroma_block_rows_done = 0;
+    encoder->y_strip = stream_encoder_plane(workspace != NULL ? &workspace->y_strip : NULL, STREAM_MCU_ROWS, width);
+    encoder->cb_strip = stream_encoder_plane(workspace != NULL ? &workspace->cb_strip : NULL,
+                                             DCT_BLOCK_SIZE, encoder->chroma_width);
+    encoder->cr_strip = stream_encoder_plane(workspace != NULL ? &workspace->cr_strip : NULL,
+                                             DCT_BLOCK_SIZE, encoder->chroma_width);
+    encoder->cb_pair = stream_encoder_plane(workspace != NULL ? &workspace->cb_pair : NULL, 2, width);
+    encoder->cr_pair = stream_encoder_plane(workspace != NULL ? &workspace->cr_pair : NULL, 2, width);
+
+    // Right padding of chroma row i repeats the last Cb/Cr of full-resolution row i
+    encoder->cb_edge = NULL;
+    encoder->cr_edge = NULL;
+    if (encoder->chroma_width > width / 2 && height / 2 > 0) {
+        if (workspace == NULL) {
+            encoder->cb_edge = (unsigned char *)malloc((size_t) (height / 2));
+            encoder->cr_edge = (unsigned char *)malloc((size_t) (height / 2));
+        } else {
+            if (workspace->edge_capacity < height / 2) {
+                workspace->cb_edge = (unsigned char *)realloc(workspace->cb_edge, (size_t) (height / 2));
+                workspace->cr_edge = (unsigned char *)realloc(workspace->cr_edge, (size_t) (height / 2));
+                workspace->edge_capacity = height / 2;
+            }
+            encoder->cb_edge = workspace->cb_edge;
+            encoder->cr_edge = workspace->cr_edge;
+        }
+        if (encoder->cb_edge == NULL || encoder->cr_edge == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    encoder->mcu_blocks = NULL;
+    if (interleaved) {
+        encoder->mcu_blocks = stream_encoder_blocks(workspace, MCU_LUMA_BLOCKS * encoder->luma_block_cols +
+                                                               2 * encoder->chroma_block_cols);
+    }
+    encoder->compressed_size = 0;
+
+    encoder->table_position = ftell(output) + (long) file_header->OffBits;
+    unsigned char headers[BMP_HEADERS_SIZE];
+    serialize_bmp_headers(headers, &stored_header, info_header);
+    bitwriter_write_bytes(&encoder->writer, headers, BMP_HEADERS_SIZE);
+    for (int i = BMP_HEADERS_SIZE; i < (int) file_header->OffBits; i++) {
+        bitwriter_write_code(&encoder->writer, 0, 8);
+    }
+
+    uint32_t *segment_offsets = NULL;
+    if (bin_has_segment_table(&stored_header)) {
+        // Zeros for now, the offsets are only known as the intervals are coded
+        segment_offsets = (uint32_t *)calloc((size_t) encoder->segment_count, sizeof(uint32_t));
+        if (segment_offsets == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < bin_segment_table_size(encoder->segment_count); i++) {
+            bitwriter_write_code(&encoder->writer, 0, 8);
+        }
+    }
+    mcu_coder_init(&encoder->mcu_coder, &encoder->writer, restart_interval, segment_offsets,
+                   dc_encoder, ac_encoder);
+
+    return 0;
+}
+
+/**
+ * @brief Codes every luminance block row that the strip now holds completely
+ */
+static void encode_ready_luma(StreamEncoder *encoder) {
+    int16_t coefficients[BLOCK_COEFFICIENTS];
+
+    while (encoder->luma_block_rows_done < encoder->luma_block_rows &&
+           (encoder->luma_block_rows_done + 1) * DCT_BLOCK_SIZE <= encoder->rows_received) {
+        int strip_row = (encoder->luma_block_rows_done * DCT_BLOCK_SIZE) % STREAM_MCU_ROWS;
+        const unsigned char *row = image_plane_row(&encoder->y_strip, strip_row);
+        for (int j = 0; j < encoder->luma_block_cols; j++) {
+            forward_block_kernel(&encoder->kernels[LUMINANCE], row + j * DCT_BLOCK_SIZE,
+                                 encoder->y_strip.stride, coefficients);
+            encode_coefficient_block(&encoder->writer, coefficients, &encoder->previous_dc_y,
+                                     encoder->dc_encoder, encoder->ac_encoder);
+        }
+        encoder->luma_block_rows_done++;
+    }
+}
+
+/**
+ * @brief Codes the chroma block row once all eight of its rows are ready
+ */
+static void encode_ready_chroma(StreamEncoder *encoder) {
+    int16_t coefficients[BLOCK_COEFFICIENTS];
+
+    while (encoder->chroma_block_rows_done < encoder->chroma_block_rows &&
+           (encoder->chroma_block_rows_done + 1) * DCT_BLOCK_SIZE <= encoder->chroma_rows_ready) {
+        for (int j = 0; j < encoder->chroma_block_cols; j++) {
+            forward_block_kernel(&encoder->kernels[CHROMINANCE], encoder->cb_strip.data + j * DCT_BLOCK_SIZE,
+                                 encoder->cb_strip.stride, coefficients);
+            encode_coefficient_block(&encoder->chroma_writer, coefficients, &encoder->previous_dc_cb,
+                                     encoder->dc_encoder, encoder->ac_encoder);
+            forward_block_kernel(&encoder->kernels[CHROMINANCE], encoder->cr_strip.data + j * DCT_BLOCK_SIZE,
+                                 encoder->cr_strip.stride, coefficients);
+            encode_coefficient_block(&encoder->chroma_writer, coefficients, &encoder->previous_dc_cr,
+                                     encoder->dc_encoder, encoder->ac_encoder);
+        }
+        encoder->chroma_block_rows_done++;
+    }
+}
+
+/**
+ * @brief Codes every MCU row whose Y blocks and chroma block row are both complete
+ *
+ * The row's blocks are transformed into mcu_blocks, then coded in MCU order
+ * by the shared interleaved coder.
+ */
+static void encode_ready_mcus(StreamEncoder *encoder) {
+    int16_t *y = encoder->mcu_blocks;
+    int16_t *cb = y + (size_t) MCU_LUMA_BLOCKS * encoder->luma_block_cols * BLOCK_COEFFICIENTS;
+    int16_t *cr = cb + (size_t) encoder->chroma_block_cols * BLOCK_COEFFICIENTS;
+
+    while (encoder->chroma_block_rows_done < encoder->chroma_block_rows) {
+        int r = encoder->chroma_block_rows_done;
+        int luma_rows = encoder->luma_block_rows - r * MCU_LUMA_BLOCKS;
+        if (luma_rows > MCU_LUMA_BLOCKS) {
+            luma_rows = MCU_LUMA_BLOCKS;
+        }
+        if ((r * MCU_LUMA_BLOCKS + luma_rows) * DCT_BLOCK_SIZE > encoder->rows_received ||
+            (r + 1) * DCT_BLOCK_SIZE > encoder->chroma_rows_ready) {
+            break;
+        }
+
+        for (int b = 0; b < luma_rows; b++) {
+            const unsigned char *row = image_plane_row(&encoder->y_strip, b * DCT_BLOCK_SIZE);
+            for (int j = 0; j < encoder->luma_block_cols; j++) {
+                forward_block_kernel(&encoder->kernels[LUMINANCE], row + j * DCT_BLOCK_SIZE, encoder->y_strip.stride,
+                                     y + ((size_t) b * encoder->luma_block_cols + j) * BLOCK_COEFFICIENTS);
+            }
+        }
+        for (int j = 0; j < encoder->chroma_block_cols; j++) {
+            forward_block_kernel(&encoder->kernels[CHROMINANCE], encoder->cb_strip.data + j * DCT_BLOCK_SIZE,
+                                 encoder->cb_strip.stride, cb + (size_t) j * BLOCK_COEFFICIENTS);
+            forward_block_kernel(&encoder->kernels[CHROMINANCE], encoder->cr_strip.data + j * DCT_BLOCK_SIZE,
+                                 encoder->cr_strip.stride, cr + (size_t) j * BLOCK_COEFFICIENTS);
+        }
+        mcu_coder_encode_row(&encoder->mcu_coder, y, luma_rows, encoder->luma_block_cols, cb, cr, 0,
+                             encoder->chroma_block_cols);
+        encoder->chroma_block_rows_done++;
+    }
+}
+
+/**
+ * @brief Converts one source row and advances the chroma and luma strips
+ */
+static void stream_encoder_push_row(StreamEncoder *encoder, const unsigned char *bgr) {
+    int i = encoder->rows_received;
+    int width = encoder->width;
+    unsigned char *y = image_plane_row(&encoder->y_strip, i % STREAM_MCU_ROWS);
+    unsigned char *cb = image_plane_row(&encoder->cb_pair, i % 2);
+    unsigned char *cr = image_plane_row(&encoder->cr_pair, i % 2);
+
+    if (encoder->fixed_point) {
+        bgr_row_to_ycbcr_fixed(bgr, y, cb, cr, width);
+    } else {
+        bgr_row_to_ycbcr(bgr, y, cb, cr, width);
+    }
+
+    if (encoder->cb_edge != NULL && i < encoder->height / 2) {
+        encoder->cb_edge[i] = cb[width - 1];
+        encoder->cr_edge[i] = cr[width - 1];
+    }
+
+    // Subsample once both rows of the pair are converted
+    if (i % 2 == 1) {
+        int c = i / 2;
+        subsample_chroma_row(image_plane_row(&encoder->cb_pair, 0), image_plane_row(&encoder->cb_pair, 1), c,
+                             encoder->height, width, encoder->cb_edge,
+                             image_plane_row(&encoder->cb_strip, c % DCT_BLOCK_SIZE), encoder->chroma_width);
+        subsample_chroma_row(image_plane_row(&encoder->cr_pair, 0), image_plane_row(&encoder->cr_pair, 1), c,
+                             encoder->height, width, encoder->cr_edge,
+                             image_plane_row(&encoder->cr_strip, c % DCT_BLOCK_SIZE), encoder->chroma_width);
+        encoder->chroma_rows_ready = c + 1;
+    }
+
+    encoder->rows_received++;
+    if (encoder->interleaved) {
+        encode_ready_mcus(encoder);
+        return;
+    }
+    encode_ready_chroma(encoder);
+    encode_ready_luma(encoder);
+}
+
+/**
+ * @brief Feeds source rows to the encoder
+ *
+ * Rows are consumed in stored order, any number per call; each time a
+ * full MCU row (STREAM_MCU_ROWS source rows) is in, its luminance blocks are
+ * transformed and coded immediately. Rows past the image height are ignored.
+ *
+ * @param encoder Encoder initialized with stream_encoder_init
+ * @param bgr First row, 3 bytes per pixel in B, G, R order
+ * @param row_stride Bytes between consecutive rows
+ * @param rows Number of rows
+ */
+void stream_encoder_write_rows(StreamEncoder *encoder, const unsigned char *bgr, int row_stride, int rows) {
+    for (int k = 0; k < rows && encoder->rows_received < encoder->height; k++) {
+        stream_encoder_push_row(encoder, bgr + (size_t) k * row_stride);
+    }
+}
+
+/**
+ * @brief Appends the spilled chrominance after the luminance, flushes and closes the spill
+ */
+static void stream_encoder_append_chroma(StreamEncoder *encoder) {
+    // Chrominance continues the luminance bitstream bit for bit
+    uint32_t tail_code;
+    int tail_bits;
+    bitwriter_detach(&encoder->chroma_writer, &tail_code, &tail_bits);
+    rewind(encoder->chroma_spill);
+    unsigned char *chunk = (unsigned char *)malloc(STREAM_COPY_SIZE);
+    if (chunk == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    // A reused spill can hold an earlier, longer file past this one's bytes
+    size_t remaining = encoder->chroma_writer.bytes_flushed;
+    size_t count;
+    while (remaining > 0 &&
+           (count = fread(chunk, 1, remaining < STREAM_COPY_SIZE ? remaining : STREAM_COPY_SIZE,
+                          encoder->chroma_spill)) > 0) {
+        bitwriter_write_bytes(&encoder->writer, chunk, count);
+        remaining -= count;
+    }
+    free(chunk);
+    bitwriter_write_code(&encoder->writer, tail_code, tail_bits);
+    bitwriter_flush(&encoder->writer);
+    encoder->compressed_size = encoder->writer.bytes_flushed;
+    if (encoder->workspace == NULL) {
+        fclose(encoder->chroma_spill);
+    }
+}
+
+/**
+ * @brief Codes the last partial MCU row, appends the chrominance and flushes
+ *
+ * Frees everything the encoder owns, except what belongs to its workspace,
+ * if it has one; the output file stays open. On success
+ * encoder->compressed_size holds the number of bytes written.
+ *
+ * @param encoder Encoder initialized with stream_encoder_init
+ * @return 0 on success, -1 if fewer rows than the image height were written
+ * or the segment table could not be written
+ */
+int stream_encoder_finish(StreamEncoder *encoder) {
+    int status = encoder->rows_received == encoder->height ? 0 : -1;
+
+    if (status == 0 && encoder->height > 0) {
+        // Chroma rows past height / 2 are bottom padding from the last full-resolution row
+        const unsigned char *cb_last = image_plane_row(&encoder->cb_pair, (encoder->height - 1) % 2);
+        const unsigned char *cr_last = image_plane_row(&encoder->cr_pair, (encoder->height - 1) % 2);
+        for (int c = encoder->height / 2; c < encoder->chroma_height; c++) {
+            subsample_chroma_row(cb_last, NULL, c, encoder->height, encoder->width, encoder->cb_edge,
+                                 image_plane_row(&encoder->cb_strip, c % DCT_BLOCK_SIZE), encoder->chroma_width);
+            subsample_chroma_row(cr_last, NULL, c, encoder->height, encoder->width, encoder->cr_edge,
+                                 image_plane_row(&encoder->cr_strip, c % DCT_BLOCK_SIZE), encoder->chroma_width);
+            encoder->chroma_rows_ready = c + 1;
+            if (encoder->interleaved) {
+                encode_ready_mcus(encoder);
+            } else {
+                encode_ready_chroma(encoder);
+            }
+        }
+    }
+
+    if (encoder->interleaved) {
+        bitwriter_flush(&encoder->writer);
+        encoder->compressed_size = encoder->writer.bytes_flushed;
+        uint32_t *segment_offsets = encoder->mcu_coder.segment_offsets;
+        if (segment_offsets != NULL &&
+            write_segment_table_at(encoder->writer.file, encoder->table_position, segment_offsets,
+                                   encoder->segment_count) != 0) {
+            status = -1;
+        }
+    } else {
+        stream_encoder_append_chroma(encoder);
+    }
+
+    if (encoder->workspace == NULL) {
+        free_image_plane(&encoder->y_strip);
+        free_image_plane(&encoder->cb_strip);
+        free_image_plane(&encoder->cr_strip);
+        free_image_plane(&encoder->cb_pair);
+        free_image_plane(&encoder->cr_pair);
+        free(encoder->cb_edge);
+        free(encoder->cr_edge);
+        free(encoder->mcu_blocks);
+    }
+    free(encoder->mcu_coder.segment_offsets);
+
+    return status;
+}
+
+/**
+ * @brief Initializes an empty workspace; the spill file and buffers are created on first use
+ *
+ * @param workspace Workspace to initialize
+ */
+void stream_workspace_init(StreamWorkspace *workspace) {
+    memset(workspace, 0, sizeof(*workspace));
+}
+
+/**
+ * @brief Closes the spill file and frees the buffers of a workspace
+ *
+ * @param workspace Workspace initialized with stream_workspace_init
+ */
+void stream_workspace_destroy(StreamWorkspace *workspace) {
+    if (workspace->chroma_spill != NULL) {
+        fclose(workspace->chroma_spill);
+    }
+    free_image_plane(&workspace->y_strip);
+    free_image_plane(&workspace->cb_strip);
+    free_image_plane(&workspace->cr_strip);
+    free_image_plane(&workspace->cb_pair);
+    free_image_plane(&workspace->cr_pair);
+    free(workspace->cb_edge);
+    free(workspace->cr_edge);
+    free(workspace->mcu_blocks);
+    stream_workspace_init(workspace);
+}
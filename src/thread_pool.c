@@ -0,0 +1,175 @@
+#if defined(unix) || defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define THREAD_POOL_POSIX 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "thread_pool.h"
+
+#ifdef THREAD_POOL_POSIX
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Runs indices of the current loop until none are left; called with the lock held
+ */
+static void run_pending_tasks(ThreadPool *pool) {
+    while (pool->next_task < pool->task_count) {
+        int index = pool->next_task++;
+        ThreadTask task = pool->task;
+        void *context = pool->context;
+
+        pthread_mutex_unlock(&pool->lock);
+        task(context, index);
+        pthread_mutex_lock(&pool->lock);
+
+        if (++pool->tasks_finished == pool->task_count) {
+            pthread_cond_broadcast(&pool->work_done);
+        }
+    }
+}
+
+/**
+ * @brief Worker thread body: waits for a loop, helps run it, repeats until shutdown
+ */
+static void *thread_pool_worker(void *argument) {
+    ThreadPool *pool = (ThreadPool *) argument;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutting_down && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutting_down) {
+            break;
+        }
+        seen = pool->generation;
+        run_pending_tasks(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts the worker threads of a pool
+ *
+ * The thread calling thread_pool_parallel_for always takes part in the
+ * loop, so a pool of one thread starts no workers and runs everything
+ * inline.
+ *
+ * @param pool Pool to initialize
+ * @param thread_count Total threads per loop, values below 1 mean 1
+ * @return 0 on success, -1 if a worker thread cannot be created
+ */
+int thread_pool_init(ThreadPool *pool, int thread_count) {
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    pool->thread_count = 1;
+    pool->workers = NULL;
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->task_count = 0;
+    pool->next_task = 0;
+    pool->tasks_finished = 0;
+    pool->generation = 0;
+    pool->shutting_down = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    if (thread_count > 1) {
+        pool->workers = (pthread_t *)malloc((size_t) (thread_count - 1) * sizeof(pthread_t));
+        if (pool->workers == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < thread_count - 1; i++) {
+            if (pthread_create(&pool->workers[i], NULL, thread_pool_worker, pool) != 0) {
+                thread_pool_destroy(pool);
+                return -1;
+            }
+            pool->thread_count++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Calls task(context, i) for every i in [0, count) across the pool
+ *
+ * Indices are handed out one at a time in increasing order, so coarse
+ * tasks (a band of MCU rows, say) balance without any tuning. Returns once
+ * every call has completed. Only one loop may run on a pool at a time.
+ *
+ * @param pool Pool initialized with thread_pool_init
+ * @param count Number of indices
+ * @param task Function called for each index
+ * @param context Passed through to task
+ */
+void thread_pool_parallel_for(ThreadPool *pool, int count, ThreadTask task, void *context) {
+    if (count <= 0) {
+        return;
+    }
+    if (pool->thread_count == 1 || count == 1) {
+        for (int i = 0; i < count; i++) {
+            task(context, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->task_count = count;
+    pool->next_task = 0;
+    pool->tasks_finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+
+    run_pending_tasks(pool);
+    while (pool->tasks_finished < pool->task_count) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Stops and joins the worker threads and releases the pool
+ *
+ * @param pool Pool initialized with thread_pool_init, no loop running
+ */
+void thread_pool_destroy(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count - 1; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->thread_count = 1;
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+}
+
+/**
+ * @brief Number of online processors, 1 if it cannot be determined
+ */
+int thread_pool_default_threads() {
+#ifdef THREAD_POOL_POSIX
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0) {
+        return (int) count;
+    }
+#endif
+    return 1;
+}
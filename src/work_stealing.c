@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "work_stealing.h"
+
+// Argument of one worker thread
+typedef struct {
+    WorkStealingScheduler *scheduler;
+    int worker;
+} StealingWorker;
+
+/**
+ * @brief Initializes a scheduler with job_count jobs split evenly across the workers
+ *
+ * Worker k starts with a contiguous range of indices, so files given in a
+ * meaningful order are mostly processed in that order; the ranges are
+ * rebalanced by stealing while the loop runs.
+ *
+ * @param scheduler Scheduler to initialize
+ * @param worker_count Workers taking part, the calling thread included (at least 1)
+ * @param job_count Number of jobs
+ */
+void work_stealing_init(WorkStealingScheduler *scheduler, int worker_count, int job_count) {
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    scheduler->worker_count = worker_count;
+    scheduler->task = NULL;
+    scheduler->context = NULL;
+    scheduler->ranges = (WorkRange *)malloc((size_t) worker_count * sizeof(WorkRange));
+    if (scheduler->ranges == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < worker_count; k++) {
+        WorkRange *range = &scheduler->ranges[k];
+        pthread_mutex_init(&range->lock, NULL);
+        range->begin = (int) ((long long) job_count * k / worker_count);
+        range->end = (int) ((long long) job_count * (k + 1) / worker_count);
+        range->jobs_run = 0;
+        range->steals = 0;
+    }
+}
+
+/**
+ * @brief Takes the next job of a worker's own range
+ *
+ * @return Job index, or -1 if the range is empty
+ */
+static int take_own_job(WorkRange *range) {
+    int job = -1;
+    pthread_mutex_lock(&range->lock);
+    if (range->begin < range->end) {
+        job = range->begin++;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return job;
+}
+
+/**
+ * @brief Moves the back half of some other worker's remaining jobs into an idle worker's range
+ *
+ * Victims are tried in order starting after the thief. Only one range lock
+ * is held at a time, so thieves never deadlock on each other.
+ *
+ * @return 1 if jobs were stolen, 0 if every other range is empty
+ */
+static int steal_jobs(WorkStealingScheduler *scheduler, int worker) {
+    for (int k = 1; k < scheduler->worker_count; k++) {
+        WorkRange *victim = &scheduler->ranges[(worker + k) % scheduler->worker_count];
+        int begin = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end) {
+            // The job in progress is already off the range, so a single remaining one can go too
+            begin = victim->begin + (victim->end - victim->begin) / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            WorkRange *own = &scheduler->ranges[worker];
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin;
+            own->end = end;
+            own->steals++;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs jobs until neither the worker's own range nor any other has any left
+ *
+ * Jobs only move between ranges, never appear, so once a full pass over the
+ * victims finds nothing every remaining job belongs to a worker still running.
+ */
+static void run_worker(WorkStealingScheduler *scheduler, int worker) {
+    WorkRange *own = &scheduler->ranges[worker];
+    for (;;) {
+        int job = take_own_job(own);
+        if (job < 0) {
+            if (!steal_jobs(scheduler, worker)) {
+                return;
+            }
+            continue;
+        }
+        scheduler->task(scheduler->context, worker, job);
+        own->jobs_run++;
+    }
+}
+
+/**
+ * @brief Worker thread entry point
+ */
+static void *stealing_thread_main(void *argument) {
+    StealingWorker *worker = (StealingWorker *) argument;
+    run_worker(worker->scheduler, worker->worker);
+    return NULL;
+}
+
+/**
+ * @brief Runs every job of the scheduler and returns once all have completed
+ *
+ * The calling thread is worker 0; the others are started for this call and
+ * joined before it returns. A task receives the index of the worker running
+ * it, so it can use per-worker state without locking. If some threads cannot
+ * be started their jobs are stolen by the workers that were.
+ *
+ * @param scheduler Scheduler initialized with work_stealing_init
+ * @param task Called once for every job
+ * @param context Passed through to task
+ * @return Number of workers that actually ran
+ */
+int work_stealing_run(WorkStealingScheduler *scheduler, StealingTask task, void *context) {
+    int extra = scheduler->worker_count - 1;
+    pthread_t *threads = (pthread_t *)malloc((size_t) (extra > 0 ? extra : 1) * sizeof(pthread_t));
+    StealingWorker *workers = (StealingWorker *)malloc((size_t) scheduler->worker_count * sizeof(StealingWorker));
+    if (threads == NULL || workers == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    scheduler->task = task;
+    scheduler->context = context;
+
+    int started = 0;
+    for (int k = 1; k <= extra; k++) {
+        workers[k].scheduler = scheduler;
+        workers[k].worker = k;
+        if (pthread_create(&threads[started], NULL, stealing_thread_main, &workers[k]) != 0) {
+            break;
+        }
+        started++;
+    }
+    run_worker(scheduler, 0);
+    for (int k = 0; k < started; k++) {
+        pthread_join(threads[k], NULL);
+    }
+
+    free(threads);
+    free(workers);
+    return started + 1;
+}
+
+/**
+ * @brief Releases the ranges of a scheduler
+ */
+void work_stealing_destroy(WorkStealingScheduler *scheduler) {
+    for (int k = 0; k < scheduler->worker_count; k++) {
+        pthread_mutex_destroy(&scheduler->ranges[k].lock);
+    }
+    free(scheduler->ranges);
+    scheduler->ranges = NULL;
+}